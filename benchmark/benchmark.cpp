@@ -0,0 +1,639 @@
+#include "benchmark.h"
+
+#include "corpus_loader.h"
+#include "document_filter.h"
+#include "durable_search_server.h"
+#include "generators.h"
+#include "process_queries.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// Shards of the sharded scenarios
+constexpr size_t SHARD_COUNT = 4;
+
+#ifdef __linux__
+// Write-ahead log of the durable scenarios, removed after every repetition
+string GetLogPath() {
+    return "/tmp/search_server_benchmark_"s + to_string(getpid()) + ".wal"s;
+}
+
+// Corpus file of the loading scenarios in the format of LoadCorpus
+string GetCorpusPath() {
+    return "/tmp/search_server_benchmark_"s + to_string(getpid()) + ".corpus"s;
+}
+#endif
+
+struct BenchmarkCorpus {
+    vector<string> words;
+    vector<string> documents;
+    vector<vector<int>> ratings;
+    vector<DocumentStatus> statuses;
+    vector<string> queries;
+};
+
+BenchmarkCorpus GenerateZipfCorpus(const BenchmarkParameters& parameters, uint32_t seed) {
+    WorkloadConfig config;
+    config.document_count = parameters.document_count;
+    config.vocabulary_size = parameters.vocabulary_size;
+    config.zipf_exponent = parameters.zipf_exponent;
+    config.max_word_length = parameters.max_word_length;
+    config.max_document_length = parameters.document_word_count;
+    config.query_count = parameters.query_count;
+    config.distinct_query_count = parameters.query_count;
+    config.max_query_length = parameters.query_word_count;
+    config.minus_word_ratio = parameters.minus_word_ratio;
+    config.status_weights = parameters.status_weights;
+
+    Workload workload = GenerateWorkload(config, seed);
+    BenchmarkCorpus corpus;
+    corpus.words = move(workload.vocabulary);
+    for (WorkloadDocument& document : workload.documents) {
+        corpus.documents.push_back(move(document.text));
+        corpus.ratings.push_back(move(document.ratings));
+        corpus.statuses.push_back(document.status);
+    }
+    corpus.queries = move(workload.queries);
+    return corpus;
+}
+
+BenchmarkCorpus GenerateCorpus(const BenchmarkParameters& parameters, uint32_t seed) {
+    if (parameters.corpus == "zipf"s) {
+        return GenerateZipfCorpus(parameters, seed);
+    }
+    if (parameters.corpus != "uniform"s) {
+        throw invalid_argument("Unknown corpus "s + parameters.corpus);
+    }
+
+    mt19937 generator(seed);
+    BenchmarkCorpus corpus;
+    corpus.words = GenerateWords(generator, parameters.vocabulary_size, parameters.max_word_length);
+    corpus.documents = GeneratePhrases(generator, corpus.words, parameters.document_count, parameters.document_word_count);
+    corpus.ratings.reserve(parameters.document_count);
+    for (int i = 0; i < parameters.document_count; ++i) {
+        corpus.ratings.push_back(GenerateRatings(generator, 5, -10, 10));
+    }
+    corpus.queries = GeneratePhrases(generator, corpus.words, parameters.query_count,
+                                     parameters.query_word_count, parameters.minus_word_ratio);
+
+    // A separate generator keeps the texts independent of the status weights
+    mt19937 status_generator(seed + 1);
+    discrete_distribution<int> status_distribution(parameters.status_weights.begin(), parameters.status_weights.end());
+    for (int i = 0; i < parameters.document_count; ++i) {
+        corpus.statuses.push_back(static_cast<DocumentStatus>(status_distribution(status_generator)));
+    }
+    return corpus;
+}
+
+void FillServer(SearchServer& server, const BenchmarkCorpus& corpus) {
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+    }
+}
+
+// Documents with the last word replaced by another word of the vocabulary
+vector<string> MakeEditedDocuments(const BenchmarkCorpus& corpus) {
+    vector<string> documents;
+    documents.reserve(corpus.documents.size());
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        const string& document = corpus.documents[i];
+        const size_t last_space = document.rfind(' ');
+        const size_t kept = (last_space == string::npos) ? 0 : last_space + 1;
+        documents.push_back(document.substr(0, kept) + corpus.words[i * 7919 % corpus.words.size()]);
+    }
+    return documents;
+}
+
+// Views into the corpus for the bulk AddDocuments
+vector<NewDocument> MakeNewDocuments(const BenchmarkCorpus& corpus) {
+    vector<NewDocument> documents;
+    documents.reserve(corpus.documents.size());
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        documents.push_back({ static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i] });
+    }
+    return documents;
+}
+
+#ifdef __linux__
+void WriteCorpusFile(const BenchmarkCorpus& corpus, const string& path) {
+    ofstream out(path);
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        out << i << '\t' << static_cast<int>(corpus.statuses[i]) << '\t';
+        for (size_t j = 0; j < corpus.ratings[i].size(); ++j) {
+            out << (j > 0 ? " "s : ""s) << corpus.ratings[i][j];
+        }
+        out << '\t' << corpus.documents[i] << '\n';
+    }
+}
+#endif
+
+uint64_t Nanoseconds(Clock::duration duration) {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(duration).count());
+}
+
+template <typename Operation>
+uint64_t TimeOperation(vector<uint64_t>& samples, Operation operation) {
+    const Clock::time_point start = Clock::now();
+    operation();
+    const uint64_t elapsed = Nanoseconds(Clock::now() - start);
+    samples.push_back(elapsed);
+    return elapsed;
+}
+
+// Runs operation(i) for every i in [0, count) spread across thread_count threads
+template <typename Operation>
+void RunConcurrently(int thread_count, size_t count, vector<uint64_t>& samples, Operation operation) {
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            TimeOperation(samples, [&operation, i]() { operation(i); });
+        }
+        return;
+    }
+
+    vector<vector<uint64_t>> thread_samples(thread_count);
+    vector<thread> threads;
+    threads.reserve(thread_count);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < count; i += thread_count) {
+                TimeOperation(thread_samples[t], [&operation, i]() { operation(i); });
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    for (const vector<uint64_t>& local : thread_samples) {
+        samples.insert(samples.end(), local.begin(), local.end());
+    }
+}
+
+struct Scenario {
+    // The server is filled once and shared by the warmup and all repetitions
+    bool needs_prepared_server;
+    // Performs one repetition and appends per-operation latencies
+    function<void(const BenchmarkCorpus&, const BenchmarkParameters&, SearchServer&, vector<uint64_t>&)> run;
+    // If set, builds a new server for every repetition before it is timed
+    function<unique_ptr<SearchServer>(const BenchmarkCorpus&)> setup = nullptr;
+};
+
+unique_ptr<SearchServer> MakeFilledServer(const BenchmarkCorpus& corpus) {
+    auto server = make_unique<SearchServer>();
+    FillServer(*server, corpus);
+    return server;
+}
+
+const map<string, Scenario>& GetScenarios() {
+    static const map<string, Scenario> scenarios = {
+        { "add_document"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                SearchServer server;
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() {
+                        server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+                    });
+                }
+            } } },
+        // All analyzer steps, the ASCII words of the corpus take the SSE2 fast path
+        { "add_document_analyzed"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                IndexOptions options;
+                options.analyzer = AnalyzerOptions{ true, true, true };
+                SearchServer server(options);
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() {
+                        server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+                    });
+                }
+            } } },
+        { "add_documents_bulk"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                SearchServer server;
+                const vector<NewDocument> documents = MakeNewDocuments(corpus);
+                TimeOperation(samples, [&]() { server.AddDocuments(documents); });
+            } } },
+#ifdef __linux__
+        // Every call waits for fdatasync, concurrent threads share them by group commit
+        { "add_document_durable"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer&, vector<uint64_t>& samples) {
+                unlink(GetLogPath().c_str());
+                {
+                    DurableSearchServer server(GetLogPath());
+                    RunConcurrently(parameters.thread_count, corpus.documents.size(), samples, [&](size_t i) {
+                        server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+                    });
+                }
+                unlink(GetLogPath().c_str());
+            } } },
+        { "replay_log"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                unlink(GetLogPath().c_str());
+                DurableSearchServer(GetLogPath(), string(), IndexOptions(), WalOptions{ false }).AddDocuments(MakeNewDocuments(corpus));
+                TimeOperation(samples, [&]() { DurableSearchServer server(GetLogPath()); });
+                unlink(GetLogPath().c_str());
+            } } },
+        { "load_corpus"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                WriteCorpusFile(corpus, GetCorpusPath());
+                SearchServer server;
+                TimeOperation(samples, [&]() { LoadCorpus(server, GetCorpusPath()); });
+                unlink(GetCorpusPath().c_str());
+            } } },
+        // The same file read line by line with iostreams and added one document at a time
+        { "load_corpus_getline"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer&, vector<uint64_t>& samples) {
+                WriteCorpusFile(corpus, GetCorpusPath());
+                SearchServer server;
+                TimeOperation(samples, [&]() {
+                    ifstream in(GetCorpusPath());
+                    string line;
+                    while (getline(in, line)) {
+                        istringstream fields(line);
+                        string id;
+                        string status;
+                        string ratings_field;
+                        string text;
+                        getline(fields, id, '\t');
+                        getline(fields, status, '\t');
+                        getline(fields, ratings_field, '\t');
+                        getline(fields, text);
+                        istringstream ratings_stream(ratings_field);
+                        vector<int> ratings;
+                        int rating = 0;
+                        while (ratings_stream >> rating) {
+                            ratings.push_back(rating);
+                        }
+                        server.AddDocument(stoi(id), text, static_cast<DocumentStatus>(stoi(status)), ratings);
+                    }
+                });
+                unlink(GetCorpusPath().c_str());
+            } } },
+#endif
+        // Random access to the texts of the compressed document store
+        { "get_document_text"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.GetDocumentText(static_cast<int>(i * 7919 % corpus.documents.size()));
+                });
+            },
+            [](const BenchmarkCorpus& corpus) {
+                IndexOptions options;
+                options.store_documents = true;
+                auto server = make_unique<SearchServer>(string(), options);
+                server->AddDocuments(MakeNewDocuments(corpus));
+                return server;
+            } } },
+        { "remove_document"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() { server.RemoveDocument(static_cast<int>(i)); });
+                }
+            }, MakeFilledServer } },
+        { "remove_document_par"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() { server.RemoveDocument(execution::par, static_cast<int>(i)); });
+                }
+            }, MakeFilledServer } },
+        { "upsert_document"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                const vector<string> edited = MakeEditedDocuments(corpus);
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() {
+                        server.UpsertDocument(static_cast<int>(i), edited[i], corpus.statuses[i], corpus.ratings[i]);
+                    });
+                }
+            }, MakeFilledServer } },
+        { "replace_document"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                const vector<string> edited = MakeEditedDocuments(corpus);
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() {
+                        server.RemoveDocument(static_cast<int>(i));
+                        server.AddDocument(static_cast<int>(i), edited[i], corpus.statuses[i], corpus.ratings[i]);
+                    });
+                }
+            }, MakeFilledServer } },
+        { "update_document_status"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() { server.UpdateDocumentStatus(static_cast<int>(i), DocumentStatus::BANNED); });
+                }
+            }, MakeFilledServer } },
+        { "update_document_ratings"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters&, SearchServer& server, vector<uint64_t>& samples) {
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    TimeOperation(samples, [&]() { server.UpdateDocumentRatings(static_cast<int>(i), { 1, 2, 3 }); });
+                }
+            }, MakeFilledServer } },
+        { "match_document"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.MatchDocument(corpus.queries[i], static_cast<int>(i % corpus.documents.size()));
+                });
+            } } },
+        { "match_document_par"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.MatchDocument(execution::par, corpus.queries[i], static_cast<int>(i % corpus.documents.size()));
+                });
+            } } },
+        { "find_top_documents"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(corpus.queries[i]);
+                });
+            } } },
+        { "find_top_documents_all"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(corpus.queries[i], MatchMode::All());
+                });
+            } } },
+        // Minus words of the most frequent words, whose postings cover a large part of the corpus
+        { "find_top_documents_frequent_minus"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                vector<string> queries;
+                for (size_t i = 0; i < corpus.queries.size(); ++i) {
+                    queries.push_back(corpus.queries[i] + " -"s + corpus.words[i % 3] + " -"s + corpus.words[3 + i % 3]);
+                }
+                RunConcurrently(parameters.thread_count, queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(queries[i]);
+                });
+            } } },
+        { "find_top_documents_filter"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                const DocumentFilter filter = DocumentFilter()
+                    .SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT })
+                    .SetRatingRange(0, numeric_limits<int>::max());
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(corpus.queries[i], filter);
+                });
+            } } },
+        { "find_top_documents_bm25"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(Bm25Scorer(), corpus.queries[i]);
+                });
+            } } },
+        { "find_top_documents_prefix"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                // Autocomplete: the first two letters of the first word of every query
+                vector<string> prefixes;
+                for (const string& query : corpus.queries) {
+                    const size_t begin = query.find_first_not_of(" -"s);
+                    prefixes.push_back(begin == string::npos ? "*"s : query.substr(begin, 2) + "*"s);
+                }
+                RunConcurrently(parameters.thread_count, prefixes.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(prefixes[i]);
+                });
+            } } },
+        { "find_top_documents_sharded"s, { false,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer&, vector<uint64_t>& samples) {
+                ShardedSearchServer server(SHARD_COUNT);
+                for (size_t i = 0; i < corpus.documents.size(); ++i) {
+                    server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+                }
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(corpus.queries[i]);
+                });
+            } } },
+        { "find_top_documents_par"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, corpus.queries.size(), samples, [&](size_t i) {
+                    server.FindTopDocuments(execution::par, corpus.queries[i]);
+                });
+            } } },
+        // Every thread runs its own batches, as concurrent callers sharing the execution policy threads
+        { "process_queries"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, parameters.thread_count, samples, [&](size_t) {
+                    ProcessQueries(server, corpus.queries);
+                });
+            } } },
+        { "process_queries_joined"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, parameters.thread_count, samples, [&](size_t) {
+                    ProcessQueriesJoined(server, corpus.queries);
+                });
+            } } },
+        // The buffer of a thread is reused by the repetitions, as a caller serving batches would do
+        { "process_queries_buffer"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, parameters.thread_count, samples, [&](size_t) {
+                    thread_local vector<Document> buffer;
+                    ProcessQueriesJoined(server, corpus.queries, buffer);
+                });
+            } } },
+        // Every result is serialized as it arrives, overlapping with the searches of the other queries
+        { "process_queries_streaming"s, { true,
+            [](const BenchmarkCorpus& corpus, const BenchmarkParameters& parameters, SearchServer& server, vector<uint64_t>& samples) {
+                RunConcurrently(parameters.thread_count, parameters.thread_count, samples, [&](size_t) {
+                    string output;
+                    ProcessQueries(server, corpus.queries, [&output](size_t index, vector<Document>& documents) {
+                        output += to_string(index);
+                        for (const Document& document : documents) {
+                            output += ' ';
+                            output += to_string(document.id);
+                        }
+                        output += '\n';
+                    });
+                });
+            } } },
+    };
+    return scenarios;
+}
+
+uint64_t Percentile(const vector<uint64_t>& sorted_samples, double quantile) {
+    if (sorted_samples.empty()) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(quantile * static_cast<double>(sorted_samples.size() - 1) + 0.5);
+    return sorted_samples[rank];
+}
+
+template <typename Value>
+void PrintJsonArray(const vector<Value>& values, ostream& out) {
+    out << '[';
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i != 0) {
+            out << ',';
+        }
+        if constexpr (is_same_v<Value, string>) {
+            out << '"' << values[i] << '"';
+        }
+        else {
+            out << values[i];
+        }
+    }
+    out << ']';
+}
+
+} // namespace
+
+vector<BenchmarkParameters> BenchmarkConfig::BuildCases() const {
+    vector<BenchmarkParameters> cases;
+    for (int document_count : document_counts) {
+        for (int vocabulary_size : vocabulary_sizes) {
+            for (int query_word_count : query_word_counts) {
+                for (double minus_word_ratio : minus_word_ratios) {
+                    for (int thread_count : thread_counts) {
+                        BenchmarkParameters parameters;
+                        parameters.document_count = document_count;
+                        parameters.vocabulary_size = vocabulary_size;
+                        parameters.max_word_length = max_word_length;
+                        parameters.document_word_count = document_word_count;
+                        parameters.query_count = query_count;
+                        parameters.query_word_count = query_word_count;
+                        parameters.minus_word_ratio = minus_word_ratio;
+                        parameters.thread_count = thread_count;
+                        parameters.corpus = corpus;
+                        parameters.zipf_exponent = zipf_exponent;
+                        parameters.status_weights = status_weights;
+                        cases.push_back(parameters);
+                    }
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+vector<string> GetBenchmarkScenarioNames() {
+    vector<string> names;
+    for (const auto& [name, _] : GetScenarios()) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+BenchmarkResult RunBenchmark(const string& scenario_name, const BenchmarkParameters& parameters,
+                             int warmup, int repetitions, uint32_t seed) {
+    const auto it = GetScenarios().find(scenario_name);
+    if (it == GetScenarios().end()) {
+        throw invalid_argument("Unknown benchmark scenario "s + scenario_name);
+    }
+    const Scenario& scenario = it->second;
+
+    const BenchmarkCorpus corpus = GenerateCorpus(parameters, seed);
+    SearchServer server;
+    if (scenario.needs_prepared_server) {
+        FillServer(server, corpus);
+    }
+
+    // The setup of a repetition is neither in its samples nor in the wall time
+    vector<uint64_t> samples;
+    const auto run = [&]() {
+        unique_ptr<SearchServer> fresh_server = scenario.setup ? scenario.setup(corpus) : nullptr;
+        const Clock::time_point start = Clock::now();
+        scenario.run(corpus, parameters, fresh_server ? *fresh_server : server, samples);
+        return Nanoseconds(Clock::now() - start);
+    };
+    for (int i = 0; i < warmup; ++i) {
+        run();
+    }
+    samples.clear();
+
+    uint64_t wall_ns = 0;
+    for (int i = 0; i < repetitions; ++i) {
+        wall_ns += run();
+    }
+
+    BenchmarkResult result;
+    result.scenario = scenario_name;
+    result.parameters = parameters;
+    result.repetitions = repetitions;
+    result.operations = samples.size();
+    if (!samples.empty()) {
+        sort(samples.begin(), samples.end());
+        uint64_t total = 0;
+        for (uint64_t sample : samples) {
+            total += sample;
+        }
+        result.mean_ns = total / samples.size();
+        result.p50_ns = Percentile(samples, 0.50);
+        result.p90_ns = Percentile(samples, 0.90);
+        result.p99_ns = Percentile(samples, 0.99);
+        result.max_ns = samples.back();
+        result.throughput = (wall_ns == 0) ? 0.0 : static_cast<double>(samples.size()) * 1e9 / static_cast<double>(wall_ns);
+    }
+    return result;
+}
+
+vector<BenchmarkResult> RunBenchmarks(const BenchmarkConfig& config, ostream& log) {
+    const vector<string> scenarios = config.scenarios.empty() ? GetBenchmarkScenarioNames() : config.scenarios;
+
+    vector<BenchmarkResult> results;
+    for (const BenchmarkParameters& parameters : config.BuildCases()) {
+        for (const string& scenario : scenarios) {
+            results.push_back(RunBenchmark(scenario, parameters, config.warmup, config.repetitions, config.seed));
+            const BenchmarkResult& result = results.back();
+            log << result.scenario << " documents="s << parameters.document_count
+                << " vocabulary="s << parameters.vocabulary_size << " query_words="s << parameters.query_word_count
+                << " minus_ratio="s << parameters.minus_word_ratio << " threads="s << parameters.thread_count
+                << ": p50 = "s << result.p50_ns << " ns, p99 = "s << result.p99_ns << " ns, "s
+                << result.throughput << " ops/s"s << endl;
+        }
+    }
+    return results;
+}
+
+void PrintBenchmarkResultsJson(const BenchmarkConfig& config, const vector<BenchmarkResult>& results, ostream& out) {
+    out << "{\n  \"config\": {"s
+        << "\"seed\": "s << config.seed
+        << ", \"warmup\": "s << config.warmup
+        << ", \"repetitions\": "s << config.repetitions
+        << ", \"query_count\": "s << config.query_count
+        << ", \"document_word_count\": "s << config.document_word_count
+        << ", \"max_word_length\": "s << config.max_word_length
+        << ", \"corpus\": \""s << config.corpus << '"'
+        << ", \"zipf_exponent\": "s << config.zipf_exponent
+        << ", \"status_weights\": ["s << config.status_weights[0] << ", "s << config.status_weights[1]
+        << ", "s << config.status_weights[2] << ", "s << config.status_weights[3] << ']'
+        << ", \"scenarios\": "s;
+    PrintJsonArray(config.scenarios.empty() ? GetBenchmarkScenarioNames() : config.scenarios, out);
+    out << "},\n  \"results\": ["s;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        const BenchmarkParameters& parameters = result.parameters;
+        out << (i == 0 ? "\n"s : ",\n"s)
+            << "    {\"scenario\": \""s << result.scenario << '"'
+            << ", \"documents\": "s << parameters.document_count
+            << ", \"vocabulary\": "s << parameters.vocabulary_size
+            << ", \"query_words\": "s << parameters.query_word_count
+            << ", \"minus_ratio\": "s << parameters.minus_word_ratio
+            << ", \"threads\": "s << parameters.thread_count
+            << ", \"operations\": "s << result.operations
+            << ", \"throughput\": "s << result.throughput
+            << ", \"mean_ns\": "s << result.mean_ns
+            << ", \"p50_ns\": "s << result.p50_ns
+            << ", \"p90_ns\": "s << result.p90_ns
+            << ", \"p99_ns\": "s << result.p99_ns
+            << ", \"max_ns\": "s << result.max_ns << '}';
+    }
+    out << "\n  ]\n}"s << endl;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct BenchmarkParameters {
+    int document_count = 10'000;
+    int vocabulary_size = 1'000;
+    int max_word_length = 10;
+    int document_word_count = 70;
+    int query_count = 100;
+    int query_word_count = 10;
+    double minus_word_ratio = 0.0;
+    int thread_count = 1;
+    // "uniform" draws every word with equal probability, "zipf" uses GenerateWorkload
+    std::string corpus = "uniform";
+    double zipf_exponent = 1.0;
+    // Share of documents per status in DocumentStatus order
+    std::array<double, 4> status_weights = { 1.0, 0.0, 0.0, 0.0 };
+};
+
+struct BenchmarkConfig {
+    // Every combination of the listed values is run as a separate case
+    std::vector<int> document_counts = { 10'000 };
+    std::vector<int> vocabulary_sizes = { 1'000 };
+    std::vector<int> query_word_counts = { 10 };
+    std::vector<double> minus_word_ratios = { 0.0 };
+    std::vector<int> thread_counts = { 1 };
+
+    int max_word_length = 10;
+    int document_word_count = 70;
+    int query_count = 100;
+    std::string corpus = "uniform";
+    double zipf_exponent = 1.0;
+    std::array<double, 4> status_weights = { 1.0, 0.0, 0.0, 0.0 };
+    int warmup = 1;
+    int repetitions = 5;
+    uint32_t seed = 5489u;
+    std::vector<std::string> scenarios;
+
+    std::vector<BenchmarkParameters> BuildCases() const;
+};
+
+struct BenchmarkResult {
+    std::string scenario;
+    BenchmarkParameters parameters;
+    int repetitions = 0;
+    uint64_t operations = 0;
+    double throughput = 0.0; // operations per second
+    uint64_t mean_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+std::vector<std::string> GetBenchmarkScenarioNames();
+
+// Throws std::invalid_argument for an unknown scenario name
+BenchmarkResult RunBenchmark(const std::string& scenario, const BenchmarkParameters& parameters,
+                             int warmup, int repetitions, uint32_t seed);
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkConfig& config, std::ostream& log);
+
+void PrintBenchmarkResultsJson(const BenchmarkConfig& config, const std::vector<BenchmarkResult>& results, std::ostream& out);
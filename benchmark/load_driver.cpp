@@ -0,0 +1,129 @@
+#include "load_driver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+vector<Clock::duration> BuildArrivalSchedule(const LoadDriverConfig& config) {
+    if (config.target_qps <= 0.0) {
+        throw invalid_argument("Target QPS must be positive"s);
+    }
+
+    const double duration_s = chrono::duration<double>(config.duration).count();
+    const size_t count = static_cast<size_t>(config.target_qps * duration_s);
+
+    mt19937 generator(config.seed);
+    exponential_distribution<> interval(config.target_qps);
+
+    vector<Clock::duration> schedule;
+    schedule.reserve(count);
+    double offset_s = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        schedule.push_back(chrono::duration_cast<Clock::duration>(chrono::duration<double>(offset_s)));
+        offset_s += config.poisson_arrivals ? interval(generator) : 1.0 / config.target_qps;
+    }
+    return schedule;
+}
+
+uint64_t Percentile(const vector<uint64_t>& sorted_samples, double quantile) {
+    if (sorted_samples.empty()) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(quantile * static_cast<double>(sorted_samples.size() - 1) + 0.5);
+    return sorted_samples[rank];
+}
+
+} // namespace
+
+LoadDriverReport RunLoad(const SearchServer& search_server, const vector<string>& queries, const LoadDriverConfig& config) {
+    if (queries.empty()) {
+        throw invalid_argument("Query log is empty"s);
+    }
+    const vector<Clock::duration> schedule = BuildArrivalSchedule(config);
+    const int thread_count = max(config.thread_count, 1);
+
+    atomic<size_t> next_query = 0;
+    atomic<uint64_t> failed = 0;
+    vector<vector<uint64_t>> thread_latencies(thread_count);
+
+    const Clock::time_point start = Clock::now();
+    vector<thread> threads;
+    threads.reserve(thread_count);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            vector<uint64_t>& latencies = thread_latencies[t];
+            latencies.reserve(schedule.size() / thread_count + 1);
+            for (size_t i = next_query++; i < schedule.size(); i = next_query++) {
+                const Clock::time_point due = start + schedule[i];
+                this_thread::sleep_until(due);
+                try {
+                    search_server.FindTopDocuments(queries[i % queries.size()]);
+                } catch (const exception&) {
+                    ++failed;
+                }
+                latencies.push_back(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - due).count()));
+            }
+        });
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+    const double wall_seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<uint64_t> latencies;
+    latencies.reserve(schedule.size());
+    for (const vector<uint64_t>& local : thread_latencies) {
+        latencies.insert(latencies.end(), local.begin(), local.end());
+    }
+    sort(latencies.begin(), latencies.end());
+
+    LoadDriverReport report;
+    report.target_qps = config.target_qps;
+    report.issued = latencies.size();
+    report.failed = failed;
+    report.wall_seconds = wall_seconds;
+    report.achieved_qps = (wall_seconds > 0.0) ? static_cast<double>(latencies.size()) / wall_seconds : 0.0;
+    if (!latencies.empty()) {
+        uint64_t total = 0;
+        for (uint64_t latency : latencies) {
+            total += latency;
+        }
+        report.mean_ns = total / latencies.size();
+        report.p50_ns = Percentile(latencies, 0.50);
+        report.p90_ns = Percentile(latencies, 0.90);
+        report.p99_ns = Percentile(latencies, 0.99);
+        report.p999_ns = Percentile(latencies, 0.999);
+        report.max_ns = latencies.back();
+    }
+    return report;
+}
+
+void PrintLoadReportJson(const LoadDriverConfig& config, const LoadDriverReport& report, ostream& out) {
+    out << "{\n  \"config\": {"s
+        << "\"target_qps\": "s << config.target_qps
+        << ", \"duration_ms\": "s << config.duration.count()
+        << ", \"threads\": "s << config.thread_count
+        << ", \"arrivals\": \""s << (config.poisson_arrivals ? "poisson"s : "uniform"s) << '"'
+        << ", \"seed\": "s << config.seed
+        << "},\n  \"result\": {"s
+        << "\"issued\": "s << report.issued
+        << ", \"failed\": "s << report.failed
+        << ", \"wall_seconds\": "s << report.wall_seconds
+        << ", \"achieved_qps\": "s << report.achieved_qps
+        << ", \"mean_ns\": "s << report.mean_ns
+        << ", \"p50_ns\": "s << report.p50_ns
+        << ", \"p90_ns\": "s << report.p90_ns
+        << ", \"p99_ns\": "s << report.p99_ns
+        << ", \"p999_ns\": "s << report.p999_ns
+        << ", \"max_ns\": "s << report.max_ns
+        << "}\n}"s << endl;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct LoadDriverConfig {
+    double target_qps = 1'000.0;
+    std::chrono::milliseconds duration{ 5'000 };
+    int thread_count = 4;
+    // Exponential inter-arrival times instead of a fixed interval
+    bool poisson_arrivals = true;
+    uint32_t seed = 5489u;
+};
+
+struct LoadDriverReport {
+    double target_qps = 0.0;
+    double achieved_qps = 0.0;
+    uint64_t issued = 0;
+    uint64_t failed = 0;
+    double wall_seconds = 0.0;
+    uint64_t mean_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+// Open-loop load: query i is due at a precomputed arrival time regardless of how fast
+// previous queries completed, and its latency is measured from that arrival time,
+// so queueing delay of an overloaded server shows up in the percentiles.
+LoadDriverReport RunLoad(const SearchServer& search_server, const std::vector<std::string>& queries,
+                         const LoadDriverConfig& config);
+
+void PrintLoadReportJson(const LoadDriverConfig& config, const LoadDriverReport& report, std::ostream& out);
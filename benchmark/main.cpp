@@ -0,0 +1,242 @@
+#include "benchmark.h"
+#include "load_driver.h"
+#include "scoring_kernels.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+template <typename Value>
+vector<Value> ParseList(const string& text) {
+    vector<Value> values;
+    istringstream input(text);
+    string item;
+    while (getline(input, item, ',')) {
+        istringstream item_input(item);
+        Value value;
+        if (!(item_input >> value) || !item_input.eof()) {
+            throw invalid_argument("Invalid value "s + item);
+        }
+        values.push_back(value);
+    }
+    if (values.empty()) {
+        throw invalid_argument("Empty value list"s);
+    }
+    return values;
+}
+
+template <typename Value>
+Value ParseValue(const string& text) {
+    const vector<Value> values = ParseList<Value>(text);
+    if (values.size() != 1) {
+        throw invalid_argument("Single value expected instead of "s + text);
+    }
+    return values.front();
+}
+
+ScoringKernel ParseScoringKernel(const string& name) {
+    for (ScoringKernel kernel : { ScoringKernel::SCALAR, ScoringKernel::SSE2, ScoringKernel::AVX2, ScoringKernel::AVX512 }) {
+        if (GetScoringKernelName(kernel) == name) {
+            return kernel;
+        }
+    }
+    throw invalid_argument("Unknown scoring kernel "s + name);
+}
+
+void PrintUsage(ostream& out) {
+    out << "Usage: search_server_benchmark [options]\n"s
+        << "  --scenarios=a,b         scenarios to run (all by default)\n"s
+        << "  --documents=N[,N...]    corpus sizes\n"s
+        << "  --vocabulary=N[,N...]   vocabulary sizes\n"s
+        << "  --query-words=N[,N...]  maximum words per query\n"s
+        << "  --minus-ratio=F[,F...]  probability of a query word being a minus word\n"s
+        << "  --threads=N[,N...]      client threads for query scenarios\n"s
+        << "  --document-words=N      maximum words per document\n"s
+        << "  --word-length=N         maximum word length\n"s
+        << "  --queries=N             queries per repetition\n"s
+        << "  --warmup=N              warmup repetitions\n"s
+        << "  --repetitions=N         measured repetitions\n"s
+        << "  --corpus=uniform|zipf   word distribution of the generated corpus\n"s
+        << "  --zipf=F                Zipf exponent of the zipf corpus\n"s
+        << "  --status-weights=F,F,F,F share of ACTUAL, IRRELEVANT, BANNED, REMOVED documents\n"s
+        << "  --seed=N                corpus generator seed\n"s
+        << "  --kernel=NAME           scoring kernel: scalar, sse2, avx2 or avx512 (best supported by default)\n"s
+        << "  --output=FILE           write JSON results to FILE instead of stdout\n"s
+        << "  --list                  print scenario names\n"s
+        << "\nOpen-loop load mode, uses the first value of list options:\n"s
+        << "  --load                  issue queries of a Zipf workload at a fixed rate\n"s
+        << "  --qps=F                 target queries per second\n"s
+        << "  --duration-ms=N         length of the run\n"s
+        << "  --arrivals=poisson|uniform\n"s
+        << "\nMemory mode, uses the first value of list options:\n"s
+        << "  --memory                index a Zipf workload and print SearchServer::GetMemoryStats\n"s;
+}
+
+int RunLoadMode(const BenchmarkConfig& benchmark_config, const WorkloadConfig& workload_base,
+                const LoadDriverConfig& load_config, ostream& out) {
+    WorkloadConfig workload_config = workload_base;
+    workload_config.document_count = benchmark_config.document_counts.front();
+    workload_config.vocabulary_size = benchmark_config.vocabulary_sizes.front();
+    workload_config.zipf_exponent = benchmark_config.zipf_exponent;
+    workload_config.max_query_length = benchmark_config.query_word_counts.front();
+    workload_config.minus_word_ratio = benchmark_config.minus_word_ratios.front();
+
+    cerr << "Generating workload..."s << endl;
+    const Workload workload = GenerateWorkload(workload_config, benchmark_config.seed);
+
+    SearchServer server;
+    for (const WorkloadDocument& document : workload.documents) {
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+
+    cerr << "Running load at "s << load_config.target_qps << " qps..."s << endl;
+    const LoadDriverReport report = RunLoad(server, workload.queries, load_config);
+    PrintLoadReportJson(load_config, report, out);
+    return 0;
+}
+
+int RunMemoryMode(const BenchmarkConfig& benchmark_config, const WorkloadConfig& workload_base, ostream& out) {
+    WorkloadConfig workload_config = workload_base;
+    workload_config.document_count = benchmark_config.document_counts.front();
+    workload_config.vocabulary_size = benchmark_config.vocabulary_sizes.front();
+    workload_config.zipf_exponent = benchmark_config.zipf_exponent;
+    workload_config.query_count = 0;
+
+    cerr << "Generating workload..."s << endl;
+    const Workload workload = GenerateWorkload(workload_config, benchmark_config.seed);
+
+    SearchServer server;
+    for (const WorkloadDocument& document : workload.documents) {
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    out << server.GetMemoryStats() << endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    WorkloadConfig workload_config;
+    LoadDriverConfig load_config;
+    bool load_mode = false;
+    bool memory_mode = false;
+    string output_path;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string argument = argv[i];
+            if (argument == "--help"s) {
+                PrintUsage(cout);
+                return 0;
+            }
+            if (argument == "--load"s) {
+                load_mode = true;
+                continue;
+            }
+            if (argument == "--memory"s) {
+                memory_mode = true;
+                continue;
+            }
+            if (argument == "--list"s) {
+                for (const string& name : GetBenchmarkScenarioNames()) {
+                    cout << name << endl;
+                }
+                return 0;
+            }
+
+            const size_t eq = argument.find('=');
+            if (argument.rfind("--"s, 0) != 0 || eq == string::npos) {
+                throw invalid_argument("Unknown argument "s + argument);
+            }
+            const string name = argument.substr(2, eq - 2);
+            const string value = argument.substr(eq + 1);
+
+            if (name == "scenarios"s) {
+                config.scenarios = ParseList<string>(value);
+            } else if (name == "documents"s) {
+                config.document_counts = ParseList<int>(value);
+            } else if (name == "vocabulary"s) {
+                config.vocabulary_sizes = ParseList<int>(value);
+            } else if (name == "query-words"s) {
+                config.query_word_counts = ParseList<int>(value);
+            } else if (name == "minus-ratio"s) {
+                config.minus_word_ratios = ParseList<double>(value);
+            } else if (name == "threads"s) {
+                config.thread_counts = ParseList<int>(value);
+            } else if (name == "document-words"s) {
+                config.document_word_count = ParseValue<int>(value);
+            } else if (name == "word-length"s) {
+                config.max_word_length = ParseValue<int>(value);
+            } else if (name == "queries"s) {
+                config.query_count = ParseValue<int>(value);
+            } else if (name == "warmup"s) {
+                config.warmup = ParseValue<int>(value);
+            } else if (name == "repetitions"s) {
+                config.repetitions = ParseValue<int>(value);
+            } else if (name == "corpus"s) {
+                config.corpus = value;
+            } else if (name == "zipf"s) {
+                config.zipf_exponent = ParseValue<double>(value);
+            } else if (name == "qps"s) {
+                load_config.target_qps = ParseValue<double>(value);
+            } else if (name == "duration-ms"s) {
+                load_config.duration = chrono::milliseconds(ParseValue<int>(value));
+            } else if (name == "arrivals"s) {
+                load_config.poisson_arrivals = (value == "poisson"s);
+            } else if (name == "status-weights"s) {
+                const vector<double> weights = ParseList<double>(value);
+                if (weights.size() != workload_config.status_weights.size()) {
+                    throw invalid_argument("Four status weights expected"s);
+                }
+                copy(weights.begin(), weights.end(), workload_config.status_weights.begin());
+                copy(weights.begin(), weights.end(), config.status_weights.begin());
+            } else if (name == "kernel"s) {
+                SetScoringKernel(ParseScoringKernel(value));
+            } else if (name == "seed"s) {
+                config.seed = ParseValue<uint32_t>(value);
+            } else if (name == "output"s) {
+                output_path = value;
+            } else {
+                throw invalid_argument("Unknown argument "s + argument);
+            }
+        }
+
+        ofstream output_file;
+        if (!output_path.empty()) {
+            output_file.open(output_path);
+            if (!output_file) {
+                throw invalid_argument("Can't open "s + output_path);
+            }
+        }
+        ostream& output = output_path.empty() ? cout : output_file;
+
+        if (memory_mode) {
+            return RunMemoryMode(config, workload_config, output);
+        }
+        if (load_mode) {
+            load_config.thread_count = config.thread_counts.front();
+            load_config.seed = config.seed;
+            return RunLoadMode(config, workload_config, load_config, output);
+        }
+
+        cerr << "Scoring kernel: "s << GetScoringKernelName(GetScoringKernel()) << endl;
+        const vector<BenchmarkResult> results = RunBenchmarks(config, cerr);
+        PrintBenchmarkResultsJson(config, results, output);
+    } catch (const invalid_argument& e) {
+        cerr << "Ошибка: "s << e.what() << endl;
+        PrintUsage(cerr);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "query_client.h"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void PrintUsage(ostream& out) {
+    out << "Usage: search_server_client (--unix=PATH | --port=N) COMMAND\n"s
+        << "  find QUERY [STATUS]     top documents, STATUS is a number of DocumentStatus\n"s
+        << "  match ID QUERY          words of the query found in the document\n"s
+        << "  add ID TEXT [RATING...] add a document with the ACTUAL status\n"s
+        << "  remove ID               remove a document\n"s;
+}
+
+void RunCommand(QueryClient& client, const vector<string>& command) {
+    if (command.empty()) {
+        throw invalid_argument("Command expected"s);
+    }
+    const string& name = command.front();
+    if (name == "find"s && (command.size() == 2 || command.size() == 3)) {
+        const DocumentStatus status = command.size() == 3 ? static_cast<DocumentStatus>(stoi(command[2])) : DocumentStatus::ACTUAL;
+        for (const Document& document : client.FindTopDocuments(command[1], status)) {
+            cout << document << endl;
+        }
+    } else if (name == "match"s && command.size() == 3) {
+        const auto [words, status] = client.MatchDocument(command[2], stoi(command[1]));
+        cout << "{ status = "s << static_cast<int>(status) << ", words ="s;
+        for (const string& word : words) {
+            cout << ' ' << word;
+        }
+        cout << " }"s << endl;
+    } else if (name == "add"s && command.size() >= 3) {
+        vector<int> ratings;
+        for (size_t i = 3; i < command.size(); ++i) {
+            ratings.push_back(stoi(command[i]));
+        }
+        client.AddDocument(stoi(command[1]), command[2], DocumentStatus::ACTUAL, ratings);
+    } else if (name == "remove"s && command.size() == 2) {
+        client.RemoveDocument(stoi(command[1]));
+    } else {
+        throw invalid_argument("Unknown command "s + name);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    string unix_socket_path;
+    int port = -1;
+    vector<string> command;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string argument = argv[i];
+            if (argument == "--help"s) {
+                PrintUsage(cout);
+                return 0;
+            }
+            if (!command.empty() || argument.rfind("--"s, 0) != 0) {
+                command.push_back(argument);
+            } else if (argument.rfind("--unix="s, 0) == 0) {
+                unix_socket_path = argument.substr(7);
+            } else if (argument.rfind("--port="s, 0) == 0) {
+                port = stoi(argument.substr(7));
+            } else {
+                throw invalid_argument("Unknown argument "s + argument);
+            }
+        }
+        if (unix_socket_path.empty() && port < 0) {
+            throw invalid_argument("--unix or --port expected"s);
+        }
+
+        unique_ptr<QueryClient> client = unix_socket_path.empty()
+            ? make_unique<QueryClient>(static_cast<uint16_t>(port))
+            : make_unique<QueryClient>(unix_socket_path);
+        RunCommand(*client, command);
+    } catch (const exception& e) {
+        // Errors of the search server are invalid_argument too, so the usage is only shown by --help
+        cerr << "Ошибка: "s << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
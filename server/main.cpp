@@ -0,0 +1,92 @@
+#include "query_server.h"
+#include "search_server.h"
+
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server != nullptr) {
+        running_server->Stop();
+    }
+}
+
+void PrintUsage(ostream& out) {
+    out << "Usage: search_server_daemon [options]\n"s
+        << "  --unix=PATH             listen on a Unix domain socket\n"s
+        << "  --port=N                listen on 127.0.0.1:N if no socket path is given (a free port by default)\n"s
+        << "  --stop-words=WORDS      space separated stop words\n"s
+        << "  --positions             store word positions for phrase queries\n"s
+        << "  --batch-size=N          maximum queries per batch\n"s
+        << "  --batch-delay-us=N      time a batch waits for more queries\n"s;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QueryServerOptions options;
+    IndexOptions index_options;
+    string stop_words;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string argument = argv[i];
+            if (argument == "--help"s) {
+                PrintUsage(cout);
+                return 0;
+            }
+            if (argument == "--positions"s) {
+                index_options.store_positions = true;
+                continue;
+            }
+
+            const size_t eq = argument.find('=');
+            if (argument.rfind("--"s, 0) != 0 || eq == string::npos) {
+                throw invalid_argument("Unknown argument "s + argument);
+            }
+            const string name = argument.substr(2, eq - 2);
+            const string value = argument.substr(eq + 1);
+
+            if (name == "unix"s) {
+                options.unix_socket_path = value;
+            } else if (name == "port"s) {
+                options.tcp_port = static_cast<uint16_t>(stoi(value));
+            } else if (name == "stop-words"s) {
+                stop_words = value;
+            } else if (name == "batch-size"s) {
+                options.max_batch_size = stoul(value);
+            } else if (name == "batch-delay-us"s) {
+                options.batch_delay = chrono::microseconds(stol(value));
+            } else {
+                throw invalid_argument("Unknown argument "s + argument);
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Ошибка: "s << e.what() << endl;
+        PrintUsage(cerr);
+        return 1;
+    }
+
+    SearchServer search_server(stop_words, index_options);
+    QueryServer server(search_server, options);
+    running_server = &server;
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    if (options.unix_socket_path.empty()) {
+        cerr << "Listening on 127.0.0.1:"s << server.GetPort() << endl;
+    } else {
+        cerr << "Listening on "s << options.unix_socket_path << endl;
+    }
+    server.Run();
+    running_server = nullptr;
+    cerr << "Served "s << server.GetQueryCount() << " queries in "s << server.GetBatchCount() << " batches"s << endl;
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "async_search_server.h"
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t thread_count)
+    : server_(search_server)
+    , pool_(thread_count) {
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocumentsAsync(string raw_query, DocumentStatus status) {
+    return pool_.Submit([this, raw_query = move(raw_query), status]() {
+        return server_.FindTopDocuments(raw_query, status);
+    });
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocumentsAsync(string raw_query) {
+    return FindTopDocumentsAsync(move(raw_query), DocumentStatus::ACTUAL);
+}
+
+void AsyncSearchServer::FindTopDocumentsAsync(string raw_query, DocumentStatus status, Callback callback) {
+    pool_.Post([this, raw_query = move(raw_query), status, callback = move(callback)]() {
+        vector<Document> documents;
+        try {
+            documents = server_.FindTopDocuments(raw_query, status);
+        } catch (...) {
+            callback(current_exception(), {});
+            return;
+        }
+        callback(nullptr, move(documents));
+    });
+}
+
+void AsyncSearchServer::FindTopDocumentsAsync(string raw_query, Callback callback) {
+    FindTopDocumentsAsync(move(raw_query), DocumentStatus::ACTUAL, move(callback));
+}
+
+future<vector<vector<Document>>> AsyncSearchServer::ProcessQueriesAsync(vector<string> queries) {
+    struct Batch {
+        vector<string> queries;
+        vector<vector<Document>> results;
+        atomic<size_t> remaining;
+        atomic<bool> failed = false;
+        promise<vector<vector<Document>>> done;
+    };
+
+    auto batch = make_shared<Batch>();
+    batch->results.resize(queries.size());
+    batch->remaining = queries.size();
+    batch->queries = move(queries);
+    future<vector<vector<Document>>> result = batch->done.get_future();
+
+    if (batch->queries.empty()) {
+        batch->done.set_value({});
+        return result;
+    }
+
+    // No task blocks on another one: the last finished query completes the promise
+    for (size_t i = 0; i < batch->queries.size(); ++i) {
+        pool_.Post([this, batch, i]() {
+            try {
+                batch->results[i] = server_.FindTopDocuments(batch->queries[i]);
+            } catch (...) {
+                if (!batch->failed.exchange(true)) {
+                    batch->done.set_exception(current_exception());
+                }
+            }
+            if (batch->remaining.fetch_sub(1) == 1 && !batch->failed) {
+                batch->done.set_value(move(batch->results));
+            }
+        });
+    }
+    return result;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Serves queries of a SearchServer on its own thread pool. Every instance caps the CPU
+// it uses by its thread count, so separate instances isolate tenants from each other
+// and from ingestion. The SearchServer must outlive the wrapper and must not be modified
+// while queries are in flight.
+class AsyncSearchServer {
+public:
+    using Callback = std::function<void(std::exception_ptr error, std::vector<Document> documents)>;
+
+    explicit AsyncSearchServer(const SearchServer& search_server,
+                               size_t thread_count = std::thread::hardware_concurrency());
+
+    template <typename DocumentPredicate,
+              std::enable_if_t<std::is_invocable_r_v<bool, DocumentPredicate, int, DocumentStatus, int>, int> = 0>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentPredicate predicate);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentStatus status);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query);
+
+    // The callback runs on a pool thread
+    void FindTopDocumentsAsync(std::string raw_query, DocumentStatus status, Callback callback);
+    void FindTopDocumentsAsync(std::string raw_query, Callback callback);
+
+    // Queries are spread over the pool, the future is ready when all of them are done
+    std::future<std::vector<std::vector<Document>>> ProcessQueriesAsync(std::vector<std::string> queries);
+
+    ThreadPool& GetExecutor() {
+        return pool_;
+    }
+
+private:
+    const SearchServer& server_;
+    ThreadPool pool_;
+};
+
+template <typename DocumentPredicate,
+          std::enable_if_t<std::is_invocable_r_v<bool, DocumentPredicate, int, DocumentStatus, int>, int>>
+std::future<std::vector<Document>> AsyncSearchServer::FindTopDocumentsAsync(std::string raw_query, DocumentPredicate predicate) {
+    return pool_.Submit([this, raw_query = std::move(raw_query), predicate = std::move(predicate)]() {
+        return server_.FindTopDocuments(raw_query, predicate);
+    });
+}
@@ -0,0 +1,374 @@
+#ifdef __linux__
+
+#include "corpus_loader.h"
+
+#include "profiler.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+// Whole lines of the file, the texts of the documents point into them
+struct Chunk {
+    string_view text;
+    // Lines of a streamed file, empty for a mapped one
+    vector<char> storage;
+    vector<NewDocument> documents;
+};
+
+// Chunks in file order, parsed by the pool, bounded so the reader waits for the index
+class ChunkQueue {
+public:
+    explicit ChunkQueue(size_t capacity)
+        : capacity_(max<size_t>(capacity, 1)) {
+    }
+
+    // Returns false if the consumer has stopped
+    bool Push(future<Chunk> chunk) {
+        unique_lock lock(mutex_);
+        has_room_.wait(lock, [this]() { return chunks_.size() < capacity_ || is_stopped_; });
+        if (is_stopped_) {
+            return false;
+        }
+        chunks_.push_back(move(chunk));
+        has_chunks_.notify_one();
+        return true;
+    }
+
+    // Returns false after the last chunk, then rethrows the error of the reader if any.
+    // Waits for the chunk to be parsed and rethrows the error of its lines.
+    bool Pop(Chunk& chunk) {
+        future<Chunk> parsed;
+        {
+            unique_lock lock(mutex_);
+            has_chunks_.wait(lock, [this]() { return !chunks_.empty() || is_finished_; });
+            if (chunks_.empty()) {
+                if (error_) {
+                    rethrow_exception(error_);
+                }
+                return false;
+            }
+            parsed = move(chunks_.front());
+            chunks_.pop_front();
+            has_room_.notify_one();
+        }
+        chunk = parsed.get();
+        return true;
+    }
+
+    void Finish(exception_ptr error) {
+        lock_guard guard(mutex_);
+        is_finished_ = true;
+        error_ = error;
+        has_chunks_.notify_one();
+    }
+
+    void Stop() {
+        lock_guard guard(mutex_);
+        is_stopped_ = true;
+        chunks_.clear();
+        has_room_.notify_one();
+    }
+
+private:
+    const size_t capacity_;
+    mutex mutex_;
+    condition_variable has_room_;
+    condition_variable has_chunks_;
+    deque<future<Chunk>> chunks_;
+    bool is_finished_ = false;
+    bool is_stopped_ = false;
+    exception_ptr error_;
+};
+
+class FileDescriptor {
+public:
+    explicit FileDescriptor(const string& path)
+        : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if (fd_ < 0) {
+            ThrowSystemError("open "s + path);
+        }
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor() {
+        close(fd_);
+    }
+
+    int Get() const {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+class MappedFile {
+public:
+    MappedFile(int fd, size_t size, const string& path)
+        : size_(size) {
+        data_ = static_cast<const char*>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (data_ == MAP_FAILED) {
+            ThrowSystemError("mmap "s + path);
+        }
+        madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        munmap(const_cast<char*>(data_), size_);
+    }
+
+    const char* GetData() const {
+        return data_;
+    }
+    size_t GetSize() const {
+        return size_;
+    }
+
+    // Drops the pages before the offset, so a file larger than the memory doesn't push out the index
+    void Release(size_t offset) {
+        static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t end = offset / page_size * page_size;
+        if (end > released_) {
+            madvise(const_cast<char*>(data_) + released_, end - released_, MADV_DONTNEED);
+            released_ = end;
+        }
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0;
+};
+
+template <typename Number>
+Number ParseNumber(string_view text, size_t line_number, const char* field) {
+    Number number{};
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), number);
+    if (text.empty() || error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Line "s + to_string(line_number) + ": invalid "s + field + " '"s + string(text) + "'"s);
+    }
+    return number;
+}
+
+NewDocument ParseLine(string_view line, size_t line_number) {
+    string_view fields[3];
+    for (string_view& field : fields) {
+        const size_t tab = line.find('\t');
+        if (tab == string_view::npos) {
+            throw invalid_argument("Line "s + to_string(line_number) + ": expected ID, STATUS, RATINGS and TEXT separated by tabs"s);
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+
+    NewDocument document;
+    document.id = ParseNumber<int>(fields[0], line_number, "id");
+    const int status = ParseNumber<int>(fields[1], line_number, "status");
+    if (status < 0 || status >= static_cast<int>(DOCUMENT_STATUS_COUNT)) {
+        throw invalid_argument("Line "s + to_string(line_number) + ": invalid status '"s + string(fields[1]) + "'"s);
+    }
+    document.status = static_cast<DocumentStatus>(status);
+    string_view ratings = fields[2];
+    while (true) {
+        const size_t begin = ratings.find_first_not_of(' ');
+        if (begin == string_view::npos) {
+            break;
+        }
+        ratings.remove_prefix(begin);
+        const size_t end = min(ratings.find(' '), ratings.size());
+        document.ratings.push_back(ParseNumber<int>(ratings.substr(0, end), line_number, "rating"));
+        ratings.remove_prefix(end);
+    }
+    document.text = line;
+    return document;
+}
+
+void ParseChunk(Chunk& chunk, size_t line_number) {
+    PROFILE_SCOPE("ParseChunk");
+    string_view text = chunk.text;
+    while (!text.empty()) {
+        const size_t end = min(text.find('\n'), text.size());
+        string_view line = text.substr(0, end);
+        text.remove_prefix(min(end + 1, text.size()));
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            chunk.documents.push_back(ParseLine(line, line_number));
+        }
+        ++line_number;
+    }
+}
+
+// Calls emit(text, storage) for every chunk of whole lines until it returns false
+template <typename Emit>
+void ReadMappedChunks(const MappedFile& file, size_t chunk_size, Emit emit) {
+    const char* data = file.GetData();
+    size_t offset = 0;
+    while (offset < file.GetSize()) {
+        size_t end = offset + min(chunk_size, file.GetSize() - offset);
+        if (end < file.GetSize()) {
+            const void* newline = memchr(data + end, '\n', file.GetSize() - end);
+            end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : file.GetSize();
+        }
+        if (!emit(string_view(data + offset, end - offset), vector<char>())) {
+            return;
+        }
+        offset = end;
+    }
+}
+
+template <typename Emit>
+void ReadStreamChunks(int fd, size_t chunk_size, const string& path, Emit emit) {
+    // Beginning of a line continued by the next read
+    vector<char> pending;
+    bool is_end = false;
+    while (!is_end) {
+        vector<char> buffer = move(pending);
+        pending.clear();
+        size_t filled = buffer.size();
+        buffer.resize(filled + chunk_size);
+        while (filled < buffer.size()) {
+            const ssize_t result = read(fd, buffer.data() + filled, buffer.size() - filled);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                ThrowSystemError("read "s + path);
+            }
+            if (result == 0) {
+                is_end = true;
+                break;
+            }
+            filled += static_cast<size_t>(result);
+        }
+        buffer.resize(filled);
+
+        if (!is_end) {
+            const auto last_newline = find(buffer.rbegin(), buffer.rend(), '\n');
+            if (last_newline == buffer.rend()) {
+                // A line longer than the chunk, the next read extends it
+                pending = move(buffer);
+                continue;
+            }
+            const size_t end = static_cast<size_t>(buffer.rend() - last_newline);
+            pending.assign(buffer.begin() + static_cast<ptrdiff_t>(end), buffer.end());
+            buffer.resize(end);
+        }
+        if (buffer.empty()) {
+            continue;
+        }
+        const string_view text(buffer.data(), buffer.size());
+        if (!emit(text, move(buffer))) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+CorpusLoadStats LoadCorpus(const string& path, const function<void(const vector<NewDocument>&)>& add_documents,
+                           const CorpusLoaderOptions& options) {
+    PROFILE_SCOPE("LoadCorpus");
+    if (options.chunk_size == 0) {
+        throw invalid_argument("Chunk size must be positive"s);
+    }
+
+    const FileDescriptor file(path);
+    struct stat file_stat{};
+    if (fstat(file.Get(), &file_stat) < 0) {
+        ThrowSystemError("fstat "s + path);
+    }
+    optional<MappedFile> mapped_file;
+    if (S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+        mapped_file.emplace(file.Get(), static_cast<size_t>(file_stat.st_size), path);
+    }
+
+    // Destroyed before the file, it finishes the chunks still being parsed
+    ThreadPool pool(options.parse_thread_count);
+    ChunkQueue queue(options.max_pending_chunks);
+    thread reader([&]() {
+        exception_ptr error;
+        try {
+            size_t line_number = 1;
+            // The text moves with the storage, a vector keeps its buffer when moved
+            const auto emit = [&queue, &pool, &line_number](string_view text, vector<char> storage) {
+                Chunk chunk;
+                chunk.text = text;
+                chunk.storage = move(storage);
+                // Counting the lines is much cheaper than parsing them, so the chunks
+                // know their first line before they are parsed in parallel
+                const size_t first_line = line_number;
+                line_number += static_cast<size_t>(count(text.begin(), text.end(), '\n'));
+                return queue.Push(pool.Submit([chunk = move(chunk), first_line]() mutable {
+                    ParseChunk(chunk, first_line);
+                    return move(chunk);
+                }));
+            };
+            if (mapped_file) {
+                ReadMappedChunks(*mapped_file, options.chunk_size, emit);
+            }
+            else if (!S_ISREG(file_stat.st_mode)) {
+                ReadStreamChunks(file.Get(), options.chunk_size, path, emit);
+            }
+        }
+        catch (...) {
+            error = current_exception();
+        }
+        queue.Finish(error);
+    });
+
+    CorpusLoadStats stats;
+    try {
+        Chunk chunk;
+        while (queue.Pop(chunk)) {
+            PROFILE_SCOPE("AddChunk");
+            add_documents(chunk.documents);
+            stats.document_count += chunk.documents.size();
+            stats.byte_count += chunk.text.size();
+            ++stats.chunk_count;
+            if (mapped_file) {
+                mapped_file->Release(static_cast<size_t>(chunk.text.data() + chunk.text.size() - mapped_file->GetData()));
+            }
+        }
+    }
+    catch (...) {
+        queue.Stop();
+        reader.join();
+        throw;
+    }
+    reader.join();
+    return stats;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "search_server.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CorpusLoaderOptions {
+    // Documents of a chunk are added by one AddDocuments call, chunks end on line boundaries
+    size_t chunk_size = 16 * 1024 * 1024;
+    // Chunks being parsed or waiting for the index, the reader stops when the index falls behind
+    size_t max_pending_chunks = 4;
+    // Threads parsing the lines of the chunks
+    size_t parse_thread_count = std::thread::hardware_concurrency();
+};
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    size_t chunk_count = 0;
+};
+
+// Loads a corpus file with a document per line:
+//
+//     ID <tab> STATUS <tab> RATINGS <tab> TEXT
+//
+// STATUS is a number of DocumentStatus and RATINGS are separated by spaces and may be empty.
+// Empty lines are skipped. Regular files are memory-mapped, other files (pipes) are read
+// into buffers. A reader thread splits the file into chunks whose lines are parsed on a
+// thread pool while the calling thread adds the previous chunks in file order, their texts
+// are split into words in parallel by AddDocuments.
+//
+// Throws invalid_argument with the line number for a malformed line and system_error if the
+// file can't be read. The documents of the chunks before the error stay in the index.
+CorpusLoadStats LoadCorpus(const std::string& path, const std::function<void(const std::vector<NewDocument>&)>& add_documents,
+                           const CorpusLoaderOptions& options = CorpusLoaderOptions());
+
+// Works with any index with AddDocuments, e.g. SearchServer or DurableSearchServer
+template <typename Index>
+CorpusLoadStats LoadCorpus(Index& index, const std::string& path, const CorpusLoaderOptions& options = CorpusLoaderOptions()) {
+    return LoadCorpus(path, [&index](const std::vector<NewDocument>& documents) { index.AddDocuments(documents); }, options);
+}
+
+#endif
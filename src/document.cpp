@@ -5,8 +5,6 @@
 
 using namespace std::string_literals;
 
-const double MAX_RELEVANCE_ACCURACY = 1e-6;
-
 Document::Document(int input_id, double input_relevance, int input_rating)
     : id(input_id)
     , relevance(input_relevance)
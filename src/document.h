@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
@@ -14,11 +16,19 @@ enum class DocumentStatus
     REMOVED
 };
 
+inline constexpr size_t DOCUMENT_STATUS_COUNT = 4;
+// Documents with closer relevances are ordered by rating
+inline constexpr double MAX_RELEVANCE_ACCURACY = 1e-6;
+
 struct DocumentData
 {
     int rating;
     DocumentStatus status;
     std::map<std::string_view, double> word_frequency;
+    // Internal document number used in posting lists
+    uint32_t ordinal = 0;
+    // Number of non stop words
+    uint32_t word_count = 0;
 };
 
 struct Document {
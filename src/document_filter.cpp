@@ -0,0 +1,43 @@
+#include "document_filter.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+DocumentFilter& DocumentFilter::SetStatus(DocumentStatus status) {
+    return SetStatuses({ status });
+}
+
+DocumentFilter& DocumentFilter::SetStatuses(initializer_list<DocumentStatus> statuses) {
+    status_mask_ = 0;
+    for (DocumentStatus status : statuses) {
+        status_mask_ |= 1u << static_cast<uint32_t>(status);
+    }
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetRatingRange(int min_rating, int max_rating) {
+    if (min_rating > max_rating) {
+        throw invalid_argument("Minimal rating "s + to_string(min_rating) + " is greater than maximal "s + to_string(max_rating));
+    }
+    min_rating_ = min_rating;
+    max_rating_ = max_rating;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIds(vector<int> document_ids) {
+    sort(document_ids.begin(), document_ids.end());
+    ids_ = move(document_ids);
+    has_ids_ = true;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIdRange(int first_id, int last_id) {
+    if (first_id > last_id) {
+        throw invalid_argument("First id "s + to_string(first_id) + " is greater than last "s + to_string(last_id));
+    }
+    first_id_ = first_id;
+    last_id_ = last_id;
+    return *this;
+}
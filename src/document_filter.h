@@ -0,0 +1,87 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+// Declarative document predicate. SearchServer scans only the posting partitions of the
+// accepted statuses and compiles the rating and id constraints into a bit per document,
+// which is applied to the candidates 64 documents at a time instead of calling a function.
+// It is also callable as an ordinary (id, status, rating) predicate.
+class DocumentFilter {
+public:
+    static constexpr uint32_t ALL_STATUSES = (1u << DOCUMENT_STATUS_COUNT) - 1;
+
+    // Accepts every document
+    DocumentFilter() = default;
+
+    DocumentFilter& SetStatus(DocumentStatus status);
+    DocumentFilter& SetStatuses(std::initializer_list<DocumentStatus> statuses);
+    // Inclusive bounds
+    DocumentFilter& SetRatingRange(int min_rating, int max_rating);
+    DocumentFilter& SetIds(std::vector<int> document_ids);
+    // Inclusive bounds
+    DocumentFilter& SetIdRange(int first_id, int last_id);
+
+    // Bit i is set if DocumentStatus(i) is accepted
+    uint32_t GetStatusMask() const {
+        return status_mask_;
+    }
+
+    bool HasStatusFilter() const {
+        return status_mask_ != ALL_STATUSES;
+    }
+
+    bool AcceptsStatus(DocumentStatus status) const {
+        return (status_mask_ >> static_cast<uint32_t>(status)) & 1;
+    }
+
+    bool HasRatingRange() const {
+        return min_rating_ != std::numeric_limits<int>::min() || max_rating_ != std::numeric_limits<int>::max();
+    }
+    int GetMinRating() const {
+        return min_rating_;
+    }
+    int GetMaxRating() const {
+        return max_rating_;
+    }
+
+    bool HasIds() const {
+        return has_ids_;
+    }
+    // Sorted
+    const std::vector<int>& GetIds() const {
+        return ids_;
+    }
+
+    bool HasIdRange() const {
+        return first_id_ != std::numeric_limits<int>::min() || last_id_ != std::numeric_limits<int>::max();
+    }
+    int GetFirstId() const {
+        return first_id_;
+    }
+    int GetLastId() const {
+        return last_id_;
+    }
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return AcceptsStatus(status)
+            && rating >= min_rating_ && rating <= max_rating_
+            && document_id >= first_id_ && document_id <= last_id_
+            && (!has_ids_ || std::binary_search(ids_.begin(), ids_.end(), document_id));
+    }
+
+private:
+    uint32_t status_mask_ = ALL_STATUSES;
+    int min_rating_ = std::numeric_limits<int>::min();
+    int max_rating_ = std::numeric_limits<int>::max();
+    int first_id_ = std::numeric_limits<int>::min();
+    int last_id_ = std::numeric_limits<int>::max();
+    bool has_ids_ = false;
+    // Sorted
+    std::vector<int> ids_;
+};
@@ -0,0 +1,205 @@
+#include "document_store.h"
+
+#include "profiler.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 12;
+// Lengths of 15 and more continue in the following bytes
+constexpr size_t LENGTH_MASK = 15;
+
+uint32_t ReadUint32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void WriteLength(string& out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+void WriteSequence(string& out, string_view literals, size_t offset, size_t match_length) {
+    const size_t match_code = match_length - MIN_MATCH;
+    out.push_back(static_cast<char>((min(literals.size(), LENGTH_MASK) << 4) | min(match_code, LENGTH_MASK)));
+    if (literals.size() >= LENGTH_MASK) {
+        WriteLength(out, literals.size() - LENGTH_MASK);
+    }
+    out.append(literals);
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (match_code >= LENGTH_MASK) {
+        WriteLength(out, match_code - LENGTH_MASK);
+    }
+}
+
+void WriteLastLiterals(string& out, string_view literals) {
+    out.push_back(static_cast<char>(min(literals.size(), LENGTH_MASK) << 4));
+    if (literals.size() >= LENGTH_MASK) {
+        WriteLength(out, literals.size() - LENGTH_MASK);
+    }
+    out.append(literals);
+}
+
+size_t ReadLength(string_view block, size_t& position, size_t length) {
+    if (length != LENGTH_MASK) {
+        return length;
+    }
+    uint8_t byte = 255;
+    while (byte == 255) {
+        if (position >= block.size()) {
+            throw logic_error("Truncated compressed block"s);
+        }
+        byte = static_cast<uint8_t>(block[position++]);
+        length += byte;
+    }
+    return length;
+}
+
+} // namespace
+
+string CompressBlock(string_view data) {
+    string out;
+    out.reserve(data.size() / 2 + 16);
+    vector<int64_t> table(size_t(1) << HASH_BITS, -1);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH <= data.size()) {
+        const uint32_t sequence = ReadUint32(data.data() + position);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const int64_t candidate = table[hash];
+        table[hash] = static_cast<int64_t>(position);
+        if (candidate < 0 || position - static_cast<size_t>(candidate) > MAX_OFFSET
+            || ReadUint32(data.data() + candidate) != sequence) {
+            ++position;
+            continue;
+        }
+
+        const size_t match = static_cast<size_t>(candidate);
+        size_t length = MIN_MATCH;
+        while (position + length < data.size() && data[match + length] == data[position + length]) {
+            ++length;
+        }
+        WriteSequence(out, data.substr(anchor, position - anchor), position - match, length);
+        position += length;
+        anchor = position;
+    }
+    WriteLastLiterals(out, data.substr(anchor));
+    return out;
+}
+
+string DecompressBlock(string_view block, size_t size) {
+    string out;
+    out.reserve(size);
+    size_t position = 0;
+    while (out.size() < size) {
+        if (position >= block.size()) {
+            throw logic_error("Truncated compressed block"s);
+        }
+        const uint8_t token = static_cast<uint8_t>(block[position++]);
+        const size_t literal_count = ReadLength(block, position, token >> 4);
+        if (literal_count > block.size() - position) {
+            throw logic_error("Truncated compressed block"s);
+        }
+        out.append(block.substr(position, literal_count));
+        position += literal_count;
+        if (out.size() >= size || position == block.size()) {
+            break;
+        }
+
+        if (block.size() - position < 2) {
+            throw logic_error("Truncated compressed block"s);
+        }
+        const size_t offset = static_cast<uint8_t>(block[position]) | (static_cast<size_t>(static_cast<uint8_t>(block[position + 1])) << 8);
+        position += 2;
+        const size_t length = ReadLength(block, position, token & LENGTH_MASK) + MIN_MATCH;
+        if (offset == 0 || offset > out.size()) {
+            throw logic_error("Invalid match offset in compressed block"s);
+        }
+        // The match can overlap the bytes it produces
+        const size_t start = out.size() - offset;
+        for (size_t i = 0; i < length; ++i) {
+            out.push_back(out[start + i]);
+        }
+    }
+    out.resize(min(out.size(), size));
+    return out;
+}
+
+DocumentStore::DocumentStore(size_t block_size)
+    : block_size_(block_size) {
+    if (block_size_ == 0) {
+        throw invalid_argument("Block size must be positive"s);
+    }
+}
+
+void DocumentStore::Add(int document_id, string text) {
+    Remove(document_id);
+    locations_[document_id] = { blocks_.size(), pending_texts_.size(), text.size() };
+    pending_size_ += text.size();
+    pending_texts_.push_back(move(text));
+    pending_ids_.push_back(document_id);
+    if (pending_size_ >= block_size_) {
+        Seal();
+    }
+}
+
+void DocumentStore::Remove(int document_id) {
+    const auto it = locations_.find(document_id);
+    if (it == locations_.end()) {
+        return;
+    }
+    const Location& location = it->second;
+    if (location.block == blocks_.size()) {
+        pending_size_ -= location.size;
+        string().swap(pending_texts_[location.offset]);
+    }
+    else if (--blocks_[location.block].live_count == 0) {
+        string().swap(blocks_[location.block].data);
+    }
+    locations_.erase(it);
+}
+
+string DocumentStore::Get(int document_id) const {
+    const Location& location = locations_.at(document_id);
+    if (location.block == blocks_.size()) {
+        return pending_texts_[location.offset];
+    }
+    PROFILE_SCOPE("DecompressBlock");
+    const Block& block = blocks_[location.block];
+    return DecompressBlock(block.data, location.offset + location.size).substr(location.offset);
+}
+
+void DocumentStore::Seal() {
+    PROFILE_SCOPE("CompressBlock");
+    Block block;
+    string raw;
+    raw.reserve(pending_size_);
+    for (size_t i = 0; i < pending_texts_.size(); ++i) {
+        // Texts removed or replaced while the block was filled are dropped
+        const auto it = locations_.find(pending_ids_[i]);
+        if (it == locations_.end() || it->second.block != blocks_.size() || it->second.offset != i) {
+            continue;
+        }
+        it->second.offset = raw.size();
+        raw.append(pending_texts_[i]);
+        ++block.live_count;
+    }
+    block.raw_size = raw.size();
+    block.data = CompressBlock(raw);
+    block.data.shrink_to_fit();
+    blocks_.push_back(move(block));
+
+    pending_texts_.clear();
+    pending_ids_.clear();
+    pending_size_ = 0;
+}
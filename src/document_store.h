@@ -0,0 +1,93 @@
+#pragma once
+
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// LZ77 compression of a block in the format of LZ4 sequences: a token with the literal
+// and match lengths, the literals, a 2 byte offset and the extra match length bytes
+std::string CompressBlock(std::string_view data);
+// Decompresses the first size bytes of the block
+std::string DecompressBlock(std::string_view block, size_t size);
+
+// Texts of the documents by id. New texts are collected until they fill a block, which is
+// then compressed as a whole, so the short texts of a block share their dictionary.
+// Reading a text decompresses its block up to the end of the text. Const methods can be
+// called concurrently.
+class DocumentStore {
+public:
+    inline static constexpr size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+
+    explicit DocumentStore(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    // The text is moved into the block being filled
+    void Add(int document_id, std::string text);
+    // The memory of a compressed block is released with the last of its documents
+    void Remove(int document_id);
+
+    // Throws out_of_range if there is no such document
+    std::string Get(int document_id) const;
+    bool Contains(int document_id) const {
+        return locations_.count(document_id) > 0;
+    }
+    size_t GetDocumentCount() const {
+        return locations_.size();
+    }
+
+    // Calls func(bytes) for every heap block of the store
+    template <typename Func>
+    void ForEachBuffer(Func func) const;
+
+private:
+    struct Location {
+        // Index of the compressed block, blocks_.size() for the block being filled
+        size_t block;
+        // Offset in the block, or index in pending_texts_ for the block being filled
+        size_t offset;
+        size_t size;
+    };
+
+    struct Block {
+        std::string data;
+        size_t raw_size = 0;
+        size_t live_count = 0;
+    };
+
+    void Seal();
+
+    size_t block_size_;
+    std::map<int, Location> locations_;
+    std::vector<Block> blocks_;
+    // Texts of the block being filled with their documents
+    std::vector<std::string> pending_texts_;
+    std::vector<int> pending_ids_;
+    size_t pending_size_ = 0;
+};
+
+template <typename Func>
+void DocumentStore::ForEachBuffer(Func func) const {
+    for (size_t i = 0; i < locations_.size(); ++i) {
+        func(TREE_NODE_HEADER_SIZE + sizeof(std::pair<const int, Location>));
+    }
+    for (size_t bytes : { blocks_.capacity() * sizeof(Block), pending_texts_.capacity() * sizeof(std::string),
+                          pending_ids_.capacity() * sizeof(int) }) {
+        if (bytes > 0) {
+            func(bytes);
+        }
+    }
+    for (const Block& block : blocks_) {
+        if (GetHeapSize(block.data) > 0) {
+            func(GetHeapSize(block.data));
+        }
+    }
+    for (const std::string& text : pending_texts_) {
+        if (GetHeapSize(text) > 0) {
+            func(GetHeapSize(text));
+        }
+    }
+}
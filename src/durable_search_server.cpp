@@ -0,0 +1,224 @@
+#ifdef __linux__
+
+#include "durable_search_server.h"
+
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+Request MakeAddRequest(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings,
+                       RequestType type = RequestType::ADD_DOCUMENT) {
+    Request request;
+    request.type = type;
+    request.document_id = document_id;
+    request.status = status;
+    request.ratings = ratings;
+    request.text = string(document);
+    return request;
+}
+
+} // namespace
+
+DurableSearchServer::DurableSearchServer(const string& log_path, const string& stop_words,
+                                         const IndexOptions& options, const WalOptions& log_options)
+    : server_(stop_words, options)
+    , log_(log_path, log_options) {
+    log_.Recover([this](vector<Request>& records) { Replay(records); });
+}
+
+template <typename Check, typename Apply>
+void DurableSearchServer::LogAndApply(const vector<Request>& requests, Check check, Apply apply) {
+    uint64_t sequence_number = 0;
+    uint64_t ticket = 0;
+    {
+        lock_guard guard(order_mutex_);
+        check();
+        for (const Request& request : requests) {
+            sequence_number = log_.Append(request);
+        }
+        ticket = next_ticket_++;
+        for (const Request& request : requests) {
+            if (request.type == RequestType::ADD_DOCUMENT || request.type == RequestType::UPSERT_DOCUMENT) {
+                pending_documents_[request.document_id] = { true, ticket };
+            }
+            else if (request.type == RequestType::REMOVE_DOCUMENT) {
+                pending_documents_[request.document_id] = { false, ticket };
+            }
+        }
+    }
+
+    exception_ptr error;
+    try {
+        log_.Sync(sequence_number);
+    }
+    catch (...) {
+        // Every later change fails too, so the index stays a prefix of the log
+        error = current_exception();
+    }
+
+    unique_lock order_lock(order_mutex_);
+    applied_.wait(order_lock, [this, ticket]() { return applied_ticket_ == ticket; });
+    if (!error) {
+        try {
+            lock_guard guard(mutex_);
+            apply();
+        }
+        catch (...) {
+            error = current_exception();
+        }
+    }
+    for (const Request& request : requests) {
+        const auto it = pending_documents_.find(request.document_id);
+        if (it != pending_documents_.end() && it->second.ticket == ticket) {
+            pending_documents_.erase(it);
+        }
+    }
+    ++applied_ticket_;
+    applied_.notify_all();
+    order_lock.unlock();
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+bool DurableSearchServer::HasDocument(int document_id) const {
+    const auto it = pending_documents_.find(document_id);
+    return it != pending_documents_.end() ? it->second.exists : server_.HasDocument(document_id);
+}
+
+void DurableSearchServer::CheckNewDocumentId(int document_id) const {
+    if (document_id < 0) {
+        throw invalid_argument("Document id must be positive"s);
+    }
+    if (HasDocument(document_id)) {
+        throw invalid_argument("Document with id = "s + to_string(document_id) + " already exists"s);
+    }
+}
+
+void DurableSearchServer::CheckDocumentExists(int document_id) const {
+    if (!HasDocument(document_id)) {
+        throw out_of_range("There is no document with id = "s + to_string(document_id));
+    }
+}
+
+void DurableSearchServer::AddDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    server_.CheckDocumentText(document);
+    LogAndApply({ MakeAddRequest(document_id, document, status, ratings) },
+        [this, document_id]() { CheckNewDocumentId(document_id); },
+        [&]() { server_.AddDocument(document_id, document, status, ratings); });
+}
+
+void DurableSearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    if (documents.empty()) {
+        return;
+    }
+    vector<Request> requests;
+    requests.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        server_.CheckDocumentText(document.text);
+        requests.push_back(MakeAddRequest(document.id, document.text, document.status, document.ratings));
+    }
+    LogAndApply(requests,
+        [this, &documents]() {
+            set<int> new_ids;
+            for (const NewDocument& document : documents) {
+                CheckNewDocumentId(document.id);
+                if (!new_ids.insert(document.id).second) {
+                    throw invalid_argument("Document with id = "s + to_string(document.id) + " is added twice"s);
+                }
+            }
+        },
+        [this, &documents]() { server_.AddDocuments(documents); });
+}
+
+void DurableSearchServer::UpsertDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    server_.CheckDocumentText(document);
+    LogAndApply({ MakeAddRequest(document_id, document, status, ratings, RequestType::UPSERT_DOCUMENT) },
+        [this, document_id]() {
+            if (!HasDocument(document_id)) {
+                CheckNewDocumentId(document_id);
+            }
+        },
+        [&]() { server_.UpsertDocument(document_id, document, status, ratings); });
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    Request request;
+    request.type = RequestType::REMOVE_DOCUMENT;
+    request.document_id = document_id;
+    LogAndApply({ request }, []() {}, [this, document_id]() { server_.RemoveDocument(document_id); });
+}
+
+void DurableSearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    Request request;
+    request.type = RequestType::UPDATE_DOCUMENT_STATUS;
+    request.document_id = document_id;
+    request.status = status;
+    LogAndApply({ request },
+        [this, document_id]() { CheckDocumentExists(document_id); },
+        [this, document_id, status]() { server_.UpdateDocumentStatus(document_id, status); });
+}
+
+void DurableSearchServer::UpdateDocumentRatings(int document_id, const vector<int>& ratings) {
+    Request request;
+    request.type = RequestType::UPDATE_DOCUMENT_RATINGS;
+    request.document_id = document_id;
+    request.ratings = ratings;
+    LogAndApply({ request },
+        [this, document_id]() { CheckDocumentExists(document_id); },
+        [&]() { server_.UpdateDocumentRatings(document_id, ratings); });
+}
+
+tuple<vector<string>, DocumentStatus> DurableSearchServer::MatchDocument(const string_view& raw_query, int document_id) const {
+    shared_lock guard(mutex_);
+    const auto [words, status] = server_.MatchDocument(raw_query, document_id);
+    return { vector<string>(words.begin(), words.end()), status };
+}
+
+string DurableSearchServer::GetDocumentText(int document_id) const {
+    shared_lock guard(mutex_);
+    return server_.GetDocumentText(document_id);
+}
+
+int DurableSearchServer::GetDocumentCount() const {
+    shared_lock guard(mutex_);
+    return server_.GetDocumentCount();
+}
+
+void DurableSearchServer::Replay(vector<Request>& records) {
+    PROFILE_SCOPE("ReplayLog");
+    vector<NewDocument> documents;
+    const auto add_documents = [this, &documents]() {
+        server_.AddDocuments(documents);
+        documents.clear();
+    };
+    for (Request& request : records) {
+        if (request.type == RequestType::ADD_DOCUMENT) {
+            documents.push_back({ request.document_id, request.text, request.status, move(request.ratings) });
+        }
+        else if (request.type == RequestType::REMOVE_DOCUMENT) {
+            // A removal can refer to a document of the pending additions
+            add_documents();
+            server_.RemoveDocument(request.document_id);
+        }
+        else if (request.type == RequestType::UPSERT_DOCUMENT) {
+            add_documents();
+            server_.UpsertDocument(request.document_id, request.text, request.status, request.ratings);
+        }
+        else if (request.type == RequestType::UPDATE_DOCUMENT_STATUS) {
+            add_documents();
+            server_.UpdateDocumentStatus(request.document_id, request.status);
+        }
+        else if (request.type == RequestType::UPDATE_DOCUMENT_RATINGS) {
+            add_documents();
+            server_.UpdateDocumentRatings(request.document_id, request.ratings);
+        }
+    }
+    add_documents();
+}
+
+#endif
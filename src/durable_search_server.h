@@ -0,0 +1,82 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// SearchServer which logs every change to a WriteAheadLog before applying it.
+// The constructor restores the server from the log: consecutive additions are replayed
+// through the bulk AddDocuments. A change is checked against the index and the changes
+// logged before it, appended to the log and applied only when it is on disk, so queries
+// never see a change a crash could lose. Writers wait for the disk without locks, so
+// concurrent writers share their syncs, and their changes are applied in the log order.
+class DurableSearchServer {
+public:
+    explicit DurableSearchServer(const std::string& log_path, const std::string& stop_words = std::string(),
+                                 const IndexOptions& options = IndexOptions(), const WalOptions& log_options = WalOptions());
+
+    // Return when the change is on disk and applied, invalid changes throw without being logged
+    void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void UpsertDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+    void UpdateDocumentRatings(int document_id, const std::vector<int>& ratings);
+
+    template<typename... Args>
+    std::vector<Document> FindTopDocuments(const Args&... args) const {
+        std::shared_lock guard(mutex_);
+        return server_.FindTopDocuments(args...);
+    }
+    // The words are copied, views into the index would outlive the lock
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
+    std::string GetDocumentText(int document_id) const;
+    int GetDocumentCount() const;
+
+    size_t GetCommitCount() const {
+        return log_.GetCommitCount();
+    }
+
+private:
+    struct PendingDocument {
+        // Whether the document exists after the change
+        bool exists;
+        uint64_t ticket;
+    };
+
+    // Records of a chunk of the log
+    void Replay(std::vector<Request>& records);
+    // Calls check, appends the records and waits for the disk, then calls apply in the log order
+    template <typename Check, typename Apply>
+    void LogAndApply(const std::vector<Request>& requests, Check check, Apply apply);
+    // Require order_mutex_, see the documents of the logged changes
+    bool HasDocument(int document_id) const;
+    void CheckNewDocumentId(int document_id) const;
+    void CheckDocumentExists(int document_id) const;
+
+    // Exclusive while a change is applied, shared by the queries
+    mutable std::shared_mutex mutex_;
+    SearchServer server_;
+    WriteAheadLog log_;
+
+    // Orders the writers: changes are checked and logged, and then applied, in ticket order.
+    // The index changes only under it, so a writer holding it can read the index without mutex_
+    std::mutex order_mutex_;
+    std::condition_variable applied_;
+    uint64_t next_ticket_ = 0;
+    uint64_t applied_ticket_ = 0;
+    // Documents added or removed by the changes logged but not yet applied
+    std::map<int, PendingDocument> pending_documents_;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "generators.h"
+
+#include <algorithm>
+
+using namespace std;
+
+string GenerateWord(mt19937& generator, int max_word_lenght) {
+    int lenght = uniform_int_distribution(1, max_word_lenght)(generator);
+    string word;
+    word.reserve(lenght);
+    for (int i = 0; i < lenght; ++i) {
+        word.push_back(uniform_int_distribution(97, 122)(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateWords(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GeneratePhrase(mt19937& generator, const vector<string>& words, int max_word_count_in_query, double minus_frequency) {
+    const int word_count = uniform_int_distribution(1, max_word_count_in_query)(generator);
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_frequency) {
+            query.push_back('-');
+        }
+        query += words[uniform_int_distribution<int>(0, words.size() - 1)(generator)];
+    }
+    return query;
+}
+
+vector<string> GeneratePhrases(mt19937& generator, const vector<string>& words, int query_count, int max_word_count_in_query, double minus_frequency) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GeneratePhrase(generator, words, max_word_count_in_query, minus_frequency));
+    }
+    return queries;
+}
+
+vector<int> GenerateRatings(mt19937& generator, int max_rating_count, int min_rating, int max_rating) {
+    const int rating_count = uniform_int_distribution(0, max_rating_count)(generator);
+    vector<int> ratings;
+    ratings.reserve(rating_count);
+    for (int i = 0; i < rating_count; ++i) {
+        ratings.push_back(uniform_int_distribution(min_rating, max_rating)(generator));
+    }
+    return ratings;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string GenerateWord(std::mt19937& generator, int max_word_lenght);
+
+std::vector<std::string> GenerateWords(std::mt19937& generator, int word_count, int max_length);
+
+std::string GeneratePhrase(std::mt19937& generator, const std::vector<std::string>& words, int max_word_count_in_query, double minus_frequency = 0.0);
+
+std::vector<std::string> GeneratePhrases(std::mt19937& generator, const std::vector<std::string>& words, int query_count, int max_word_count_in_query, double minus_frequency = 0.0);
+
+std::vector<int> GenerateRatings(std::mt19937& generator, int max_rating_count, int min_rating, int max_rating);
@@ -0,0 +1,124 @@
+#include "impact_list.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+bool IsHigher(const ImpactList::Entry& lhs, const ImpactList::Entry& rhs) {
+    return lhs.term_freq > rhs.term_freq || (lhs.term_freq == rhs.term_freq && lhs.document < rhs.document);
+}
+
+} // namespace
+
+void ImpactList::Add(const PostingList& postings, uint32_t document, float term_freq) {
+    if (is_enabled_) {
+        Insert({ document, term_freq });
+    }
+    else if (postings.size() > MIN_POSTING_COUNT) {
+        Rebuild(postings);
+    }
+}
+
+void ImpactList::Update(const PostingList& postings, uint32_t document) {
+    if (!is_enabled_) {
+        if (postings.size() > MIN_POSTING_COUNT) {
+            Rebuild(postings);
+        }
+        return;
+    }
+    const float* term_freq = postings.FindTermFreq(document);
+    if (term_freq == nullptr) {
+        return;
+    }
+    const auto it = find_if(entries_.begin(), entries_.end(), [document](const Entry& entry) { return entry.document == document; });
+    if (it != entries_.end()) {
+        entries_.erase(it);
+    }
+    // A lowered frequency of a posting in the tail leaves the bound higher than needed, which is safe
+    Insert({ document, *term_freq });
+}
+
+void ImpactList::Remove(const PostingList& postings, uint32_t document) {
+    if (!is_enabled_) {
+        return;
+    }
+    // Hysteresis keeps a list around the threshold from being rebuilt on every change
+    if (postings.size() < MIN_POSTING_COUNT / 2) {
+        Disable();
+        return;
+    }
+    const auto it = find_if(entries_.begin(), entries_.end(), [document](const Entry& entry) { return entry.document == document; });
+    if (it == entries_.end()) {
+        return;
+    }
+    entries_.erase(it);
+    // The postings of the tail can't be promoted without a scan
+    if (entries_.size() < CAPACITY / 2) {
+        Rebuild(postings);
+    }
+}
+
+void ImpactList::Remove(const PostingList& postings, const vector<uint32_t>& documents) {
+    if (!is_enabled_) {
+        return;
+    }
+    if (postings.size() < MIN_POSTING_COUNT / 2) {
+        Disable();
+        return;
+    }
+    entries_.erase(remove_if(entries_.begin(), entries_.end(),
+        [&documents](const Entry& entry) {
+            return binary_search(documents.begin(), documents.end(), entry.document);
+        }), entries_.end());
+    if (entries_.size() < CAPACITY / 2) {
+        Rebuild(postings);
+    }
+}
+
+void ImpactList::Add(const PostingList& postings, const PostingList& added) {
+    if (!is_enabled_) {
+        if (postings.size() > MIN_POSTING_COUNT) {
+            Rebuild(postings);
+        }
+        return;
+    }
+    added.ForEach([this](uint32_t document, float term_freq) {
+        Insert({ document, term_freq });
+    });
+}
+
+void ImpactList::RenumberDocuments(const vector<uint32_t>& new_documents) {
+    for (Entry& entry : entries_) {
+        entry.document = new_documents[entry.document];
+    }
+}
+
+void ImpactList::Insert(Entry entry) {
+    if (entries_.size() == CAPACITY) {
+        if (!IsHigher(entry, entries_.back())) {
+            tail_bound_ = max(tail_bound_, entry.term_freq);
+            return;
+        }
+        tail_bound_ = max(tail_bound_, entries_.back().term_freq);
+        entries_.pop_back();
+    }
+    entries_.insert(upper_bound(entries_.begin(), entries_.end(), entry, IsHigher), entry);
+}
+
+void ImpactList::Disable() {
+    vector<Entry>().swap(entries_);
+    tail_bound_ = 0.0f;
+    is_enabled_ = false;
+}
+
+void ImpactList::Rebuild(const PostingList& postings) {
+    is_enabled_ = true;
+    entries_.clear();
+    entries_.reserve(CAPACITY);
+    tail_bound_ = 0.0f;
+    postings.ForEach([this](uint32_t document, float term_freq) {
+        Insert({ document, term_freq });
+    });
+}
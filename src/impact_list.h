@@ -0,0 +1,64 @@
+#pragma once
+
+#include "posting_list.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Postings of a long list with the highest term frequencies, kept up to date with the list.
+// A query of a few words takes its candidates from them instead of scanning the whole lists:
+// the postings left out score at most the tail bound, so once the best candidates are above
+// it they are the best documents. Lists of at most MIN_POSTING_COUNT documents keep no entries
+// and are scanned as they are.
+class ImpactList {
+public:
+    inline static constexpr size_t MIN_POSTING_COUNT = 256;
+    inline static constexpr size_t CAPACITY = 64;
+
+    struct Entry {
+        uint32_t document;
+        float term_freq;
+    };
+
+    // Called after a new posting has been added to the list
+    void Add(const PostingList& postings, uint32_t document, float term_freq);
+    // Called after the frequency of a posting has changed
+    void Update(const PostingList& postings, uint32_t document);
+    // Called after the posting of the document has been removed
+    void Remove(const PostingList& postings, uint32_t document);
+    // Called after the postings of the documents, given in ascending order, have been removed
+    void Remove(const PostingList& postings, const std::vector<uint32_t>& documents);
+    // Called after the postings of another list have been merged into the list
+    void Add(const PostingList& postings, const PostingList& added);
+    // Same increasing mapping as PostingList::RenumberDocuments, keeps the order of the entries
+    void RenumberDocuments(const std::vector<uint32_t>& new_documents);
+
+    bool IsEnabled() const {
+        return is_enabled_;
+    }
+    // By descending term frequency
+    const std::vector<Entry>& GetEntries() const {
+        return entries_;
+    }
+    // No posting missing from the entries has a higher term frequency
+    float GetTailBound() const {
+        return tail_bound_;
+    }
+
+    template <typename Func>
+    void ForEachBuffer(Func func) const {
+        if (entries_.capacity() > 0) {
+            func(entries_.capacity() * sizeof(Entry));
+        }
+    }
+
+private:
+    void Insert(Entry entry);
+    void Disable();
+    void Rebuild(const PostingList& postings);
+
+    std::vector<Entry> entries_;
+    float tail_bound_ = 0.0f;
+    bool is_enabled_ = false;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "profiler.h"
+
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -28,8 +30,5 @@ private:
     const Clock::time_point start_time_ = Clock::now();
 };
 
-#define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
-#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
-#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 #define LOG_DURATION_STREAM(x, c) LogDuration UNIQUE_VAR_NAME_PROFILE(x, c)
@@ -0,0 +1,48 @@
+#include "memory_stats.h"
+
+using namespace std;
+
+namespace {
+
+void PrintUsage(ostream& out, const char* name, const MemoryUsage& usage) {
+    out << '"' << name << "\": {\"bytes\": "s << usage.bytes << ", \"count\": "s << usage.count << "}, "s;
+}
+
+} // namespace
+
+size_t MemoryStats::GetTotalBytes() const {
+    return term_strings.bytes + dictionary.bytes + postings.bytes + posting_bitmaps.bytes + forward_index.bytes
+        + metadata.bytes + stop_words.bytes + typo_index.bytes + documents.bytes + allocator_overhead;
+}
+
+MemoryStats& MemoryStats::operator+=(const MemoryStats& other) {
+    term_strings += other.term_strings;
+    dictionary += other.dictionary;
+    postings += other.postings;
+    posting_bitmaps += other.posting_bitmaps;
+    forward_index += other.forward_index;
+    metadata += other.metadata;
+    stop_words += other.stop_words;
+    typo_index += other.typo_index;
+    documents += other.documents;
+    allocator_overhead += other.allocator_overhead;
+    allocation_count += other.allocation_count;
+    return *this;
+}
+
+ostream& operator<<(ostream& out, const MemoryStats& stats) {
+    out << '{';
+    PrintUsage(out, "term_strings", stats.term_strings);
+    PrintUsage(out, "dictionary", stats.dictionary);
+    PrintUsage(out, "postings", stats.postings);
+    PrintUsage(out, "posting_bitmaps", stats.posting_bitmaps);
+    PrintUsage(out, "forward_index", stats.forward_index);
+    PrintUsage(out, "metadata", stats.metadata);
+    PrintUsage(out, "stop_words", stats.stop_words);
+    PrintUsage(out, "typo_index", stats.typo_index);
+    PrintUsage(out, "documents", stats.documents);
+    out << "\"allocator_overhead\": "s << stats.allocator_overhead
+        << ", \"allocation_count\": "s << stats.allocation_count
+        << ", \"total_bytes\": "s << stats.GetTotalBytes() << '}';
+    return out;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+// Heap blocks requested through the allocators sharing the counter. Not synchronized,
+// like the containers of SearchServer it is modified by a single writer.
+class AllocationCounter {
+public:
+    void Allocate(size_t bytes) {
+        bytes_ += bytes;
+        overhead_ += EstimateOverhead(bytes);
+        ++allocation_count_;
+    }
+
+    void Deallocate(size_t bytes) {
+        bytes_ -= bytes;
+        overhead_ -= EstimateOverhead(bytes);
+        --allocation_count_;
+    }
+
+    // Live bytes and blocks
+    size_t GetBytes() const {
+        return bytes_;
+    }
+    size_t GetAllocationCount() const {
+        return allocation_count_;
+    }
+    // Estimated header and rounding of the live blocks
+    size_t GetOverhead() const {
+        return overhead_;
+    }
+
+    // Bytes a malloc like the one of glibc spends on a block of the size besides the block:
+    // a size_t header and rounding up to 2 * size_t with a minimum chunk of 4 * size_t
+    static size_t EstimateOverhead(size_t bytes) {
+        constexpr size_t alignment = 2 * sizeof(size_t);
+        const size_t chunk = std::max(4 * sizeof(size_t), (bytes + sizeof(size_t) + alignment - 1) / alignment * alignment);
+        return chunk - bytes;
+    }
+
+private:
+    size_t bytes_ = 0;
+    size_t overhead_ = 0;
+    size_t allocation_count_ = 0;
+};
+
+// std::allocator which counts its allocations. A default constructed allocator has a counter
+// of its own, so every container has one; the copy of a container gets a new counter.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    CountingAllocator()
+        : counter_(std::make_shared<AllocationCounter>()) {
+    }
+    // Moving has to keep the counter of the source too, so there is no move constructor
+    CountingAllocator(const CountingAllocator&) noexcept = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter()) {
+    }
+
+    T* allocate(size_t count) {
+        T* pointer = std::allocator<T>().allocate(count);
+        counter_->Allocate(count * sizeof(T));
+        return pointer;
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        counter_->Deallocate(count * sizeof(T));
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    CountingAllocator select_on_container_copy_construction() const {
+        return CountingAllocator();
+    }
+
+    const std::shared_ptr<AllocationCounter>& GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    std::shared_ptr<AllocationCounter> counter_;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+// Node of std::map without the value: color and parent, left and right links
+inline constexpr size_t TREE_NODE_HEADER_SIZE = 4 * sizeof(void*);
+
+// Characters of the string outside of the object, 0 for a short one stored inline
+inline size_t GetHeapSize(const std::string& value) {
+    const char* object = reinterpret_cast<const char*>(&value);
+    const bool is_inline = value.data() >= object && value.data() < object + sizeof(value);
+    return is_inline ? 0 : value.capacity() + 1;
+}
+
+struct MemoryUsage {
+    // Heap bytes of the structure, without the allocator overhead
+    size_t bytes = 0;
+    // Elements of the structure, see MemoryStats
+    size_t count = 0;
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        bytes += other.bytes;
+        count += other.count;
+        return *this;
+    }
+};
+
+// Heap memory of a SearchServer by structure. Containers with CountingAllocator are
+// measured exactly, the nested per document and per word vectors and maps by their
+// capacities and estimated node sizes.
+struct MemoryStats {
+    // Characters of the indexed words stored outside of the string objects, count is the words
+    MemoryUsage term_strings;
+    // Nodes and buckets of the word set and of the word -> postings map, count is the words
+    MemoryUsage dictionary;
+    // Document numbers, term frequencies and positions of the posting lists, count is the postings
+    MemoryUsage postings;
+    // Bitmaps of the long posting lists, kept besides their document numbers, count is the postings in them
+    MemoryUsage posting_bitmaps;
+    // Document data with the word frequencies of every document, count is the (document, word) pairs
+    MemoryUsage forward_index;
+    // Document id set and the internal number -> document table, count is the documents
+    MemoryUsage metadata;
+    // Stop words with their characters, count is the words
+    MemoryUsage stop_words;
+    // Deletion variants of the fuzzy search, count is the (variant, word) pairs
+    MemoryUsage typo_index;
+    // Compressed texts of the document store, count is the documents
+    MemoryUsage documents;
+    // Estimated malloc headers and rounding of all the blocks
+    size_t allocator_overhead = 0;
+    // Heap blocks of all the structures
+    size_t allocation_count = 0;
+
+    size_t GetTotalBytes() const;
+    MemoryStats& operator+=(const MemoryStats& other);
+};
+
+// JSON object with a field for every structure
+std::ostream& operator<<(std::ostream& out, const MemoryStats& stats);
@@ -0,0 +1,84 @@
+#include "partitioned_posting_list.h"
+
+using namespace std;
+
+void PartitionedPostingList::Add(DocumentStatus status, uint32_t document, double term_freq) {
+    PostingList& partition = partitions_[static_cast<size_t>(status)];
+    const size_t previous_size = partition.size();
+    partition.Add(document, term_freq);
+    if (partition.size() > previous_size) {
+        ++size_;
+        impacts_[static_cast<size_t>(status)].Add(partition, document, static_cast<float>(term_freq));
+    }
+    else {
+        impacts_[static_cast<size_t>(status)].Update(partition, document);
+    }
+}
+
+void PartitionedPostingList::SetPositions(DocumentStatus status, uint32_t document, const vector<uint32_t>& positions) {
+    partitions_[static_cast<size_t>(status)].SetPositions(document, positions);
+}
+
+bool PartitionedPostingList::Remove(DocumentStatus status, uint32_t document) {
+    PostingList& partition = partitions_[static_cast<size_t>(status)];
+    if (partition.Remove(document)) {
+        --size_;
+        impacts_[static_cast<size_t>(status)].Remove(partition, document);
+        return true;
+    }
+    return false;
+}
+
+bool PartitionedPostingList::SetTermFreq(DocumentStatus status, uint32_t document, double term_freq) {
+    PostingList& partition = partitions_[static_cast<size_t>(status)];
+    if (partition.SetTermFreq(document, term_freq)) {
+        impacts_[static_cast<size_t>(status)].Update(partition, document);
+        return true;
+    }
+    return false;
+}
+
+void PartitionedPostingList::MoveDocuments(const vector<StatusMove>& moves) {
+    // Documents of the moves in their order, so they are ascending if the moves are
+    const auto documents_of = [&moves](auto is_selected) {
+        vector<uint32_t> documents;
+        for (const StatusMove& move : moves) {
+            if (is_selected(move)) {
+                documents.push_back(move.document);
+            }
+        }
+        return documents;
+    };
+
+    array<PostingList, DOCUMENT_STATUS_COUNT> incoming;
+    for (size_t from = 0; from < DOCUMENT_STATUS_COUNT; ++from) {
+        const vector<uint32_t> leaving = documents_of([from](const StatusMove& move) { return static_cast<size_t>(move.from) == from; });
+        if (leaving.empty()) {
+            continue;
+        }
+        PostingList extracted = partitions_[from].Extract(leaving);
+        impacts_[from].Remove(partitions_[from], leaving);
+        for (size_t to = 0; to < DOCUMENT_STATUS_COUNT; ++to) {
+            const vector<uint32_t> arriving = documents_of([from, to](const StatusMove& move) {
+                return static_cast<size_t>(move.from) == from && static_cast<size_t>(move.to) == to;
+            });
+            if (!arriving.empty()) {
+                // The moved postings are few, so merging them before the partition is cheap
+                incoming[to].Merge(extracted.Extract(arriving));
+            }
+        }
+    }
+    for (size_t to = 0; to < DOCUMENT_STATUS_COUNT; ++to) {
+        if (!incoming[to].empty()) {
+            partitions_[to].Merge(incoming[to]);
+            impacts_[to].Add(partitions_[to], incoming[to]);
+        }
+    }
+}
+
+void PartitionedPostingList::RenumberDocuments(const vector<uint32_t>& new_documents) {
+    for (size_t i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        partitions_[i].RenumberDocuments(new_documents);
+        impacts_[i].RenumberDocuments(new_documents);
+    }
+}
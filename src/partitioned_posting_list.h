@@ -0,0 +1,73 @@
+#pragma once
+
+#include "document.h"
+#include "impact_list.h"
+#include "posting_list.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Posting list of a word split by the status of the documents. A search restricted
+// to some statuses reads only their partitions, so the default search for ACTUAL
+// documents doesn't visit the others. A document is in exactly one partition. This is
+// the only place statuses are applied, there are no per-status document bitmaps.
+class PartitionedPostingList {
+public:
+    struct StatusMove {
+        uint32_t document;
+        DocumentStatus from;
+        DocumentStatus to;
+    };
+
+    void Add(DocumentStatus status, uint32_t document, double term_freq);
+    void SetPositions(DocumentStatus status, uint32_t document, const std::vector<uint32_t>& positions);
+    bool Remove(DocumentStatus status, uint32_t document);
+    bool SetTermFreq(DocumentStatus status, uint32_t document, double term_freq);
+    void ReplacePositions(DocumentStatus status, uint32_t document, const std::vector<uint32_t>& positions) {
+        partitions_[static_cast<size_t>(status)].ReplacePositions(document, positions);
+    }
+    // Moves the documents with their term frequencies and positions to the partitions of other
+    // statuses. Every partition is shifted at most twice however many of its documents move.
+    void MoveDocuments(const std::vector<StatusMove>& moves);
+    // See PostingList::RenumberDocuments
+    void RenumberDocuments(const std::vector<uint32_t>& new_documents);
+
+    bool Contains(DocumentStatus status, uint32_t document) const {
+        return GetPartition(status).Contains(document);
+    }
+
+    const PostingList& GetPartition(DocumentStatus status) const {
+        return partitions_[static_cast<size_t>(status)];
+    }
+
+    // Best postings of the partition by term frequency
+    const ImpactList& GetImpacts(DocumentStatus status) const {
+        return impacts_[static_cast<size_t>(status)];
+    }
+
+    // Documents of all statuses, the document frequency of the word
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    template <typename Func>
+    void ForEachBuffer(Func func) const {
+        for (const PostingList& partition : partitions_) {
+            partition.ForEachBuffer(func);
+        }
+        for (const ImpactList& impacts : impacts_) {
+            impacts.ForEachBuffer(func);
+        }
+    }
+
+private:
+    std::array<PostingList, DOCUMENT_STATUS_COUNT> partitions_;
+    std::array<ImpactList, DOCUMENT_STATUS_COUNT> impacts_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,407 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POSTING_LIST_HAS_SSE2
+#endif
+
+using namespace std;
+
+namespace {
+
+// Galloping pays off once one list is this many times longer than the other
+constexpr size_t GALLOPING_SIZE_RATIO = 32;
+
+vector<uint8_t> EncodePositions(const vector<uint32_t>& positions) {
+    vector<uint8_t> encoded;
+    uint32_t previous = 0;
+    for (uint32_t position : positions) {
+        uint32_t delta = position - previous;
+        previous = position;
+        while (delta >= 0x80) {
+            encoded.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        encoded.push_back(static_cast<uint8_t>(delta));
+    }
+    return encoded;
+}
+
+} // namespace
+
+PostingList::PostingList(const PostingList& other)
+    : documents_(other.documents_),
+      term_freqs_(other.term_freqs_),
+      position_offsets_(other.position_offsets_),
+      positions_(other.positions_),
+      bitmap_(other.bitmap_ ? make_unique<RoaringBitmap>(*other.bitmap_) : nullptr) {
+}
+
+PostingList& PostingList::operator=(const PostingList& other) {
+    if (this != &other) {
+        PostingList copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void PostingList::Add(uint32_t document, double term_freq) {
+    if (documents_.empty() || documents_.back() < document) {
+        documents_.push_back(document);
+        term_freqs_.push_back(static_cast<float>(term_freq));
+        AddToBitmap(document);
+        return;
+    }
+
+    const auto it = lower_bound(documents_.begin(), documents_.end(), document);
+    const size_t index = static_cast<size_t>(it - documents_.begin());
+    if (*it == document) {
+        term_freqs_[index] = static_cast<float>(term_freqs_[index] + term_freq);
+        return;
+    }
+    documents_.insert(it, document);
+    term_freqs_.insert(term_freqs_.begin() + index, static_cast<float>(term_freq));
+    AddToBitmap(document);
+}
+
+PostingList PostingList::Extract(const vector<uint32_t>& documents) {
+    PostingList extracted;
+    if (documents.empty()) {
+        return extracted;
+    }
+    const bool has_positions = HasPositions();
+    const size_t position_count = positions_.size();
+    // The postings between the extracted ones are shifted down as runs
+    const auto shift = [this, has_positions, position_count](size_t begin, size_t end, size_t to, uint32_t& position_to) {
+        if (begin == to) {
+            position_to = (end < position_offsets_.size()) ? position_offsets_[end] : static_cast<uint32_t>(position_count);
+            return;
+        }
+        copy(documents_.begin() + begin, documents_.begin() + end, documents_.begin() + to);
+        copy(term_freqs_.begin() + begin, term_freqs_.begin() + end, term_freqs_.begin() + to);
+        if (has_positions && begin < end) {
+            const uint32_t position_begin = position_offsets_[begin];
+            const uint32_t position_end = (end < position_offsets_.size()) ? position_offsets_[end] : static_cast<uint32_t>(position_count);
+            copy(positions_.begin() + position_begin, positions_.begin() + position_end, positions_.begin() + position_to);
+            for (size_t i = begin; i < end; ++i) {
+                position_offsets_[to + i - begin] = position_offsets_[i] - position_begin + position_to;
+            }
+            position_to += position_end - position_begin;
+        }
+    };
+
+    const size_t first = GallopingLowerBound(documents_.data(), 0, documents_.size(), documents.front());
+    size_t read = first;
+    size_t write = first;
+    uint32_t position_write = (has_positions && first < position_offsets_.size()) ? position_offsets_[first] : static_cast<uint32_t>(position_count);
+    for (uint32_t document : documents) {
+        const size_t index = GallopingLowerBound(documents_.data(), read, documents_.size(), document);
+        if (index == documents_.size() || documents_[index] != document) {
+            continue;
+        }
+        shift(read, index, write, position_write);
+        write += index - read;
+        extracted.AppendFrom(*this, index);
+        read = index + 1;
+    }
+    shift(read, documents_.size(), write, position_write);
+    write += documents_.size() - read;
+
+    documents_.resize(write);
+    term_freqs_.resize(write);
+    if (has_positions) {
+        position_offsets_.resize(write);
+        positions_.resize(position_write);
+    }
+    if (bitmap_) {
+        for (uint32_t document : extracted.documents_) {
+            bitmap_->Remove(document);
+        }
+        if (documents_.size() < SPARSE_MAX_SIZE) {
+            bitmap_.reset();
+        }
+    }
+    return extracted;
+}
+
+void PostingList::Merge(const PostingList& other) {
+    if (other.empty()) {
+        return;
+    }
+    const bool has_positions = other.HasPositions();
+    size_t index = documents_.size();
+    size_t other_index = other.size();
+    // The end of the positions of the last unmerged posting of this list
+    uint32_t position_end = static_cast<uint32_t>(positions_.size());
+    documents_.resize(index + other_index);
+    term_freqs_.resize(index + other_index);
+    if (has_positions) {
+        position_offsets_.resize(index + other_index);
+        positions_.resize(positions_.size() + other.positions_.size());
+    }
+    uint32_t position_write = static_cast<uint32_t>(positions_.size());
+
+    // Merged from the back, so the postings before the first new document stay in place
+    for (size_t write = documents_.size(); other_index > 0;) {
+        --write;
+        const bool is_other = index == 0 || documents_[index - 1] < other.documents_[other_index - 1];
+        const PostingList& source = is_other ? other : *this;
+        const size_t read = is_other ? --other_index : --index;
+        documents_[write] = source.documents_[read];
+        term_freqs_[write] = source.term_freqs_[read];
+        if (has_positions) {
+            const uint32_t begin = source.position_offsets_[read];
+            const uint32_t end = is_other
+                ? ((read + 1 < other.position_offsets_.size()) ? other.position_offsets_[read + 1] : static_cast<uint32_t>(other.positions_.size()))
+                : position_end;
+            position_write -= end - begin;
+            copy_backward(source.positions_.begin() + begin, source.positions_.begin() + end, positions_.begin() + position_write + (end - begin));
+            position_offsets_[write] = position_write;
+            if (!is_other) {
+                position_end = begin;
+            }
+        }
+    }
+
+    for (uint32_t document : other.documents_) {
+        AddToBitmap(document);
+    }
+}
+
+void PostingList::AppendFrom(const PostingList& source, size_t index) {
+    documents_.push_back(source.documents_[index]);
+    term_freqs_.push_back(source.term_freqs_[index]);
+    if (source.HasPositions()) {
+        const uint32_t begin = source.position_offsets_[index];
+        const uint32_t end = (index + 1 < source.position_offsets_.size())
+            ? source.position_offsets_[index + 1]
+            : static_cast<uint32_t>(source.positions_.size());
+        position_offsets_.push_back(static_cast<uint32_t>(positions_.size()));
+        positions_.insert(positions_.end(), source.positions_.begin() + begin, source.positions_.begin() + end);
+    }
+}
+
+void PostingList::RenumberDocuments(const vector<uint32_t>& new_documents) {
+    for (uint32_t& document : documents_) {
+        document = new_documents[document];
+    }
+    if (bitmap_) {
+        bitmap_ = make_unique<RoaringBitmap>();
+        for (uint32_t document : documents_) {
+            bitmap_->Add(document);
+        }
+    }
+}
+
+void PostingList::AddToBitmap(uint32_t document) {
+    if (bitmap_) {
+        bitmap_->Add(document);
+    }
+    else if (documents_.size() >= DENSE_MIN_SIZE) {
+        bitmap_ = make_unique<RoaringBitmap>();
+        for (uint32_t present : documents_) {
+            bitmap_->Add(present);
+        }
+    }
+}
+
+bool PostingList::Remove(uint32_t document) {
+    const auto it = lower_bound(documents_.begin(), documents_.end(), document);
+    if (it == documents_.end() || *it != document) {
+        return false;
+    }
+    const size_t index = static_cast<size_t>(it - documents_.begin());
+    if (HasPositions()) {
+        const uint32_t begin = position_offsets_[index];
+        const uint32_t end = (index + 1 < position_offsets_.size()) ? position_offsets_[index + 1] : static_cast<uint32_t>(positions_.size());
+        positions_.erase(positions_.begin() + begin, positions_.begin() + end);
+        position_offsets_.erase(position_offsets_.begin() + index);
+        for (size_t i = index; i < position_offsets_.size(); ++i) {
+            position_offsets_[i] -= end - begin;
+        }
+    }
+    term_freqs_.erase(term_freqs_.begin() + index);
+    documents_.erase(it);
+    if (bitmap_) {
+        bitmap_->Remove(document);
+        if (documents_.size() < SPARSE_MAX_SIZE) {
+            bitmap_.reset();
+        }
+    }
+    return true;
+}
+
+bool PostingList::SetTermFreq(uint32_t document, double term_freq) {
+    const auto it = lower_bound(documents_.begin(), documents_.end(), document);
+    if (it == documents_.end() || *it != document) {
+        return false;
+    }
+    term_freqs_[it - documents_.begin()] = static_cast<float>(term_freq);
+    return true;
+}
+
+void PostingList::SetPositions(uint32_t document, const vector<uint32_t>& positions) {
+    const size_t index = static_cast<size_t>(lower_bound(documents_.begin(), documents_.end(), document) - documents_.begin());
+    const vector<uint8_t> encoded = EncodePositions(positions);
+
+    // Documents are normally added in ascending order, so this is an append
+    const uint32_t offset = (index < position_offsets_.size()) ? position_offsets_[index] : static_cast<uint32_t>(positions_.size());
+    positions_.insert(positions_.begin() + offset, encoded.begin(), encoded.end());
+    position_offsets_.insert(position_offsets_.begin() + index, offset);
+    for (size_t i = index + 1; i < position_offsets_.size(); ++i) {
+        position_offsets_[i] += static_cast<uint32_t>(encoded.size());
+    }
+}
+
+void PostingList::ReplacePositions(uint32_t document, const vector<uint32_t>& positions) {
+    const auto it = lower_bound(documents_.begin(), documents_.end(), document);
+    if (it == documents_.end() || *it != document || !HasPositions()) {
+        return;
+    }
+    const size_t index = static_cast<size_t>(it - documents_.begin());
+    const vector<uint8_t> encoded = EncodePositions(positions);
+    const auto begin = positions_.begin() + position_offsets_[index];
+    const auto end = (index + 1 < position_offsets_.size()) ? positions_.begin() + position_offsets_[index + 1] : positions_.end();
+    if (equal(begin, end, encoded.begin(), encoded.end())) {
+        return;
+    }
+
+    const int64_t shift = static_cast<int64_t>(encoded.size()) - (end - begin);
+    const auto position = positions_.erase(begin, end);
+    positions_.insert(position, encoded.begin(), encoded.end());
+    for (size_t i = index + 1; i < position_offsets_.size(); ++i) {
+        position_offsets_[i] = static_cast<uint32_t>(position_offsets_[i] + shift);
+    }
+}
+
+vector<uint32_t> PostingList::GetPositions(size_t index) const {
+    vector<uint32_t> positions;
+    if (!HasPositions()) {
+        return positions;
+    }
+    const size_t end = (index + 1 < position_offsets_.size()) ? position_offsets_[index + 1] : positions_.size();
+    uint32_t position = 0;
+    for (size_t i = position_offsets_[index]; i < end;) {
+        uint32_t delta = 0;
+        int shift = 0;
+        uint8_t byte = 0;
+        do {
+            byte = positions_[i++];
+            delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        position += delta;
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+bool PostingList::Contains(uint32_t document) const {
+    if (bitmap_) {
+        return bitmap_->Contains(document);
+    }
+    return binary_search(documents_.begin(), documents_.end(), document);
+}
+
+const float* PostingList::FindTermFreq(uint32_t document) const {
+    const auto it = lower_bound(documents_.begin(), documents_.end(), document);
+    if (it == documents_.end() || *it != document) {
+        return nullptr;
+    }
+    return &term_freqs_[it - documents_.begin()];
+}
+
+// ----------------------------------------------------------------------------
+
+size_t GallopingLowerBound(const uint32_t* data, size_t begin, size_t size, uint32_t target) {
+    if (begin >= size || data[begin] >= target) {
+        return begin;
+    }
+
+    // data[low] < target is kept invariant
+    size_t low = begin;
+    size_t step = 1;
+    while (low + step < size && data[low + step] < target) {
+        low += step;
+        step *= 2;
+    }
+    const size_t high = min(low + step, size);
+    return static_cast<size_t>(lower_bound(data + low + 1, data + high, target) - data);
+}
+
+void IntersectGalloping(const vector<uint32_t>& small, const vector<uint32_t>& large, vector<uint32_t>& out) {
+    size_t position = 0;
+    for (uint32_t value : small) {
+        position = GallopingLowerBound(large.data(), position, large.size(), value);
+        if (position == large.size()) {
+            break;
+        }
+        if (large[position] == value) {
+            out.push_back(value);
+        }
+    }
+}
+
+void IntersectMerge(const uint32_t* lhs, size_t lhs_size, const uint32_t* rhs, size_t rhs_size, vector<uint32_t>& out) {
+    size_t i = 0;
+    size_t j = 0;
+
+#ifdef POSTING_LIST_HAS_SSE2
+    // Compares blocks of four against all four rotations of the other block
+    while (i + 4 <= lhs_size && j + 4 <= rhs_size) {
+        const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+        const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + j));
+
+        __m128i equal = _mm_cmpeq_epi32(lhs_block, rhs_block);
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(2, 1, 0, 3))));
+
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) {
+                out.push_back(lhs[i + k]);
+            }
+        }
+
+        const uint32_t lhs_max = lhs[i + 3];
+        const uint32_t rhs_max = rhs[j + 3];
+        if (lhs_max <= rhs_max) {
+            i += 4;
+        }
+        if (rhs_max <= lhs_max) {
+            j += 4;
+        }
+    }
+#endif
+
+    while (i < lhs_size && j < rhs_size) {
+        if (lhs[i] < rhs[j]) {
+            ++i;
+        }
+        else if (rhs[j] < lhs[i]) {
+            ++j;
+        }
+        else {
+            out.push_back(lhs[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+void IntersectSorted(const vector<uint32_t>& lhs, const vector<uint32_t>& rhs, vector<uint32_t>& out) {
+    const vector<uint32_t>& small = lhs.size() <= rhs.size() ? lhs : rhs;
+    const vector<uint32_t>& large = lhs.size() <= rhs.size() ? rhs : lhs;
+    if (small.empty()) {
+        return;
+    }
+    if (large.size() / small.size() >= GALLOPING_SIZE_RATIO) {
+        IntersectGalloping(small, large, out);
+    }
+    else {
+        IntersectMerge(small.data(), small.size(), large.data(), large.size(), out);
+    }
+}
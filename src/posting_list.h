@@ -0,0 +1,166 @@
+#pragma once
+
+#include "roaring_bitmap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Documents containing a word: internal document numbers in ascending order
+// and the term frequency of the word in each of them. Frequencies are kept as
+// float to halve the postings and let the scoring kernels load more of them at once.
+// Lists of frequent words also keep their documents in a bitmap, so membership tests
+// and exclusions don't have to search the long id array. The bitmap is an index on top
+// of the arrays, not another representation of the list: the scoring kernels, the positions
+// and the galloping cursors read the arrays, so it costs memory (MemoryStats::posting_bitmaps).
+class PostingList {
+public:
+    // The bitmap is built when the list grows to DENSE_MIN_SIZE documents and dropped
+    // when it shrinks below SPARSE_MAX_SIZE, the gap keeps a list around the limit from flipping
+    inline static constexpr size_t DENSE_MIN_SIZE = 4096;
+    inline static constexpr size_t SPARSE_MAX_SIZE = DENSE_MIN_SIZE / 2;
+
+    PostingList() = default;
+    // Copies the bitmap as well, so the lists and the servers holding them stay copyable
+    PostingList(const PostingList& other);
+    PostingList& operator=(const PostingList& other);
+    PostingList(PostingList&&) noexcept = default;
+    PostingList& operator=(PostingList&&) noexcept = default;
+
+    // Accumulates the frequency if the document is already present
+    void Add(uint32_t document, double term_freq);
+    bool Remove(uint32_t document);
+
+    // Replaces the frequency of a document in place, returns false if the document is absent
+    bool SetTermFreq(uint32_t document, double term_freq);
+
+    // Stores word positions of a document already added to the list.
+    // Lists either keep positions for every document or for none of them.
+    void SetPositions(uint32_t document, const std::vector<uint32_t>& positions);
+    // Replaces the stored positions of a document, unchanged positions don't touch the buffer
+    void ReplacePositions(uint32_t document, const std::vector<uint32_t>& positions);
+    bool HasPositions() const {
+        return !position_offsets_.empty();
+    }
+    // Positions of the document at the given index of GetDocuments() in ascending order
+    std::vector<uint32_t> GetPositions(size_t index) const;
+
+    // Removes the documents, given in ascending order, with their frequencies and positions
+    // and returns them as a list. The postings after the first of them are shifted once however many go.
+    PostingList Extract(const std::vector<uint32_t>& documents);
+    // Adds the postings of a list without common documents, the postings after
+    // its first document are shifted once
+    void Merge(const PostingList& other);
+
+    // Replaces every document d by new_documents[d]. The mapping has to be increasing on the
+    // documents of the list, so they stay sorted.
+    void RenumberDocuments(const std::vector<uint32_t>& new_documents);
+
+    bool Contains(uint32_t document) const;
+    // Returns nullptr if the document is absent
+    const float* FindTermFreq(uint32_t document) const;
+
+    size_t size() const {
+        return documents_.size();
+    }
+
+    bool empty() const {
+        return documents_.empty();
+    }
+
+    const std::vector<uint32_t>& GetDocuments() const {
+        return documents_;
+    }
+
+    const std::vector<float>& GetTermFreqs() const {
+        return term_freqs_;
+    }
+
+    // Returns nullptr for a list below DENSE_MIN_SIZE
+    const RoaringBitmap* GetBitmap() const {
+        return bitmap_.get();
+    }
+
+    // Calls func(bytes) with the capacity of every allocated buffer of the list except the bitmap
+    template <typename Func>
+    void ForEachBuffer(Func func) const {
+        for (size_t bytes : { documents_.capacity() * sizeof(uint32_t), term_freqs_.capacity() * sizeof(float),
+                              position_offsets_.capacity() * sizeof(uint32_t), positions_.capacity() }) {
+            if (bytes > 0) {
+                func(bytes);
+            }
+        }
+    }
+
+    template <typename Func>
+    void ForEachBitmapBuffer(Func func) const {
+        if (bitmap_) {
+            func(sizeof(RoaringBitmap));
+            bitmap_->ForEachBuffer(func);
+        }
+    }
+
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (size_t i = 0; i < documents_.size(); ++i) {
+            func(documents_[i], term_freqs_[i]);
+        }
+    }
+
+private:
+    void AddToBitmap(uint32_t document);
+    // Appends the posting at the index of another list
+    void AppendFrom(const PostingList& source, size_t index);
+
+    std::vector<uint32_t> documents_;
+    std::vector<float> term_freqs_;
+    // Positions are delta encoded varints, the positions of documents_[i]
+    // start at position_offsets_[i] and end at the next offset or the end of the buffer
+    std::vector<uint32_t> position_offsets_;
+    std::vector<uint8_t> positions_;
+    // Same documents as documents_, behind a pointer so the lists of rare words stay small
+    std::unique_ptr<RoaringBitmap> bitmap_;
+};
+
+// Union of the lists, the term frequency of a document is the sum of
+// score(list index, document, term frequency) over the lists containing it
+template <typename ScoreFunc>
+PostingList MergePostingLists(const std::vector<const PostingList*>& lists, ScoreFunc score) {
+    // Min-heap of (next document, list index), so every document is appended in order
+    using Cursor = std::pair<uint32_t, size_t>;
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    std::vector<size_t> positions(lists.size(), 0);
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (!lists[i]->empty()) {
+            heap.push({ lists[i]->GetDocuments().front(), i });
+        }
+    }
+
+    PostingList merged;
+    while (!heap.empty()) {
+        const auto [document, i] = heap.top();
+        heap.pop();
+        const PostingList& list = *lists[i];
+        merged.Add(document, score(i, document, list.GetTermFreqs()[positions[i]]));
+        if (++positions[i] < list.size()) {
+            heap.push({ list.GetDocuments()[positions[i]], i });
+        }
+    }
+    return merged;
+}
+
+// First position in [begin, size) whose value is not less than target.
+// Probes begin + 1, begin + 3, begin + 7, ... before the binary search, so
+// advancing a cursor by a short distance costs O(log distance).
+size_t GallopingLowerBound(const uint32_t* data, size_t begin, size_t size, uint32_t target);
+
+// Appends the common elements of two ascending sequences to out. Uses galloping
+// search when the sizes differ a lot and a SIMD block merge otherwise.
+void IntersectSorted(const std::vector<uint32_t>& lhs, const std::vector<uint32_t>& rhs, std::vector<uint32_t>& out);
+
+void IntersectGalloping(const std::vector<uint32_t>& small, const std::vector<uint32_t>& large, std::vector<uint32_t>& out);
+void IntersectMerge(const uint32_t* lhs, size_t lhs_size, const uint32_t* rhs, size_t rhs_size, std::vector<uint32_t>& out);
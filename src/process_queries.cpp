@@ -1,8 +1,95 @@
 #include "process_queries.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <execution>
 #include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// Results of the searches in the order they finish, bounded so the searches wait for the visitor
+class ResultQueue {
+public:
+    explicit ResultQueue(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)) {
+    }
+
+    // Returns false if the consumer has stopped or a search has failed
+    bool Push(size_t index, std::vector<Document> documents) {
+        std::unique_lock lock(mutex_);
+        has_room_.wait(lock, [this]() { return results_.size() < capacity_ || is_stopped_; });
+        if (is_stopped_) {
+            return false;
+        }
+        results_.push_back({ index, std::move(documents) });
+        has_results_.notify_one();
+        return true;
+    }
+
+    // Returns false after the last result, rethrows the error of a search
+    bool Pop(size_t& index, std::vector<Document>& documents) {
+        std::unique_lock lock(mutex_);
+        has_results_.wait(lock, [this]() { return !results_.empty() || is_finished_ || error_; });
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        if (results_.empty()) {
+            return false;
+        }
+        index = results_.front().first;
+        documents = std::move(results_.front().second);
+        results_.pop_front();
+        has_room_.notify_one();
+        return true;
+    }
+
+    bool IsStopped() {
+        std::lock_guard guard(mutex_);
+        return is_stopped_;
+    }
+
+    // The first error is reported, the searches still running are dropped
+    void Fail(std::exception_ptr error) {
+        std::lock_guard guard(mutex_);
+        if (!error_) {
+            error_ = error;
+        }
+        is_stopped_ = true;
+        has_room_.notify_all();
+        has_results_.notify_one();
+    }
+
+    void Finish() {
+        std::lock_guard guard(mutex_);
+        is_finished_ = true;
+        has_results_.notify_one();
+    }
+
+    void Stop() {
+        std::lock_guard guard(mutex_);
+        is_stopped_ = true;
+        results_.clear();
+        has_room_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable has_room_;
+    std::condition_variable has_results_;
+    std::deque<std::pair<size_t, std::vector<Document>>> results_;
+    bool is_finished_ = false;
+    bool is_stopped_ = false;
+    std::exception_ptr error_;
+};
+
+} // namespace
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
@@ -25,8 +112,75 @@ std::vector<Document> ProcessQueriesJoined(
     const std::vector<std::string>& queries)
 {
     std::vector<Document> res;
-    for (std::vector<Document>& documents : ProcessQueries(search_server, queries)) {
-        std::move(documents.begin(), documents.end(), std::back_inserter(res));
-    }
+    ProcessQueriesJoined(search_server, queries, res);
     return res;
 }
+
+void ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    std::vector<Document>& documents)
+{
+    constexpr size_t slot_count = SearchServer::MAX_RESULT_DOCUMENT_COUNT;
+    documents.resize(queries.size() * slot_count);
+    std::vector<size_t> counts(queries.size());
+
+    std::for_each(
+        std::execution::par,
+        queries.begin(), queries.end(),
+        [&search_server, &queries, &documents, &counts](const std::string& query) {
+            const size_t index = static_cast<size_t>(&query - queries.data());
+            const std::vector<Document> found = search_server.FindTopDocuments(query);
+            std::copy(found.begin(), found.end(), documents.begin() + index * slot_count);
+            counts[index] = found.size();
+        });
+
+    // Slots move only towards the front, so packing in query order doesn't overwrite unread ones
+    size_t size = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        for (size_t j = 0; j < counts[i]; ++j) {
+            documents[size++] = documents[i * slot_count + j];
+        }
+    }
+    documents.resize(size);
+}
+
+void ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const QueryResultVisitor& visitor,
+    size_t max_pending_results)
+{
+    ResultQueue queue(max_pending_results);
+    std::thread producer([&search_server, &queries, &queue]() {
+        std::for_each(
+            std::execution::par,
+            queries.begin(), queries.end(),
+            [&search_server, &queries, &queue](const std::string& query) {
+                if (queue.IsStopped()) {
+                    return;
+                }
+                try {
+                    queue.Push(static_cast<size_t>(&query - queries.data()), search_server.FindTopDocuments(query));
+                }
+                catch (...) {
+                    queue.Fail(std::current_exception());
+                }
+            });
+        queue.Finish();
+    });
+
+    try {
+        size_t index = 0;
+        std::vector<Document> documents;
+        while (queue.Pop(index, documents)) {
+            visitor(index, documents);
+        }
+    }
+    catch (...) {
+        queue.Stop();
+        producer.join();
+        throw;
+    }
+    producer.join();
+}
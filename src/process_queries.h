@@ -3,6 +3,8 @@
 #include "document.h"
 #include "search_server.h"
 
+#include <cstddef>
+#include <functional>
 #include <vector>
 
 std::vector<std::vector<Document>> ProcessQueries(
@@ -11,4 +13,28 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// Same as above, but the documents are written into the caller's vector. Every query
+// writes its results straight into its own slots of the vector, which are then packed,
+// so a vector reused between batches doesn't allocate again.
+void ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    std::vector<Document>& documents);
+
+// Receives the index of a query and its documents, which may be moved out
+using QueryResultVisitor = std::function<void(size_t query_index, std::vector<Document>& documents)>;
+
+inline constexpr size_t DEFAULT_MAX_PENDING_RESULTS = 64;
+
+// Calls the visitor on the calling thread for every query as soon as its search is done,
+// in the order the searches finish, while the other queries are searched in parallel.
+// At most max_pending_results results wait for the visitor, then the searches pause until
+// it catches up. An exception of a search or of the visitor stops the remaining searches
+// and is rethrown.
+void ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const QueryResultVisitor& visitor,
+    size_t max_pending_results = DEFAULT_MAX_PENDING_RESULTS);
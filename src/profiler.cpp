@@ -0,0 +1,231 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+struct ProfileNode {
+    uint32_t site;
+    uint32_t parent;
+};
+
+struct ProfileRegistry {
+    mutex mute;
+    vector<string> sites;
+    vector<ProfileNode> nodes = { { 0, Profiler::ROOT_NODE } };
+    map<pair<uint32_t, uint32_t>, uint32_t> node_ids;
+    vector<unique_ptr<Profiler::ThreadData>> threads;
+    const chrono::steady_clock::time_point epoch_time = chrono::steady_clock::now();
+    const uint64_t epoch_ticks = Profiler::Now();
+};
+
+ProfileRegistry& GetRegistry() {
+    static ProfileRegistry registry;
+    return registry;
+}
+
+double NanosecondsPerTick(const ProfileRegistry& registry) {
+#ifdef PROFILER_HAS_TSC
+    // Calibrate the time stamp counter against steady_clock over the profiler lifetime
+    chrono::steady_clock::time_point now_time = chrono::steady_clock::now();
+    while (now_time - registry.epoch_time < 1ms) {
+        now_time = chrono::steady_clock::now();
+    }
+    const uint64_t now_ticks = Profiler::Now();
+    const double ns = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(now_time - registry.epoch_time).count());
+    return ns / static_cast<double>(max<uint64_t>(now_ticks - registry.epoch_ticks, 1));
+#else
+    (void)registry;
+    return 1.0;
+#endif
+}
+
+uint64_t Percentile(const array<uint64_t, Profiler::BUCKET_COUNT>& buckets, uint64_t count, double quantile, double ns_per_tick) {
+    const uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < Profiler::BUCKET_COUNT; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // Upper bound of the log2 bucket
+            return static_cast<uint64_t>(static_cast<double>(i + 1 < 64 ? (uint64_t(1) << (i + 1)) : ~uint64_t(0)) * ns_per_tick);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+uint32_t Profiler::RegisterSite(const char* name) {
+    ProfileRegistry& registry = GetRegistry();
+    lock_guard guard(registry.mute);
+    registry.sites.emplace_back(name);
+    return static_cast<uint32_t>(registry.sites.size() - 1);
+}
+
+uint32_t Profiler::ResolveNode(uint32_t site, uint32_t parent, SiteCache& cache) {
+    // Nodes are never removed, so the cached nodes stay valid
+    thread_local unordered_map<uint64_t, uint32_t> resolved_nodes;
+    const uint64_t key = (static_cast<uint64_t>(site) << 32) | parent;
+    const auto resolved = resolved_nodes.find(key);
+    if (resolved != resolved_nodes.end()) {
+        return resolved->second;
+    }
+
+    uint32_t node = ROOT_NODE;
+    {
+        ProfileRegistry& registry = GetRegistry();
+        lock_guard guard(registry.mute);
+        const auto it = registry.node_ids.find({ parent, site });
+        if (it != registry.node_ids.end()) {
+            node = it->second;
+        }
+        else if (registry.nodes.size() < MAX_NODES) {
+            node = static_cast<uint32_t>(registry.nodes.size());
+            registry.nodes.push_back({ site, parent });
+            registry.node_ids.emplace(make_pair(parent, site), node);
+        }
+        // Node table exhausted: the scope is timed but not recorded
+    }
+    resolved_nodes.emplace(key, node);
+
+    // Takes a free entry of the site, the first parents of a site stay cached for all threads
+    const uint64_t entry = (static_cast<uint64_t>(parent) << 32) | node;
+    for (atomic<uint64_t>& cached : cache) {
+        uint64_t expected = ~uint64_t(0);
+        if (cached.compare_exchange_strong(expected, entry, memory_order_relaxed) || (expected >> 32) == parent) {
+            break;
+        }
+    }
+    return node;
+}
+
+Profiler::ThreadData* Profiler::RegisterThread() {
+    ProfileRegistry& registry = GetRegistry();
+    lock_guard guard(registry.mute);
+    registry.threads.push_back(make_unique<ThreadData>());
+    thread_data_ = registry.threads.back().get();
+    return thread_data_;
+}
+
+vector<ProfileNodeStats> Profiler::Snapshot() {
+    ProfileRegistry& registry = GetRegistry();
+    lock_guard guard(registry.mute);
+
+    const double ns_per_tick = NanosecondsPerTick(registry);
+    const auto to_ns = [ns_per_tick](uint64_t ticks) {
+        return static_cast<uint64_t>(static_cast<double>(ticks) * ns_per_tick);
+    };
+
+    vector<ProfileNodeStats> stats(registry.nodes.size());
+    for (uint32_t node = 1; node < registry.nodes.size(); ++node) {
+        const ProfileNode& info = registry.nodes[node];
+        ProfileNodeStats& result = stats[node];
+        result.name = registry.sites[info.site];
+        // Parents are always created before their children
+        result.path = (info.parent == ROOT_NODE) ? result.name : stats[info.parent].path + "/"s + result.name;
+        result.depth = (info.parent == ROOT_NODE) ? 0 : stats[info.parent].depth + 1;
+
+        uint64_t total = 0;
+        uint64_t max_ticks = 0;
+        array<uint64_t, BUCKET_COUNT> buckets{};
+        for (const auto& thread : registry.threads) {
+            const Histogram& histogram = thread->histograms[node];
+            result.count += histogram.count.load(memory_order_relaxed);
+            total += histogram.total.load(memory_order_relaxed);
+            max_ticks = max(max_ticks, histogram.max.load(memory_order_relaxed));
+            for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+                buckets[i] += histogram.buckets[i].load(memory_order_relaxed);
+            }
+        }
+
+        result.total_ns = to_ns(total);
+        result.max_ns = to_ns(max_ticks);
+        if (result.count > 0) {
+            result.p50_ns = Percentile(buckets, result.count, 0.50, ns_per_tick);
+            result.p90_ns = Percentile(buckets, result.count, 0.90, ns_per_tick);
+            result.p99_ns = Percentile(buckets, result.count, 0.99, ns_per_tick);
+        }
+        for (uint32_t i = 0; i < BUCKET_COUNT; ++i) {
+            if (buckets[i] != 0) {
+                result.buckets.emplace_back(to_ns(uint64_t(1) << min(i + 1, 63u)), buckets[i]);
+            }
+        }
+    }
+
+    stats.erase(stats.begin());
+    return stats;
+}
+
+void Profiler::Dump(ostream& out) {
+    const vector<ProfileNodeStats> stats = Snapshot();
+    const auto unix_ms = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+    out << "{\"timestamp_ms\":"s << unix_ms << ",\"unit\":\"ns\",\"scopes\":["s;
+    bool first = true;
+    for (const ProfileNodeStats& node : stats) {
+        if (node.count == 0) {
+            continue;
+        }
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << "{\"path\":\""s << node.path << "\",\"depth\":"s << node.depth
+            << ",\"count\":"s << node.count << ",\"total\":"s << node.total_ns
+            << ",\"mean\":"s << node.total_ns / node.count << ",\"max\":"s << node.max_ns
+            << ",\"p50\":"s << node.p50_ns << ",\"p90\":"s << node.p90_ns << ",\"p99\":"s << node.p99_ns
+            << ",\"histogram\":["s;
+        for (size_t i = 0; i < node.buckets.size(); ++i) {
+            if (i != 0) {
+                out << ',';
+            }
+            out << '[' << node.buckets[i].first << ',' << node.buckets[i].second << ']';
+        }
+        out << "]}"s;
+    }
+    out << "]}"s << endl;
+}
+
+void Profiler::Reset() {
+    ProfileRegistry& registry = GetRegistry();
+    lock_guard guard(registry.mute);
+    for (const auto& thread : registry.threads) {
+        for (Histogram& histogram : thread->histograms) {
+            histogram.count.store(0, memory_order_relaxed);
+            histogram.total.store(0, memory_order_relaxed);
+            histogram.max.store(0, memory_order_relaxed);
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+ProfileDumper::ProfileDumper(ostream& out, chrono::milliseconds period)
+    : out_(out)
+    , period_(period)
+    , worker_([this]() {
+        unique_lock lock(mutex_);
+        while (!stop_cv_.wait_for(lock, period_, [this]() { return stop_; })) {
+            Profiler::Dump(out_);
+        }
+    }) {
+}
+
+ProfileDumper::~ProfileDumper() {
+    {
+        lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    stop_cv_.notify_one();
+    worker_.join();
+    Profiler::Dump(out_);
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_HAS_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_HAS_TSC
+#endif
+
+struct ProfileNodeStats {
+    std::string path;
+    std::string name;
+    int depth = 0;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> buckets; // (upper bound in ns, count)
+};
+
+// Scoped timers aggregated into per-thread histograms.
+// Every thread owns its histograms and is the only writer, so recording never takes a lock;
+// readers (Snapshot, Dump) merge all threads with relaxed loads.
+class Profiler {
+public:
+    inline static constexpr uint32_t MAX_NODES = 256;
+    inline static constexpr uint32_t BUCKET_COUNT = 64;
+    inline static constexpr uint32_t ROOT_NODE = 0;
+    // Parents cached by a site, more parents are cached per thread
+    inline static constexpr uint32_t SITE_CACHE_SIZE = 4;
+
+    // (parent << 32 | node) entries, empty entries are all ones
+    using SiteCache = std::array<std::atomic<uint64_t>, SITE_CACHE_SIZE>;
+
+    struct Histogram {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+
+        void Record(uint64_t ticks) {
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+            if (ticks > max.load(std::memory_order_relaxed)) {
+                max.store(ticks, std::memory_order_relaxed);
+            }
+            std::atomic<uint64_t>& bucket = buckets[BucketIndex(ticks)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    struct ThreadData {
+        std::array<Histogram, MAX_NODES> histograms;
+    };
+
+    static uint64_t Now() {
+#ifdef PROFILER_HAS_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static uint32_t BucketIndex(uint64_t ticks) {
+#if defined(__GNUC__)
+        return ticks == 0 ? 0 : 64 - __builtin_clzll(ticks) - 1;
+#else
+        uint32_t index = 0;
+        while (ticks >>= 1) {
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    static uint32_t RegisterSite(const char* name);
+    // Called on a miss of the site cache, takes the registry lock only the first time
+    // a thread meets the (site, parent) pair
+    static uint32_t ResolveNode(uint32_t site, uint32_t parent, SiteCache& cache);
+
+    static void Record(uint32_t node, uint64_t ticks) {
+        ThreadData* data = thread_data_;
+        if (data == nullptr) {
+            data = RegisterThread();
+        }
+        data->histograms[node].Record(ticks);
+    }
+
+    static std::vector<ProfileNodeStats> Snapshot();
+    // Writes the snapshot as a single line JSON document
+    static void Dump(std::ostream& out);
+    static void Reset();
+
+    static uint32_t GetCurrentNode() {
+        return current_node_;
+    }
+
+private:
+    friend class ProfileScope;
+    friend class ProfileParentScope;
+
+    static ThreadData* RegisterThread();
+
+    inline static thread_local ThreadData* thread_data_ = nullptr;
+    inline static thread_local uint32_t current_node_ = ROOT_NODE;
+};
+
+class ProfileSite {
+public:
+    explicit ProfileSite(const char* name)
+        : id_(Profiler::RegisterSite(name)) {
+    }
+
+    uint32_t NodeFor(uint32_t parent) {
+        // A site reached from several parents, e.g. ParseQuery from FindTopDocuments and
+        // MatchDocument, keeps a node for each of them
+        for (const std::atomic<uint64_t>& entry : cache_) {
+            const uint64_t cached = entry.load(std::memory_order_relaxed);
+            if ((cached >> 32) == parent) {
+                return static_cast<uint32_t>(cached);
+            }
+        }
+        return Profiler::ResolveNode(id_, parent, cache_);
+    }
+
+private:
+    uint32_t id_;
+    Profiler::SiteCache cache_{ ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0) };
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileSite& site)
+        : parent_(Profiler::current_node_)
+        , node_(site.NodeFor(parent_)) {
+        Profiler::current_node_ = node_;
+        start_ = Profiler::Now();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope() {
+        const uint64_t elapsed = Profiler::Now() - start_;
+        if (node_ != Profiler::ROOT_NODE) {
+            Profiler::Record(node_, elapsed);
+        }
+        Profiler::current_node_ = parent_;
+    }
+
+private:
+    uint32_t parent_;
+    uint32_t node_;
+    uint64_t start_ = 0;
+};
+
+// Makes the scopes of a task run on another thread children of the scope which created it
+class ProfileParentScope {
+public:
+    explicit ProfileParentScope(uint32_t parent)
+        : previous_(Profiler::current_node_) {
+        Profiler::current_node_ = parent;
+    }
+
+    ProfileParentScope(const ProfileParentScope&) = delete;
+    ProfileParentScope& operator=(const ProfileParentScope&) = delete;
+
+    ~ProfileParentScope() {
+        Profiler::current_node_ = previous_;
+    }
+
+private:
+    uint32_t previous_;
+};
+
+// Wraps a task handed to another thread, so its scopes nest under the current scope
+template <typename Func>
+auto InheritProfileScope(Func func) {
+#ifdef SEARCH_SERVER_PROFILE
+    return [func = std::move(func), parent = Profiler::GetCurrentNode()](auto&&... args) mutable -> decltype(auto) {
+        const ProfileParentScope scope(parent);
+        return func(std::forward<decltype(args)>(args)...);
+    };
+#else
+    return func;
+#endif
+}
+
+// Periodically appends Profiler::Dump output (JSON Lines) to the stream
+class ProfileDumper {
+public:
+    ProfileDumper(std::ostream& out, std::chrono::milliseconds period);
+    ~ProfileDumper();
+
+private:
+    std::ostream& out_;
+    std::chrono::milliseconds period_;
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
+
+#ifdef SEARCH_SERVER_PROFILE
+#define PROFILE_SCOPE(name) \
+    static ProfileSite PROFILE_CONCAT(profileSite, __LINE__)(name); \
+    ProfileScope UNIQUE_VAR_NAME_PROFILE(PROFILE_CONCAT(profileSite, __LINE__))
+#else
+#define PROFILE_SCOPE(name)
+#endif
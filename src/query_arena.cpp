@@ -0,0 +1,57 @@
+#include "query_arena.h"
+
+#include <algorithm>
+
+using namespace std;
+
+QueryArena::Scope::Scope()
+    : arena_(ForCurrentThread()) {
+    ++arena_.depth_;
+}
+
+QueryArena::Scope::~Scope() {
+    if (--arena_.depth_ == 0) {
+        arena_.Release();
+    }
+}
+
+pmr::memory_resource* QueryArena::Scope::GetResource() const {
+    return &*arena_.resource_;
+}
+
+QueryArena& QueryArena::ForCurrentThread() {
+    thread_local QueryArena arena;
+    return arena;
+}
+
+QueryArena::QueryArena()
+    : capacity_(INITIAL_CAPACITY)
+    , buffer_(make_unique<byte[]>(capacity_)) {
+    resource_.emplace(buffer_.get(), capacity_, &upstream_);
+}
+
+void QueryArena::Release() {
+    // Destroying the resource returns its heap blocks, a new one starts from the kept block again
+    resource_.reset();
+    if (upstream_.GetBytes() > 0 && capacity_ < MAX_CAPACITY) {
+        capacity_ = min(MAX_CAPACITY, capacity_ + upstream_.GetBytes());
+        buffer_ = make_unique<byte[]>(capacity_);
+    }
+    upstream_.ResetBytes();
+    resource_.emplace(buffer_.get(), capacity_, &upstream_);
+}
+
+void* QueryArena::UpstreamResource::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = pmr::new_delete_resource()->allocate(bytes, alignment);
+    ++allocation_count_;
+    bytes_ += bytes;
+    return pointer;
+}
+
+void QueryArena::UpstreamResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+bool QueryArena::UpstreamResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Memory of the temporary structures of the queries run by a thread. A query allocates
+// from the arena without locks and all its memory is released at once by the end of the
+// outermost Scope. The first block is kept between queries and grows to the largest
+// query seen, so a steady workload doesn't call malloc for the temporaries.
+class QueryArena {
+public:
+    // Memory allocated inside a scope lives until the outermost scope of the thread ends,
+    // so a query run from another one doesn't free the memory of the outer query
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        std::pmr::memory_resource* GetResource() const;
+
+    private:
+        QueryArena& arena_;
+    };
+
+    static QueryArena& ForCurrentThread();
+
+    // Size of the block kept between queries
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+    // Blocks taken from the heap beyond the kept one since the arena was created
+    size_t GetHeapAllocationCount() const {
+        return upstream_.GetAllocationCount();
+    }
+
+    static constexpr size_t INITIAL_CAPACITY = 64 * 1024;
+    // Larger queries still work, but the memory above this is returned to the heap after them
+    static constexpr size_t MAX_CAPACITY = 16 * 1024 * 1024;
+
+private:
+    // Heap blocks of the arena when its kept block is exhausted
+    class UpstreamResource : public std::pmr::memory_resource {
+    public:
+        size_t GetAllocationCount() const {
+            return allocation_count_;
+        }
+        size_t GetBytes() const {
+            return bytes_;
+        }
+        void ResetBytes() {
+            bytes_ = 0;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        size_t allocation_count_ = 0;
+        // Since the last release
+        size_t bytes_ = 0;
+    };
+
+    QueryArena();
+
+    void Release();
+
+    UpstreamResource upstream_;
+    size_t capacity_ = 0;
+    std::unique_ptr<std::byte[]> buffer_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    size_t depth_ = 0;
+};
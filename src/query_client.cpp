@@ -0,0 +1,191 @@
+#ifdef __linux__
+
+#include "query_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+int Connect(int domain, const sockaddr* address, socklen_t length) {
+    const int fd = socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "socket"s);
+    }
+    while (connect(fd, address, length) < 0) {
+        if (errno != EINTR) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "connect"s);
+        }
+    }
+    return fd;
+}
+
+} // namespace
+
+QueryClient::QueryClient(const string& unix_socket_path) {
+    sockaddr_un address{};
+    if (unix_socket_path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Socket path is too long: "s + unix_socket_path);
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, unix_socket_path.c_str());
+    fd_ = Connect(AF_UNIX, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+}
+
+QueryClient::QueryClient(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    fd_ = Connect(AF_INET, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    const int no_delay = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+vector<Document> QueryClient::FindTopDocuments(const string& raw_query, DocumentStatus status) {
+    Request request;
+    request.type = RequestType::FIND_TOP_DOCUMENTS;
+    request.status = status;
+    request.text = raw_query;
+    return Call(move(request)).documents;
+}
+
+tuple<vector<string>, DocumentStatus> QueryClient::MatchDocument(const string& raw_query, int document_id) {
+    Request request;
+    request.type = RequestType::MATCH_DOCUMENT;
+    request.document_id = document_id;
+    request.text = raw_query;
+    Response response = Call(move(request));
+    return { move(response.words), response.status };
+}
+
+void QueryClient::AddDocument(int document_id, const string& document, DocumentStatus status, const vector<int>& ratings) {
+    Request request;
+    request.type = RequestType::ADD_DOCUMENT;
+    request.document_id = document_id;
+    request.status = status;
+    request.ratings = ratings;
+    request.text = document;
+    Call(move(request));
+}
+
+void QueryClient::UpsertDocument(int document_id, const string& document, DocumentStatus status, const vector<int>& ratings) {
+    Request request;
+    request.type = RequestType::UPSERT_DOCUMENT;
+    request.document_id = document_id;
+    request.status = status;
+    request.ratings = ratings;
+    request.text = document;
+    Call(move(request));
+}
+
+void QueryClient::RemoveDocument(int document_id) {
+    Request request;
+    request.type = RequestType::REMOVE_DOCUMENT;
+    request.document_id = document_id;
+    Call(move(request));
+}
+
+void QueryClient::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    Request request;
+    request.type = RequestType::UPDATE_DOCUMENT_STATUS;
+    request.document_id = document_id;
+    request.status = status;
+    Call(move(request));
+}
+
+void QueryClient::UpdateDocumentRatings(int document_id, const vector<int>& ratings) {
+    Request request;
+    request.type = RequestType::UPDATE_DOCUMENT_RATINGS;
+    request.document_id = document_id;
+    request.ratings = ratings;
+    Call(move(request));
+}
+
+uint32_t QueryClient::Send(Request request) {
+    request.id = next_id_++;
+    EncodeRequest(request, output_);
+    Flush();
+    return request.id;
+}
+
+Response QueryClient::Receive() {
+    while (true) {
+        const size_t frame_size = GetFrameSize(input_.data(), input_.size());
+        if (frame_size > 0) {
+            Response response;
+            const bool is_valid = DecodeResponse(input_.data() + FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE, response);
+            input_.erase(input_.begin(), input_.begin() + frame_size);
+            if (!is_valid) {
+                throw runtime_error("Malformed response"s);
+            }
+            return response;
+        }
+
+        const size_t offset = input_.size();
+        input_.resize(offset + READ_CHUNK_SIZE);
+        const ssize_t result = read(fd_, input_.data() + offset, READ_CHUNK_SIZE);
+        const int error = errno;
+        input_.resize(offset + static_cast<size_t>(max<ssize_t>(result, 0)));
+        if (result == 0) {
+            throw runtime_error("Connection closed by the server"s);
+        }
+        if (result < 0 && error != EINTR) {
+            throw system_error(error, generic_category(), "read"s);
+        }
+    }
+}
+
+Response QueryClient::Call(Request request) {
+    const uint32_t id = Send(move(request));
+    Response response = Receive();
+    if (response.id != id) {
+        throw runtime_error("Response to request "s + to_string(response.id) + " instead of "s + to_string(id));
+    }
+    if (response.code == ResponseCode::INVALID_ARGUMENT) {
+        throw invalid_argument(response.error);
+    }
+    if (response.code != ResponseCode::OK) {
+        throw runtime_error(response.error);
+    }
+    return response;
+}
+
+void QueryClient::Flush() {
+    size_t offset = 0;
+    while (offset < output_.size()) {
+        const ssize_t result = send(fd_, output_.data() + offset, output_.size() - offset, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int error = errno;
+            output_.clear();
+            throw system_error(error, generic_category(), "send"s);
+        }
+        offset += static_cast<size_t>(result);
+    }
+    output_.clear();
+}
+
+#endif
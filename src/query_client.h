@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "query_protocol.h"
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Blocking client of QueryServer. Errors of the search server are rethrown as
+// invalid_argument, connection failures as system_error or runtime_error.
+class QueryClient {
+public:
+    // Connect to a Unix domain socket
+    explicit QueryClient(const std::string& unix_socket_path);
+    // Connect to 127.0.0.1:port
+    explicit QueryClient(uint16_t port);
+    ~QueryClient();
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string& raw_query, int document_id);
+    void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpsertDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+    void UpdateDocumentRatings(int document_id, const std::vector<int>& ratings);
+
+    // Several requests can be sent before their responses are read, the server answers
+    // them in the same order. Send returns the id it assigned to the request.
+    uint32_t Send(Request request);
+    // The next response as is, without converting error codes to exceptions
+    Response Receive();
+
+private:
+    Response Call(Request request);
+    void Flush();
+
+    int fd_ = -1;
+    uint32_t next_id_ = 1;
+    std::vector<uint8_t> output_;
+    std::vector<uint8_t> input_;
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "query_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+class Writer {
+public:
+    explicit Writer(vector<uint8_t>& buffer)
+        : buffer_(buffer)
+        , frame_begin_(buffer.size()) {
+        // The payload size is patched in Finish
+        WriteUint32(0);
+    }
+
+    void WriteUint8(uint8_t value) {
+        buffer_.push_back(value);
+    }
+
+    void WriteUint32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            buffer_.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void WriteInt32(int value) {
+        WriteUint32(static_cast<uint32_t>(value));
+    }
+
+    void WriteDouble(double value) {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        WriteUint32(static_cast<uint32_t>(bits));
+        WriteUint32(static_cast<uint32_t>(bits >> 32));
+    }
+
+    void WriteString(string_view value) {
+        WriteUint32(static_cast<uint32_t>(value.size()));
+        buffer_.insert(buffer_.end(), value.begin(), value.end());
+    }
+
+    void Finish() {
+        const uint32_t payload_size = static_cast<uint32_t>(buffer_.size() - frame_begin_ - FRAME_HEADER_SIZE);
+        for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+            buffer_[frame_begin_ + i] = static_cast<uint8_t>(payload_size >> (8 * i));
+        }
+    }
+
+private:
+    vector<uint8_t>& buffer_;
+    size_t frame_begin_;
+};
+
+// Reads past the end set the failed flag instead of throwing, the caller checks it once
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+
+    uint8_t ReadUint8() {
+        if (!Has(1)) {
+            return 0;
+        }
+        return data_[position_++];
+    }
+
+    uint32_t ReadUint32() {
+        if (!Has(4)) {
+            return 0;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data_[position_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    int ReadInt32() {
+        return static_cast<int>(ReadUint32());
+    }
+
+    double ReadDouble() {
+        const uint64_t low = ReadUint32();
+        const uint64_t bits = low | (static_cast<uint64_t>(ReadUint32()) << 32);
+        double value = 0.0;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    string ReadString() {
+        const uint32_t size = ReadUint32();
+        if (!Has(size)) {
+            return {};
+        }
+        string value(reinterpret_cast<const char*>(data_ + position_), size);
+        position_ += size;
+        return value;
+    }
+
+    // Element counts are checked against the remaining bytes before anything is allocated
+    uint32_t ReadCount(size_t min_element_size) {
+        const uint32_t count = ReadUint32();
+        if (count > (size_ - position_) / min_element_size) {
+            failed_ = true;
+            return 0;
+        }
+        return count;
+    }
+
+    bool ReadStatus(DocumentStatus& status) {
+        const uint8_t value = ReadUint8();
+        if (value >= DOCUMENT_STATUS_COUNT) {
+            failed_ = true;
+            return false;
+        }
+        status = static_cast<DocumentStatus>(value);
+        return true;
+    }
+
+    // Everything was read and nothing is left
+    bool IsComplete() const {
+        return !failed_ && position_ == size_;
+    }
+
+private:
+    bool Has(size_t count) {
+        if (failed_ || size_ - position_ < count) {
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+    bool failed_ = false;
+};
+
+bool IsKnownRequestType(uint8_t type) {
+    return type >= static_cast<uint8_t>(RequestType::FIND_TOP_DOCUMENTS) && type <= static_cast<uint8_t>(RequestType::UPSERT_DOCUMENT);
+}
+
+} // namespace
+
+void EncodeRequest(const Request& request, vector<uint8_t>& buffer) {
+    Writer writer(buffer);
+    writer.WriteUint8(static_cast<uint8_t>(request.type));
+    writer.WriteUint32(request.id);
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        writer.WriteUint8(static_cast<uint8_t>(request.status));
+        writer.WriteString(request.text);
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        writer.WriteString(request.text);
+        break;
+    case RequestType::ADD_DOCUMENT:
+    case RequestType::UPSERT_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        writer.WriteUint8(static_cast<uint8_t>(request.status));
+        writer.WriteUint32(static_cast<uint32_t>(request.ratings.size()));
+        for (int rating : request.ratings) {
+            writer.WriteInt32(rating);
+        }
+        writer.WriteString(request.text);
+        break;
+    case RequestType::REMOVE_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        break;
+    case RequestType::UPDATE_DOCUMENT_STATUS:
+        writer.WriteInt32(request.document_id);
+        writer.WriteUint8(static_cast<uint8_t>(request.status));
+        break;
+    case RequestType::UPDATE_DOCUMENT_RATINGS:
+        writer.WriteInt32(request.document_id);
+        writer.WriteUint32(static_cast<uint32_t>(request.ratings.size()));
+        for (int rating : request.ratings) {
+            writer.WriteInt32(rating);
+        }
+        break;
+    }
+    writer.Finish();
+}
+
+void EncodeResponse(const Response& response, vector<uint8_t>& buffer) {
+    Writer writer(buffer);
+    writer.WriteUint8(static_cast<uint8_t>(response.type));
+    writer.WriteUint32(response.id);
+    writer.WriteUint8(static_cast<uint8_t>(response.code));
+    if (response.code != ResponseCode::OK) {
+        writer.WriteString(response.error);
+    }
+    else if (response.type == RequestType::FIND_TOP_DOCUMENTS) {
+        writer.WriteUint32(static_cast<uint32_t>(response.documents.size()));
+        for (const Document& document : response.documents) {
+            writer.WriteInt32(document.id);
+            writer.WriteDouble(document.relevance);
+            writer.WriteInt32(document.rating);
+        }
+    }
+    else if (response.type == RequestType::MATCH_DOCUMENT) {
+        writer.WriteUint8(static_cast<uint8_t>(response.status));
+        writer.WriteUint32(static_cast<uint32_t>(response.words.size()));
+        for (const string& word : response.words) {
+            writer.WriteString(word);
+        }
+    }
+    writer.Finish();
+}
+
+size_t GetFrameSize(const uint8_t* data, size_t size) {
+    if (size < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    size_t payload_size = 0;
+    for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+        payload_size |= static_cast<size_t>(data[i]) << (8 * i);
+    }
+    if (payload_size > MAX_FRAME_SIZE) {
+        throw invalid_argument("Frame of "s + to_string(payload_size) + " bytes exceeds the limit"s);
+    }
+    return (size - FRAME_HEADER_SIZE >= payload_size) ? FRAME_HEADER_SIZE + payload_size : 0;
+}
+
+bool DecodeRequest(const uint8_t* payload, size_t size, Request& request) {
+    Reader reader(payload, size);
+    const uint8_t type = reader.ReadUint8();
+    request.id = reader.ReadUint32();
+    if (!IsKnownRequestType(type)) {
+        return false;
+    }
+    request.type = static_cast<RequestType>(type);
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        reader.ReadStatus(request.status);
+        request.text = reader.ReadString();
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        request.document_id = reader.ReadInt32();
+        request.text = reader.ReadString();
+        break;
+    case RequestType::ADD_DOCUMENT:
+    case RequestType::UPSERT_DOCUMENT: {
+        request.document_id = reader.ReadInt32();
+        reader.ReadStatus(request.status);
+        const uint32_t count = reader.ReadCount(4);
+        request.ratings.resize(count);
+        for (int& rating : request.ratings) {
+            rating = reader.ReadInt32();
+        }
+        request.text = reader.ReadString();
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT:
+        request.document_id = reader.ReadInt32();
+        break;
+    case RequestType::UPDATE_DOCUMENT_STATUS:
+        request.document_id = reader.ReadInt32();
+        reader.ReadStatus(request.status);
+        break;
+    case RequestType::UPDATE_DOCUMENT_RATINGS: {
+        request.document_id = reader.ReadInt32();
+        const uint32_t count = reader.ReadCount(4);
+        request.ratings.resize(count);
+        for (int& rating : request.ratings) {
+            rating = reader.ReadInt32();
+        }
+        break;
+    }
+    }
+    return reader.IsComplete();
+}
+
+bool DecodeResponse(const uint8_t* payload, size_t size, Response& response) {
+    Reader reader(payload, size);
+    const uint8_t type = reader.ReadUint8();
+    response.id = reader.ReadUint32();
+    const uint8_t code = reader.ReadUint8();
+    if (!IsKnownRequestType(type) || code > static_cast<uint8_t>(ResponseCode::INTERNAL_ERROR)) {
+        return false;
+    }
+    response.type = static_cast<RequestType>(type);
+    response.code = static_cast<ResponseCode>(code);
+    if (response.code != ResponseCode::OK) {
+        response.error = reader.ReadString();
+    }
+    else if (response.type == RequestType::FIND_TOP_DOCUMENTS) {
+        const uint32_t count = reader.ReadCount(16);
+        response.documents.resize(count);
+        for (Document& document : response.documents) {
+            document.id = reader.ReadInt32();
+            document.relevance = reader.ReadDouble();
+            document.rating = reader.ReadInt32();
+        }
+    }
+    else if (response.type == RequestType::MATCH_DOCUMENT) {
+        reader.ReadStatus(response.status);
+        const uint32_t count = reader.ReadCount(4);
+        response.words.resize(count);
+        for (string& word : response.words) {
+            word = reader.ReadString();
+        }
+    }
+    return reader.IsComplete();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary protocol of QueryServer and QueryClient. Every message is a frame of a little
+// endian uint32 payload size followed by the payload:
+//   request:  uint8 type, uint32 id, body
+//   response: uint8 type, uint32 id, uint8 code, body or a string with the error
+// Integers are little endian, strings and arrays are prefixed with a uint32 size.
+// A connection gets the responses in the order of its requests.
+
+enum class RequestType : uint8_t {
+    // body: uint8 status, string query -> uint32 count, (int32 id, float64 relevance, int32 rating) * count
+    FIND_TOP_DOCUMENTS = 1,
+    // body: int32 document id, string query -> uint8 status, uint32 count, string * count
+    MATCH_DOCUMENT = 2,
+    // body: int32 document id, uint8 status, uint32 count, int32 rating * count, string text -> empty
+    ADD_DOCUMENT = 3,
+    // body: int32 document id -> empty
+    REMOVE_DOCUMENT = 4,
+    // body: int32 document id, uint8 status -> empty
+    UPDATE_DOCUMENT_STATUS = 5,
+    // body: int32 document id, uint32 count, int32 rating * count -> empty
+    UPDATE_DOCUMENT_RATINGS = 6,
+    // body: same as ADD_DOCUMENT -> empty
+    UPSERT_DOCUMENT = 7
+};
+
+enum class ResponseCode : uint8_t {
+    OK = 0,
+    // The search server rejected the request, e.g. a query with a syntax error
+    INVALID_ARGUMENT = 1,
+    // The frame couldn't be decoded
+    MALFORMED_REQUEST = 2,
+    INTERNAL_ERROR = 3
+};
+
+inline constexpr size_t FRAME_HEADER_SIZE = 4;
+// Larger frames are treated as a broken stream
+inline constexpr size_t MAX_FRAME_SIZE = 64 << 20;
+
+struct Request {
+    RequestType type = RequestType::FIND_TOP_DOCUMENTS;
+    uint32_t id = 0;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    // Query or document text
+    std::string text;
+};
+
+struct Response {
+    RequestType type = RequestType::FIND_TOP_DOCUMENTS;
+    uint32_t id = 0;
+    ResponseCode code = ResponseCode::OK;
+    std::string error;
+    std::vector<Document> documents;
+    std::vector<std::string> words;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+};
+
+// Append a complete frame to the buffer
+void EncodeRequest(const Request& request, std::vector<uint8_t>& buffer);
+void EncodeResponse(const Response& response, std::vector<uint8_t>& buffer);
+
+// Size of the frame starting at data with its header if the whole frame is available, 0 otherwise.
+// Throws invalid_argument if the declared size exceeds MAX_FRAME_SIZE.
+size_t GetFrameSize(const uint8_t* data, size_t size);
+
+// Decode a payload without the frame header, return false if it is malformed
+bool DecodeRequest(const uint8_t* payload, size_t size, Request& request);
+bool DecodeResponse(const uint8_t* payload, size_t size, Response& response);
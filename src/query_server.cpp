@@ -0,0 +1,457 @@
+#ifdef __linux__
+
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr int MAX_EVENTS = 64;
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+int CheckResult(int result, const char* what) {
+    if (result < 0) {
+        ThrowSystemError(what);
+    }
+    return result;
+}
+
+} // namespace
+
+QueryServer::QueryServer(SearchServer& search_server, const QueryServerOptions& options)
+    : search_server_(search_server)
+    , options_(options) {
+    if (options_.max_batch_size == 0) {
+        throw invalid_argument("Batch size must be positive"s);
+    }
+    if (options_.max_request_size == 0 || options_.max_output_backlog == 0) {
+        throw invalid_argument("Buffer limits must be positive"s);
+    }
+
+    try {
+        if (!options_.unix_socket_path.empty()) {
+            sockaddr_un address{};
+            if (options_.unix_socket_path.size() >= sizeof(address.sun_path)) {
+                throw invalid_argument("Socket path is too long: "s + options_.unix_socket_path);
+            }
+            address.sun_family = AF_UNIX;
+            strcpy(address.sun_path, options_.unix_socket_path.c_str());
+            // A socket file left by a previous run would make bind fail
+            unlink(address.sun_path);
+            listen_fd_ = CheckResult(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+            CheckResult(bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)), "bind");
+        }
+        else {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(options_.tcp_port);
+            listen_fd_ = CheckResult(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+            const int reuse = 1;
+            CheckResult(setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)), "setsockopt");
+            CheckResult(bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)), "bind");
+            socklen_t length = sizeof(address);
+            CheckResult(getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length), "getsockname");
+            port_ = ntohs(address.sin_port);
+        }
+        CheckResult(listen(listen_fd_, SOMAXCONN), "listen");
+
+        epoll_fd_ = CheckResult(epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+        stop_fd_ = CheckResult(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+        timer_fd_ = CheckResult(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "timerfd_create");
+        for (int fd : { listen_fd_, stop_fd_, timer_fd_ }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            CheckResult(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event), "epoll_ctl");
+        }
+    }
+    catch (...) {
+        CloseDescriptors();
+        throw;
+    }
+}
+
+QueryServer::~QueryServer() {
+    CloseDescriptors();
+}
+
+void QueryServer::CloseDescriptors() {
+    for (const auto& [fd, connection] : connections_) {
+        close(fd);
+    }
+    connections_.clear();
+    for (int* fd : { &listen_fd_, &epoll_fd_, &stop_fd_, &timer_fd_ }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!options_.unix_socket_path.empty()) {
+        unlink(options_.unix_socket_path.c_str());
+    }
+}
+
+void QueryServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        const int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+
+        bool batch_expired = false;
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                uint64_t value = 0;
+                [[maybe_unused]] const ssize_t result = read(stop_fd_, &value, sizeof(value));
+                return;
+            }
+            if (fd == timer_fd_) {
+                uint64_t expirations = 0;
+                [[maybe_unused]] const ssize_t result = read(timer_fd_, &expirations, sizeof(expirations));
+                batch_expired = true;
+                continue;
+            }
+            if (fd == listen_fd_) {
+                Accept();
+                continue;
+            }
+
+            // An earlier event of this wakeup could have closed the connection
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            bool is_open = (events[i].events & (EPOLLERR | EPOLLHUP)) == 0 || (events[i].events & EPOLLIN) != 0;
+            if (is_open && (events[i].events & EPOLLIN) != 0) {
+                is_open = ReadFrom(fd, it->second);
+            }
+            if (is_open && (events[i].events & EPOLLOUT) != 0 && !it->second.is_broken) {
+                is_open = WriteTo(fd, it->second);
+                // The requests left in the input are handled before the socket is read again
+                if (is_open && it->second.reading_paused && !IsBackedUp(it->second)) {
+                    is_open = ReadFrom(fd, it->second);
+                }
+            }
+            if (!is_open) {
+                Close(fd);
+            }
+        }
+
+        if (!batch_.empty() && (batch_expired || options_.batch_delay.count() == 0)) {
+            RunBatch();
+        }
+    }
+}
+
+void QueryServer::Stop() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t result = write(stop_fd_, &value, sizeof(value));
+}
+
+void QueryServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            ThrowSystemError("accept4");
+        }
+        if (options_.unix_socket_path.empty()) {
+            // Responses are written in one piece, waiting for more data only adds latency
+            const int no_delay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            ThrowSystemError("epoll_ctl");
+        }
+        connections_.emplace(fd, Connection());
+    }
+}
+
+bool QueryServer::ReadFrom(int fd, Connection& connection) {
+    while (true) {
+        if (!HandleInput(fd, connection, false)) {
+            return false;
+        }
+        if (IsBackedUp(connection) || connection.is_broken) {
+            break;
+        }
+        const size_t offset = connection.input.size();
+        connection.input.resize(offset + READ_CHUNK_SIZE);
+        const ssize_t result = read(fd, connection.input.data() + offset, READ_CHUNK_SIZE);
+        const int error = errno;
+        connection.input.resize(offset + static_cast<size_t>(max<ssize_t>(result, 0)));
+        if (result > 0 || (result < 0 && error == EINTR)) {
+            continue;
+        }
+        if (result < 0 && (error == EAGAIN || error == EWOULDBLOCK)) {
+            break;
+        }
+        // The modifications which came before the end of the stream are still applied
+        HandleInput(fd, connection, true);
+        return false;
+    }
+    PauseReading(fd, connection, IsBackedUp(connection));
+    return !connection.is_broken;
+}
+
+bool QueryServer::HandleInput(int fd, Connection& connection, bool ignore_backlog) {
+    size_t position = 0;
+    try {
+        while (ignore_backlog || !IsBackedUp(connection)) {
+            const uint8_t* data = connection.input.data() + position;
+            const size_t size = connection.input.size() - position;
+            const size_t frame_size = GetFrameSize(data, size);
+            if (frame_size > options_.max_request_size || (frame_size == 0 && size > options_.max_request_size)) {
+                return false;
+            }
+            if (frame_size == 0) {
+                break;
+            }
+            Request request;
+            if (!DecodeRequest(data + FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE, request)) {
+                Response response;
+                response.type = request.type;
+                response.id = request.id;
+                response.code = ResponseCode::MALFORMED_REQUEST;
+                response.error = "Malformed request"s;
+                // Responses of the connection keep the order of its requests
+                RunBatch();
+                Send(fd, response);
+            }
+            else {
+                HandleRequest(fd, move(request));
+            }
+            position += frame_size;
+        }
+    }
+    catch (const invalid_argument&) {
+        // The frame size is broken, nothing after it can be parsed
+        return false;
+    }
+    connection.input.erase(connection.input.begin(), connection.input.begin() + static_cast<ptrdiff_t>(position));
+    return true;
+}
+
+bool QueryServer::IsBackedUp(const Connection& connection) const {
+    return connection.output.size() - connection.output_offset >= options_.max_output_backlog;
+}
+
+bool QueryServer::WriteTo(int fd, Connection& connection) {
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t result = send(fd, connection.output.data() + connection.output_offset,
+                                    connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                WatchWritable(fd, connection, true);
+                return true;
+            }
+            return false;
+        }
+        connection.output_offset += static_cast<size_t>(result);
+    }
+    connection.output.clear();
+    connection.output_offset = 0;
+    WatchWritable(fd, connection, false);
+    return true;
+}
+
+void QueryServer::Close(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+    // The descriptor can be reused by the next connection before the batch runs
+    for (PendingQuery& query : batch_) {
+        if (query.fd == fd) {
+            query.fd = -1;
+        }
+    }
+}
+
+void QueryServer::HandleRequest(int fd, Request request) {
+    if (request.type == RequestType::FIND_TOP_DOCUMENTS || request.type == RequestType::MATCH_DOCUMENT) {
+        if (batch_.empty()) {
+            ArmBatchTimer(true);
+        }
+        batch_.push_back({ fd, move(request), Response() });
+        if (batch_.size() >= options_.max_batch_size) {
+            RunBatch();
+        }
+        return;
+    }
+
+    // Queries which came before the modification don't see it
+    RunBatch();
+    Response response;
+    Execute(request, response);
+    Send(fd, response);
+}
+
+void QueryServer::RunBatch() {
+    if (batch_.empty()) {
+        return;
+    }
+    ArmBatchTimer(false);
+    for_each(execution::par, batch_.begin(), batch_.end(), [this](PendingQuery& query) {
+        Execute(query.request, query.response);
+    });
+    ++batch_count_;
+    query_count_ += batch_.size();
+
+    vector<PendingQuery> batch = move(batch_);
+    batch_.clear();
+    for (const PendingQuery& query : batch) {
+        if (query.fd >= 0) {
+            Send(query.fd, query.response);
+        }
+    }
+}
+
+void QueryServer::Execute(const Request& request, Response& response) {
+    response.type = request.type;
+    response.id = request.id;
+    try {
+        switch (request.type) {
+        case RequestType::FIND_TOP_DOCUMENTS:
+            response.documents = search_server_.FindTopDocuments(request.text, request.status);
+            break;
+        case RequestType::MATCH_DOCUMENT: {
+            const auto [words, status] = search_server_.MatchDocument(request.text, request.document_id);
+            response.words.assign(words.begin(), words.end());
+            response.status = status;
+            break;
+        }
+        case RequestType::ADD_DOCUMENT:
+            search_server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+            break;
+        case RequestType::UPSERT_DOCUMENT:
+            search_server_.UpsertDocument(request.document_id, request.text, request.status, request.ratings);
+            break;
+        case RequestType::REMOVE_DOCUMENT:
+            search_server_.RemoveDocument(request.document_id);
+            break;
+        case RequestType::UPDATE_DOCUMENT_STATUS:
+            search_server_.UpdateDocumentStatus(request.document_id, request.status);
+            break;
+        case RequestType::UPDATE_DOCUMENT_RATINGS:
+            search_server_.UpdateDocumentRatings(request.document_id, request.ratings);
+            break;
+        }
+    }
+    catch (const invalid_argument& e) {
+        response.code = ResponseCode::INVALID_ARGUMENT;
+        response.error = e.what();
+    }
+    catch (const out_of_range&) {
+        response.code = ResponseCode::INVALID_ARGUMENT;
+        response.error = "Document with id = "s + to_string(request.document_id) + " doesn't exist"s;
+    }
+    catch (const exception& e) {
+        response.code = ResponseCode::INTERNAL_ERROR;
+        response.error = e.what();
+    }
+}
+
+void QueryServer::Send(int fd, const Response& response) {
+    const auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    if (connection.is_broken) {
+        return;
+    }
+    const bool was_empty = connection.output.empty();
+    EncodeResponse(response, connection.output);
+    // A connection waiting for EPOLLOUT is written when the socket drains. A failed one is
+    // closed by the event loop, the callers can still refer to it.
+    if (was_empty && !WriteTo(fd, connection)) {
+        connection.is_broken = true;
+    }
+}
+
+void QueryServer::WatchWritable(int fd, Connection& connection, bool watch) {
+    if (connection.writable_watched != watch) {
+        connection.writable_watched = watch;
+        UpdateEvents(fd, connection);
+    }
+}
+
+void QueryServer::PauseReading(int fd, Connection& connection, bool pause) {
+    if (connection.reading_paused != pause) {
+        connection.reading_paused = pause;
+        UpdateEvents(fd, connection);
+    }
+}
+
+void QueryServer::UpdateEvents(int fd, const Connection& connection) {
+    epoll_event event{};
+    event.events = 0;
+    if (!connection.reading_paused) {
+        event.events |= EPOLLIN;
+    }
+    if (connection.writable_watched) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    CheckResult(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event), "epoll_ctl");
+}
+
+void QueryServer::ArmBatchTimer(bool arm) {
+    if (options_.batch_delay.count() == 0) {
+        return;
+    }
+    itimerspec timer{};
+    if (arm) {
+        const auto delay = options_.batch_delay.count();
+        timer.it_value.tv_sec = delay / 1'000'000;
+        timer.it_value.tv_nsec = (delay % 1'000'000) * 1'000;
+    }
+    CheckResult(timerfd_settime(timer_fd_, 0, &timer, nullptr), "timerfd_settime");
+    if (!arm) {
+        // An expiration which came before the batch was run must not cut the next batch short
+        uint64_t expirations = 0;
+        [[maybe_unused]] const ssize_t result = read(timer_fd_, &expirations, sizeof(expirations));
+    }
+}
+
+#endif
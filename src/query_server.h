@@ -0,0 +1,113 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "query_protocol.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct QueryServerOptions {
+    // Listen on a Unix domain socket if the path is set, on 127.0.0.1:tcp_port otherwise
+    std::string unix_socket_path;
+    // 0 picks a free port, see QueryServer::GetPort
+    uint16_t tcp_port = 0;
+    // A batch of queries is run as soon as it has that many queries...
+    size_t max_batch_size = 64;
+    // ...or that long after its first query. 0 runs it once the ready sockets are read.
+    std::chrono::microseconds batch_delay{ 200 };
+    // Larger requests close the connection. The input buffer of a connection holds at most
+    // one incomplete request and a read chunk.
+    size_t max_request_size = 16 << 20;
+    // A connection isn't read while this many bytes of its responses wait for the client,
+    // so a client which sends requests without reading the responses can't exhaust the memory
+    size_t max_output_backlog = 1 << 20;
+};
+
+// Serves a SearchServer over a socket with the protocol of query_protocol.h.
+// A single thread runs an epoll event loop over the connections. FindTopDocuments and
+// MatchDocument requests of all connections are collected into a batch which is run
+// in parallel like ProcessQueries; changes of the index run the pending batch
+// first and then modify the index on the loop thread, so no query sees a partial change.
+// The SearchServer must outlive the QueryServer and must not be used elsewhere while Run works.
+class QueryServer {
+public:
+    // Binds and listens, throws system_error if the socket can't be created
+    QueryServer(SearchServer& search_server, const QueryServerOptions& options);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Serve until Stop is called
+    void Run();
+    // Thread and async signal safe
+    void Stop();
+
+    uint16_t GetPort() const {
+        return port_;
+    }
+    size_t GetBatchCount() const {
+        return batch_count_;
+    }
+    size_t GetQueryCount() const {
+        return query_count_;
+    }
+
+private:
+    struct Connection {
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> output;
+        size_t output_offset = 0;
+        bool writable_watched = false;
+        // The output backlog is over the limit, EPOLLIN isn't watched
+        bool reading_paused = false;
+        // A write failed, the connection is closed by the event loop
+        bool is_broken = false;
+    };
+
+    struct PendingQuery {
+        int fd;
+        Request request;
+        Response response;
+    };
+
+    void CloseDescriptors();
+    void Accept();
+    // Returns false if the connection has to be closed
+    bool ReadFrom(int fd, Connection& connection);
+    // Handles the complete requests of the input until the output backlog is over the limit,
+    // returns false if the input is broken
+    bool HandleInput(int fd, Connection& connection, bool ignore_backlog);
+    bool IsBackedUp(const Connection& connection) const;
+    bool WriteTo(int fd, Connection& connection);
+    void Close(int fd);
+    void HandleRequest(int fd, Request request);
+    void RunBatch();
+    void Execute(const Request& request, Response& response);
+    void Send(int fd, const Response& response);
+    void WatchWritable(int fd, Connection& connection, bool watch);
+    void PauseReading(int fd, Connection& connection, bool pause);
+    void UpdateEvents(int fd, const Connection& connection);
+    void ArmBatchTimer(bool arm);
+
+    SearchServer& search_server_;
+    QueryServerOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    int timer_fd_ = -1;
+    uint16_t port_ = 0;
+
+    std::unordered_map<int, Connection> connections_;
+    std::vector<PendingQuery> batch_;
+    std::atomic<size_t> batch_count_ = 0;
+    std::atomic<size_t> query_count_ = 0;
+};
+
+#endif
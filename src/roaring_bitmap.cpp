@@ -0,0 +1,180 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+
+using namespace std;
+
+bool RoaringBitmap::Container::Contains(uint16_t low) const {
+    if (IsBitmap()) {
+        return (bitmap[low / 64] >> (low % 64)) & 1;
+    }
+    return binary_search(array.begin(), array.end(), low);
+}
+
+vector<RoaringBitmap::Container>::iterator RoaringBitmap::FindContainer(uint16_t key) {
+    return lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t key) { return container.key < key; });
+}
+
+vector<RoaringBitmap::Container>::const_iterator RoaringBitmap::FindContainer(uint16_t key) const {
+    return lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t key) { return container.key < key; });
+}
+
+bool RoaringBitmap::Add(uint32_t value) {
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const uint16_t low = static_cast<uint16_t>(value & 0xFFFF);
+    auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container());
+        it->key = key;
+    }
+    Container& container = *it;
+    if (container.IsBitmap()) {
+        uint64_t& word = container.bitmap[low / 64];
+        const uint64_t bit = uint64_t(1) << (low % 64);
+        if (word & bit) {
+            return false;
+        }
+        word |= bit;
+    }
+    else {
+        // Numbers are usually added in ascending order
+        const auto position = (container.array.empty() || container.array.back() < low)
+            ? container.array.end() : lower_bound(container.array.begin(), container.array.end(), low);
+        if (position != container.array.end() && *position == low) {
+            return false;
+        }
+        container.array.insert(position, low);
+        if (container.array.size() > ARRAY_MAX_SIZE) {
+            ConvertToBitmap(container);
+        }
+    }
+    ++container.size;
+    ++size_;
+    return true;
+}
+
+bool RoaringBitmap::Remove(uint32_t value) {
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const uint16_t low = static_cast<uint16_t>(value & 0xFFFF);
+    const auto it = FindContainer(key);
+    if (it == containers_.end() || it->key != key) {
+        return false;
+    }
+    Container& container = *it;
+    if (container.IsBitmap()) {
+        uint64_t& word = container.bitmap[low / 64];
+        const uint64_t bit = uint64_t(1) << (low % 64);
+        if (!(word & bit)) {
+            return false;
+        }
+        word &= ~bit;
+    }
+    else {
+        const auto position = lower_bound(container.array.begin(), container.array.end(), low);
+        if (position == container.array.end() || *position != low) {
+            return false;
+        }
+        container.array.erase(position);
+    }
+    --container.size;
+    --size_;
+    if (container.size == 0) {
+        containers_.erase(it);
+    }
+    else if (container.IsBitmap() && container.size <= ARRAY_MAX_SIZE / 2) {
+        // Converting back only at half of the limit keeps a container around it from flipping
+        ConvertToArray(container);
+    }
+    return true;
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    const auto it = FindContainer(key);
+    return it != containers_.end() && it->key == key && it->Contains(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+RoaringBitmap RoaringBitmap::And(const RoaringBitmap& lhs, const RoaringBitmap& rhs) {
+    RoaringBitmap result;
+    auto left = lhs.containers_.begin();
+    auto right = rhs.containers_.begin();
+    while (left != lhs.containers_.end() && right != rhs.containers_.end()) {
+        if (left->key < right->key) {
+            ++left;
+            continue;
+        }
+        if (right->key < left->key) {
+            ++right;
+            continue;
+        }
+
+        Container container;
+        container.key = left->key;
+        if (left->IsBitmap() && right->IsBitmap()) {
+            container.bitmap.resize(BITMAP_WORD_COUNT);
+            for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i) {
+                container.bitmap[i] = left->bitmap[i] & right->bitmap[i];
+                container.size += static_cast<uint32_t>(__builtin_popcountll(container.bitmap[i]));
+            }
+            if (container.size <= ARRAY_MAX_SIZE) {
+                ConvertToArray(container);
+            }
+        }
+        else if (!left->IsBitmap() && !right->IsBitmap()) {
+            set_intersection(left->array.begin(), left->array.end(), right->array.begin(), right->array.end(),
+                             back_inserter(container.array));
+            container.size = static_cast<uint32_t>(container.array.size());
+        }
+        else {
+            // The array is probed in the bitmap
+            const Container& array = left->IsBitmap() ? *right : *left;
+            const Container& bitmap = left->IsBitmap() ? *left : *right;
+            for (uint16_t low : array.array) {
+                if (bitmap.Contains(low)) {
+                    container.array.push_back(low);
+                }
+            }
+            container.size = static_cast<uint32_t>(container.array.size());
+        }
+        if (container.size > 0) {
+            result.size_ += container.size;
+            result.containers_.push_back(move(container));
+        }
+        ++left;
+        ++right;
+    }
+    return result;
+}
+
+void RoaringBitmap::AppendTo(vector<uint32_t>& values) const {
+    values.reserve(values.size() + size_);
+    ForEachBlock([&values](uint32_t first, uint64_t bits) {
+        while (bits != 0) {
+            values.push_back(first + static_cast<uint32_t>(__builtin_ctzll(bits)));
+            bits &= bits - 1;
+        }
+    });
+}
+
+void RoaringBitmap::ConvertToBitmap(Container& container) {
+    container.bitmap.assign(BITMAP_WORD_COUNT, 0);
+    for (uint16_t low : container.array) {
+        container.bitmap[low / 64] |= uint64_t(1) << (low % 64);
+    }
+    vector<uint16_t>().swap(container.array);
+}
+
+void RoaringBitmap::ConvertToArray(Container& container) {
+    container.array.clear();
+    container.array.reserve(container.size);
+    for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i) {
+        uint64_t bits = container.bitmap[i];
+        while (bits != 0) {
+            container.array.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(bits)));
+            bits &= bits - 1;
+        }
+    }
+    vector<uint64_t>().swap(container.bitmap);
+}
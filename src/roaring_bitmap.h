@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of 32 bit numbers in the layout of Roaring bitmaps: the numbers sharing
+// their high 16 bits are kept in a container, a sorted array of the low bits while it holds
+// at most ARRAY_MAX_SIZE of them and a bitmap of all 65536 low bits after that. A bitmap
+// container costs 8 KiB, the same as a full array one, and is tested and combined word by word.
+class RoaringBitmap {
+public:
+    inline static constexpr size_t ARRAY_MAX_SIZE = 4096;
+
+    // Returns false if the number is already present
+    bool Add(uint32_t value);
+    // Returns false if the number is absent
+    bool Remove(uint32_t value);
+    bool Contains(uint32_t value) const;
+
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Numbers present in both bitmaps
+    static RoaringBitmap And(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+    // Appends the numbers in ascending order
+    void AppendTo(std::vector<uint32_t>& values) const;
+
+    // Calls func(first, bits) in ascending order for every aligned block of 64 numbers with some
+    // of them present, bit i of bits stands for first + i
+    template <typename Func>
+    void ForEachBlock(Func func) const;
+
+    template <typename Func>
+    void ForEachBuffer(Func func) const {
+        if (containers_.capacity() > 0) {
+            func(containers_.capacity() * sizeof(Container));
+        }
+        for (const Container& container : containers_) {
+            if (container.array.capacity() > 0) {
+                func(container.array.capacity() * sizeof(uint16_t));
+            }
+            if (container.bitmap.capacity() > 0) {
+                func(container.bitmap.capacity() * sizeof(uint64_t));
+            }
+        }
+    }
+
+private:
+    inline static constexpr size_t BITMAP_WORD_COUNT = 65536 / 64;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t size = 0;
+        // Exactly one of them is used
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bitmap;
+
+        bool IsBitmap() const {
+            return !bitmap.empty();
+        }
+        bool Contains(uint16_t low) const;
+    };
+
+    std::vector<Container>::iterator FindContainer(uint16_t key);
+    std::vector<Container>::const_iterator FindContainer(uint16_t key) const;
+    static void ConvertToBitmap(Container& container);
+    static void ConvertToArray(Container& container);
+
+    // By ascending key
+    std::vector<Container> containers_;
+    size_t size_ = 0;
+};
+
+template <typename Func>
+void RoaringBitmap::ForEachBlock(Func func) const {
+    for (const Container& container : containers_) {
+        const uint32_t base = static_cast<uint32_t>(container.key) << 16;
+        if (container.IsBitmap()) {
+            for (size_t i = 0; i < BITMAP_WORD_COUNT; ++i) {
+                if (container.bitmap[i] != 0) {
+                    func(base + static_cast<uint32_t>(i * 64), container.bitmap[i]);
+                }
+            }
+            continue;
+        }
+        for (size_t i = 0; i < container.array.size();) {
+            const uint16_t block = container.array[i] / 64;
+            uint64_t bits = 0;
+            for (; i < container.array.size() && container.array[i] / 64 == block; ++i) {
+                bits |= uint64_t(1) << (container.array[i] % 64);
+            }
+            func(base + block * 64u, bits);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Index wide statistics the ranking functions depend on
+struct ScoringContext {
+    size_t document_count = 0;
+    // Average number of non stop words in a document
+    double average_document_length = 0.0;
+};
+
+// A scorer policy is passed to FindTopDocuments as its first argument. Its Prepare
+// method is called once per query and returns a ranker with
+//   double ComputeWordWeight(size_t document_freq) const - constant part of a word score,
+//   double operator()(double word_weight, double term_freq, uint32_t document_length) const
+// where term_freq is the share of the word among the words of the document.
+// The ranker is inlined into the posting loops, so it has to be cheap to call.
+// A ranker declaring IS_LINEAR = true promises that operator() returns
+// word_weight * term_freq, which lets the search use the vectorized scoring kernels.
+
+class TfIdfScorer {
+public:
+    class Ranker {
+    public:
+        static constexpr bool IS_LINEAR = true;
+
+        explicit Ranker(const ScoringContext& context)
+            : document_count_(static_cast<double>(context.document_count)) {
+        }
+
+        double ComputeWordWeight(size_t document_freq) const {
+            return std::log(document_count_ / static_cast<double>(document_freq));
+        }
+
+        double operator()(double word_weight, double term_freq, uint32_t) const {
+            return term_freq * word_weight;
+        }
+
+    private:
+        double document_count_;
+    };
+
+    Ranker Prepare(const ScoringContext& context) const {
+        return Ranker(context);
+    }
+};
+
+class Bm25Scorer {
+public:
+    explicit Bm25Scorer(double k1 = 1.2, double b = 0.75)
+        : k1_(k1)
+        , b_(b) {
+    }
+
+    class Ranker {
+    public:
+        Ranker(const ScoringContext& context, double k1, double b)
+            : document_count_(static_cast<double>(context.document_count))
+            , k1_plus_one_(k1 + 1.0)
+            , length_free_norm_(k1 * (1.0 - b))
+            , average_length_norm_(context.average_document_length > 0.0 ? k1 * b / context.average_document_length : 0.0) {
+        }
+
+        double ComputeWordWeight(size_t document_freq) const {
+            const double freq = static_cast<double>(document_freq);
+            return std::log(1.0 + (document_count_ - freq + 0.5) / (freq + 0.5));
+        }
+
+        // The usual count * (k1 + 1) / (count + k1 * (1 - b + b * length / average))
+        // with both parts divided by the length, since term_freq = count / length
+        double operator()(double word_weight, double term_freq, uint32_t document_length) const {
+            return word_weight * term_freq * k1_plus_one_ /
+                (term_freq + length_free_norm_ / static_cast<double>(document_length) + average_length_norm_);
+        }
+
+    private:
+        double document_count_;
+        double k1_plus_one_;
+        double length_free_norm_;
+        double average_length_norm_;
+    };
+
+    Ranker Prepare(const ScoringContext& context) const {
+        return Ranker(context, k1_, b_);
+    }
+
+private:
+    double k1_;
+    double b_;
+};
+
+template <typename Scorer, typename = void>
+struct IsScorer : std::false_type {};
+
+template <typename Scorer>
+struct IsScorer<Scorer, std::void_t<decltype(std::declval<const Scorer&>().Prepare(std::declval<const ScoringContext&>()))>>
+    : std::true_type {};
+
+template <typename Ranker, typename = void>
+struct IsLinearRanker : std::false_type {};
+
+template <typename Ranker>
+struct IsLinearRanker<Ranker, std::enable_if_t<Ranker::IS_LINEAR>> : std::true_type {};
@@ -0,0 +1,272 @@
+#include "scoring_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCORING_KERNELS_HAS_X86
+#endif
+
+using namespace std;
+
+namespace {
+
+using AccumulateFunc = void (*)(const uint32_t*, const float*, size_t, double, double*);
+
+void AccumulateScalar(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    for (size_t i = 0; i < count; ++i) {
+        scores[documents[i]] += static_cast<double>(term_freqs[i]) * weight;
+    }
+}
+
+#ifdef SCORING_KERNELS_HAS_X86
+
+// Products are rounded before the addition like in the scalar loop, so every kernel
+// gives bit for bit the same scores. The masked forms of the gathers and conversions
+// with a zeroed source are used because the plain ones start from an undefined register,
+// which GCC reports as maybe uninitialized
+
+__attribute__((target("sse2")))
+void AccumulateSse2(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    const __m128d weights = _mm_set1_pd(weight);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 freqs = _mm_loadu_ps(term_freqs + i);
+        alignas(16) double products[4];
+        _mm_store_pd(products, _mm_mul_pd(_mm_cvtps_pd(freqs), weights));
+        _mm_store_pd(products + 2, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(freqs, freqs)), weights));
+        for (size_t k = 0; k < 4; ++k) {
+            scores[documents[i + k]] += products[k];
+        }
+    }
+    AccumulateScalar(documents + i, term_freqs + i, count - i, weight, scores);
+}
+
+__attribute__((target("avx2")))
+void AccumulateAvx2(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    const __m256d weights = _mm256_set1_pd(weight);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(documents + i));
+        const __m256d products = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(term_freqs + i)), weights);
+        const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        const __m256d sums = _mm256_add_pd(_mm256_mask_i32gather_pd(_mm256_setzero_pd(), scores, indices, all, 8), products);
+        // AVX2 has no scatter
+        alignas(32) double results[4];
+        _mm256_store_pd(results, sums);
+        for (size_t k = 0; k < 4; ++k) {
+            scores[documents[i + k]] = results[k];
+        }
+    }
+    AccumulateScalar(documents + i, term_freqs + i, count - i, weight, scores);
+}
+
+__attribute__((target("avx512f")))
+void AccumulateAvx512(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    const __m512d weights = _mm512_set1_pd(weight);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(documents + i));
+        const __m512d products = _mm512_mul_pd(_mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(term_freqs + i)), weights);
+        const __m512d sums = _mm512_add_pd(_mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, indices, scores, 8), products);
+        _mm512_i32scatter_pd(scores, indices, sums, 8);
+    }
+    AccumulateScalar(documents + i, term_freqs + i, count - i, weight, scores);
+}
+
+#endif
+
+AccumulateFunc GetAccumulateFunc(ScoringKernel kernel) {
+    switch (kernel) {
+#ifdef SCORING_KERNELS_HAS_X86
+    case ScoringKernel::SSE2:
+        return AccumulateSse2;
+    case ScoringKernel::AVX2:
+        return AccumulateAvx2;
+    case ScoringKernel::AVX512:
+        return AccumulateAvx512;
+#endif
+    default:
+        return AccumulateScalar;
+    }
+}
+
+ScoringKernel DetectScoringKernel() {
+    for (ScoringKernel kernel : { ScoringKernel::AVX512, ScoringKernel::AVX2, ScoringKernel::SSE2 }) {
+        if (IsScoringKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return ScoringKernel::SCALAR;
+}
+
+atomic<ScoringKernel>& ActiveKernel() {
+    static atomic<ScoringKernel> kernel(DetectScoringKernel());
+    return kernel;
+}
+
+atomic<AccumulateFunc>& ActiveAccumulateFunc() {
+    static atomic<AccumulateFunc> func(GetAccumulateFunc(ActiveKernel().load()));
+    return func;
+}
+
+} // namespace
+
+void AccumulateScores(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    ActiveAccumulateFunc().load(memory_order_relaxed)(documents, term_freqs, count, weight, scores);
+}
+
+void AccumulateScores(ScoringKernel kernel, const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores) {
+    if (!IsScoringKernelSupported(kernel)) {
+        throw invalid_argument("Scoring kernel "s + string(GetScoringKernelName(kernel)) + " is not supported"s);
+    }
+    GetAccumulateFunc(kernel)(documents, term_freqs, count, weight, scores);
+}
+
+ScoringKernel GetScoringKernel() {
+    return ActiveKernel().load();
+}
+
+bool IsScoringKernelSupported(ScoringKernel kernel) {
+    switch (kernel) {
+    case ScoringKernel::SCALAR:
+        return true;
+#ifdef SCORING_KERNELS_HAS_X86
+    case ScoringKernel::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case ScoringKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case ScoringKernel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+void SetScoringKernel(ScoringKernel kernel) {
+    if (!IsScoringKernelSupported(kernel)) {
+        throw invalid_argument("Scoring kernel "s + string(GetScoringKernelName(kernel)) + " is not supported"s);
+    }
+    ActiveKernel().store(kernel);
+    ActiveAccumulateFunc().store(GetAccumulateFunc(kernel));
+}
+
+string_view GetScoringKernelName(ScoringKernel kernel) {
+    switch (kernel) {
+    case ScoringKernel::SCALAR:
+        return "scalar"sv;
+    case ScoringKernel::SSE2:
+        return "sse2"sv;
+    case ScoringKernel::AVX2:
+        return "avx2"sv;
+    case ScoringKernel::AVX512:
+        return "avx512"sv;
+    }
+    return "unknown"sv;
+}
+
+// ----------------------------------------------------------------------------
+
+ScoreAccumulator::Scope::Scope()
+    : accumulator_(Acquire(nested_)) {
+}
+
+ScoreAccumulator::Scope::~Scope() {
+    accumulator_.Clear();
+    if (!nested_) {
+        accumulator_.is_used_ = false;
+    }
+}
+
+ScoreAccumulator& ScoreAccumulator::ForCurrentThread() {
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+ScoreAccumulator& ScoreAccumulator::Acquire(unique_ptr<ScoreAccumulator>& nested) {
+    ScoreAccumulator& accumulator = ForCurrentThread();
+    if (!accumulator.is_used_) {
+        accumulator.is_used_ = true;
+        return accumulator;
+    }
+    nested = make_unique<ScoreAccumulator>();
+    return *nested;
+}
+
+void ScoreAccumulator::Reserve(size_t document_count) {
+    if (scores_.size() < document_count) {
+        scores_.resize(document_count, 0.0);
+        touched_.resize((document_count + 63) / 64, 0);
+    }
+}
+
+void ScoreAccumulator::Add(const uint32_t* documents, const float* term_freqs, size_t count, double weight) {
+    AccumulateScores(documents, term_freqs, count, weight, scores_.data());
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t& word = touched_[documents[i] / 64];
+        if (word == 0) {
+            touched_words_.push_back(documents[i] / 64);
+        }
+        word |= uint64_t(1) << (documents[i] % 64);
+    }
+}
+
+void ScoreAccumulator::Remove(uint32_t document) {
+    if (document < scores_.size()) {
+        touched_[document / 64] &= ~(uint64_t(1) << (document % 64));
+        scores_[document] = 0.0;
+    }
+}
+
+void ScoreAccumulator::Remove(const RoaringBitmap& documents) {
+    documents.ForEachBlock([this](uint32_t first, uint64_t bits) {
+        const size_t block = first / 64;
+        if (block >= touched_.size()) {
+            return;
+        }
+        // Untouched scores are already zero
+        uint64_t removed = touched_[block] & bits;
+        touched_[block] &= ~bits;
+        while (removed != 0) {
+            scores_[first + __builtin_ctzll(removed)] = 0.0;
+            removed &= removed - 1;
+        }
+    });
+}
+
+void ScoreAccumulator::Keep(const uint64_t* bits, size_t word_count) {
+    for (uint32_t word : touched_words_) {
+        const uint64_t kept = word < word_count ? bits[word] : 0;
+        uint64_t removed = touched_[word] & ~kept;
+        touched_[word] &= kept;
+        while (removed != 0) {
+            scores_[word * 64 + __builtin_ctzll(removed)] = 0.0;
+            removed &= removed - 1;
+        }
+    }
+}
+
+bool ScoreAccumulator::SortTouchedWords() {
+    if (touched_words_.size() * 8 > touched_.size()) {
+        return false;
+    }
+    sort(touched_words_.begin(), touched_words_.end());
+    touched_words_.erase(unique(touched_words_.begin(), touched_words_.end()), touched_words_.end());
+    return true;
+}
+
+void ScoreAccumulator::Clear() {
+    for (uint32_t word : touched_words_) {
+        uint64_t bits = touched_[word];
+        while (bits != 0) {
+            scores_[word * 64 + __builtin_ctzll(bits)] = 0.0;
+            bits &= bits - 1;
+        }
+        touched_[word] = 0;
+    }
+    touched_words_.clear();
+}
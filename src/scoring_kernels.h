@@ -0,0 +1,111 @@
+#pragma once
+
+#include "roaring_bitmap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Instruction sets of the score accumulation kernel, the best supported one is
+// picked at startup and can be overridden for testing and benchmarks
+enum class ScoringKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+// scores[documents[i]] += weight * term_freqs[i] for i < count. Documents must be
+// distinct, which holds for a posting list and lets AVX-512 scatter without conflicts.
+void AccumulateScores(const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores);
+// Same with the given kernel instead of the active one
+void AccumulateScores(ScoringKernel kernel, const uint32_t* documents, const float* term_freqs, size_t count, double weight, double* scores);
+
+ScoringKernel GetScoringKernel();
+bool IsScoringKernelSupported(ScoringKernel kernel);
+// Throws invalid_argument if the CPU doesn't support the kernel
+void SetScoringKernel(ScoringKernel kernel);
+std::string_view GetScoringKernelName(ScoringKernel kernel);
+
+// Dense per-document scores of one query. Reused by the thread between queries,
+// so only the touched documents are reset instead of the whole array.
+class ScoreAccumulator {
+public:
+    // The accumulator of the thread for one query. It is reset when the scope ends, also when
+    // the query throws, so the next query of the thread starts from zero scores whatever server
+    // it runs on. A query run from inside another one, e.g. from its predicate, gets its own.
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ScoreAccumulator& Get() const {
+            return accumulator_;
+        }
+
+    private:
+        std::unique_ptr<ScoreAccumulator> nested_;
+        ScoreAccumulator& accumulator_;
+    };
+
+    // Makes room for documents with internal numbers below document_count
+    void Reserve(size_t document_count);
+
+    void Add(const uint32_t* documents, const float* term_freqs, size_t count, double weight);
+    // The document is no longer reported by Drain
+    void Remove(uint32_t document);
+    // Removes the documents of the bitmap a block of 64 at a time
+    void Remove(const RoaringBitmap& documents);
+    // Removes the documents whose bit is not set, bit d % 64 of bits[d / 64] stands for document d
+    void Keep(const uint64_t* bits, size_t word_count);
+
+    // Calls func(document, score) for the touched documents in ascending order and resets them
+    template <typename Func>
+    void Drain(Func func);
+
+private:
+    static ScoreAccumulator& ForCurrentThread();
+    // The accumulator of the thread if it is free, otherwise a new one owned by nested
+    static ScoreAccumulator& Acquire(std::unique_ptr<ScoreAccumulator>& nested);
+
+    // Sorts the touched words, unless most of the words are touched and are scanned in order anyway
+    bool SortTouchedWords();
+    // Resets the scores of the touched documents
+    void Clear();
+
+    std::vector<double> scores_;
+    std::vector<uint64_t> touched_;
+    // Indexes of the words of touched_ set since the last reset, may repeat
+    std::vector<uint32_t> touched_words_;
+    bool is_used_ = false;
+};
+
+template <typename Func>
+void ScoreAccumulator::Drain(Func func) {
+    const auto drain_word = [this, &func](size_t word) {
+        uint64_t bits = touched_[word];
+        while (bits != 0) {
+            const uint32_t document = static_cast<uint32_t>(word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+            func(document, scores_[document]);
+            scores_[document] = 0.0;
+        }
+        touched_[word] = 0;
+    };
+    if (SortTouchedWords()) {
+        for (uint32_t word : touched_words_) {
+            drain_word(word);
+        }
+    }
+    else {
+        for (size_t word = 0; word < touched_.size(); ++word) {
+            drain_word(word);
+        }
+    }
+    touched_words_.clear();
+}
@@ -1,19 +1,195 @@
 #include "search_server.h"
 
+#include <charconv>
 #include <cmath>
+#include <exception>
 #include <numeric>
 
 using namespace std;
 
-SearchServer::SearchServer(const std::string& stop_words) :
-    SearchServer(string_view(stop_words)) {
+namespace {
+
+// Words shorter than this are looked up with one typo by word~
+constexpr size_t MIN_TWO_TYPOS_LENGTH = 6;
+
+// '*' matches any sequence of characters and '?' a single one
+bool MatchesPattern(string_view word, string_view pattern) {
+    size_t w = 0;
+    size_t p = 0;
+    size_t star = string_view::npos;
+    size_t star_word = 0;
+    while (w < word.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == word[w])) {
+            ++w;
+            ++p;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_word = w;
+        }
+        else if (star != string_view::npos) {
+            // Let the last star absorb one more character
+            p = star + 1;
+            w = ++star_word;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+// Digits of a query suffix like word~N, throws invalid_argument if they don't fit uint32_t
+uint32_t ParseQueryNumber(string_view digits, string_view word) {
+    uint32_t number = 0;
+    const auto [end, error] = from_chars(digits.data(), digits.data() + digits.size(), number);
+    if (error != errc() || end != digits.data() + digits.size()) {
+        throw invalid_argument("Invalid number in "s + string(word));
+    }
+    return number;
+}
+
+} // namespace
+
+SearchServer::SearchServer(const IndexOptions& options) :
+    options_(options),
+    analyzer_(options.analyzer),
+    document_store_(options.document_block_size) {
+}
+
+SearchServer::SearchServer(const std::string& stop_words, const IndexOptions& options) :
+    SearchServer(string_view(stop_words), options) {
 }
 
-SearchServer::SearchServer(const std::string_view& stop_words) :
-    SearchServer(SplitIntoWords(stop_words)) {
+SearchServer::SearchServer(const std::string_view& stop_words, const IndexOptions& options) :
+    SearchServer(SplitIntoWords(stop_words), options) {
 }
 
 void SearchServer::AddDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    PROFILE_SCOPE("AddDocument");
+    CheckNewDocumentId(document_id);
+    AddParsedDocument(document_id, ParseDocument(document), status, ratings);
+    if (options_.store_documents) {
+        document_store_.Add(document_id, string(document));
+    }
+}
+
+void SearchServer::AddOwnedDocument(int document_id, string document, DocumentStatus status, const vector<int>& ratings) {
+    PROFILE_SCOPE("AddDocument");
+    CheckNewDocumentId(document_id);
+    // The index doesn't keep views of the text, so it can be moved after parsing
+    AddParsedDocument(document_id, ParseDocument(document), status, ratings);
+    if (options_.store_documents) {
+        document_store_.Add(document_id, move(document));
+    }
+}
+
+void SearchServer::UpsertDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_data_.count(document_id) == 0) {
+        AddDocument(document_id, document, status, ratings);
+        return;
+    }
+    PROFILE_SCOPE("UpsertDocument");
+    // An invalid text throws before the old document is modified
+    const ParsedDocument parsed = ParseDocument(document);
+    UpdateDocumentStatus(document_id, status);
+    UpdateDocumentRatings(document_id, ratings);
+
+    DocumentData& document_data = document_data_.at(document_id);
+    const uint32_t ordinal = document_data.ordinal;
+    // The words of the document have to be in the partition its other postings are in
+    const DocumentStatus partition = GetPartition(document_data);
+    map<string_view, double> word_frequency;
+    auto old_word = document_data.word_frequency.begin();
+    auto new_word = parsed.word_frequency.begin();
+    // Both maps are sorted, so the words are diffed in one merge pass
+    while (old_word != document_data.word_frequency.end() || new_word != parsed.word_frequency.end()) {
+        if (new_word == parsed.word_frequency.end()
+            || (old_word != document_data.word_frequency.end() && old_word->first < new_word->first)) {
+            auto postings = word_to_document_freqs_.find(old_word->first);
+            postings->second.Remove(partition, ordinal);
+            if (postings->second.empty()) {
+                word_to_document_freqs_.erase(postings);
+            }
+            ++old_word;
+        }
+        else if (old_word == document_data.word_frequency.end() || new_word->first < old_word->first) {
+            auto [it, is_inserted] = words_to_documents_.emplace(new_word->first);
+            const string& link_word = *it;
+            if (is_inserted && options_.max_typo_distance > 0) {
+                IndexTypoDeletes(link_word);
+            }
+            word_frequency.emplace_hint(word_frequency.end(), link_word, new_word->second);
+            PartitionedPostingList& postings = word_to_document_freqs_[link_word];
+            postings.Add(partition, ordinal, new_word->second);
+            if (options_.store_positions) {
+                postings.SetPositions(partition, ordinal, parsed.word_positions.at(new_word->first));
+            }
+            ++new_word;
+        }
+        else {
+            PartitionedPostingList& postings = word_to_document_freqs_.at(old_word->first);
+            if (new_word->second != old_word->second) {
+                postings.SetTermFreq(partition, ordinal, new_word->second);
+            }
+            if (options_.store_positions) {
+                postings.ReplacePositions(partition, ordinal, parsed.word_positions.at(new_word->first));
+            }
+            word_frequency.emplace_hint(word_frequency.end(), old_word->first, new_word->second);
+            ++old_word;
+            ++new_word;
+        }
+    }
+
+    total_word_count_ = total_word_count_ - document_data.word_count + parsed.word_count;
+    document_data.word_count = parsed.word_count;
+    document_data.word_frequency = move(word_frequency);
+    if (options_.store_documents) {
+        document_store_.Add(document_id, string(document));
+    }
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    PROFILE_SCOPE("AddDocuments");
+    set<int> new_ids;
+    for (const NewDocument& document : documents) {
+        CheckNewDocumentId(document.id);
+        if (!new_ids.insert(document.id).second) {
+            throw invalid_argument("Document with id = "s + to_string(document.id) + " is added twice"s);
+        }
+    }
+
+    vector<ParsedDocument> parsed_documents(documents.size());
+    // An exception escaping a parallel algorithm terminates the program
+    vector<exception_ptr> errors(documents.size());
+    vector<size_t> indexes(documents.size());
+    iota(indexes.begin(), indexes.end(), size_t(0));
+    for_each(execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            parsed_documents[i] = ParseDocument(documents[i].text);
+        }
+        catch (...) {
+            errors[i] = current_exception();
+        }
+    });
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        AddParsedDocument(documents[i].id, parsed_documents[i], documents[i].status, documents[i].ratings);
+        if (options_.store_documents) {
+            document_store_.Add(documents[i].id, string(documents[i].text));
+        }
+    }
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if (document_id < 0) {
         throw invalid_argument("Document id must pe positive"s);
     }
@@ -21,45 +197,86 @@ void SearchServer::AddDocument(int document_id, const string_view& document, Doc
     if (document_data_.count(document_id)) {
         throw invalid_argument("Document with id = "s + to_string(document_id) + "already exists"s);
     }
+}
 
-    vector<string_view> words = SplitIntoWordsNoStop(document);
-    map<string_view, double> word_frequency;
+SearchServer::ParsedDocument SearchServer::ParseDocument(string_view document) const {
+    ParsedDocument parsed;
+    const pmr::vector<string_view> all_words = SplitDocument(document, parsed.analyzed_text);
+    vector<string_view> words;
+    words.reserve(all_words.size());
+    copy_if(all_words.begin(), all_words.end(), back_inserter(words),
+        [this](const string_view& word) {
+            return !IsStopWord(word);
+        });
+    parsed.word_count = static_cast<uint32_t>(words.size());
 
+    // Frequencies are summed in double before they are rounded to float in the postings
     const double inv_word_count = 1.0 / words.size();
     for (const string_view& word : words) {
+        parsed.word_frequency[word] += inv_word_count;
+    }
+    if (options_.store_positions) {
+        // Positions count stop words too, so phrases can't skip over other words
+        uint32_t position = 0;
+        for (const string_view& word : all_words) {
+            if (!IsStopWord(word)) {
+                parsed.word_positions[word].push_back(position);
+            }
+            ++position;
+        }
+    }
+    return parsed;
+}
+
+void SearchServer::AddParsedDocument(int document_id, const ParsedDocument& document, DocumentStatus status, const vector<int>& ratings) {
+    map<string_view, double> word_frequency;
+    const uint32_t ordinal = static_cast<uint32_t>(ordinal_to_document_.size());
+
+    for (const auto& [word, frequency] : document.word_frequency) {
         auto [it, is_inserted] = words_to_documents_.emplace(word);
         const string& link_word = *it;
-
-        if (word_to_document_freqs_[link_word].count(document_id) == 0) {
-            word_to_document_freqs_[link_word][document_id] = 0.0;
+        if (is_inserted && options_.max_typo_distance > 0) {
+            IndexTypoDeletes(link_word);
         }
-        word_to_document_freqs_[link_word][document_id] += inv_word_count;
 
-        if (word_frequency.count(link_word) == 0) {
-            word_frequency[link_word] = 0.0;
-        }
-        word_frequency[link_word] += inv_word_count;
+        // The parsed words are sorted too
+        word_frequency.emplace_hint(word_frequency.end(), link_word, frequency);
+        word_to_document_freqs_[link_word].Add(status, ordinal, frequency);
     }
-    document_data_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings),
-                                                     status, word_frequency });
+    for (const auto& [word, positions] : document.word_positions) {
+        word_to_document_freqs_.find(word)->second.SetPositions(status, ordinal, positions);
+    }
+
+    const auto [it, is_inserted] = document_data_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings),
+                                                                                    status, move(word_frequency), ordinal,
+                                                                                    document.word_count });
+    total_word_count_ += document.word_count;
     document_ids_.emplace(document_id);
+    ordinal_to_document_.push_back({ document_id, status, &it->second, status, it->second.rating });
+    rating_to_ordinals_[it->second.rating].Add(ordinal);
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view& raw_query, int document_id) const {
-    Query query = ParseQuery(raw_query, true);
+    PROFILE_SCOPE("MatchDocument");
+    const QueryArena::Scope arena;
+    Query query = ParseQuery(raw_query, arena.GetResource(), true);
+    const DocumentData& document_data = document_data_.at(document_id);
     vector<string_view> words;
-    if (!HasMinusWord(query.minus_words, document_id)) {
+    if (!HasMinusWord(query.minus_words, document_data)) {
         for (const string_view& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0 ||
-                word_to_document_freqs_.at(word).count(document_id) == 0) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end() || !it->second.Contains(GetPartition(document_data), document_data.ordinal)) {
                 continue;
             }
-            words.push_back(word);
+            // Analyzed query words live in the arena, the returned views point into the dictionary
+            words.push_back(it->first);
         }
+        MatchExpandedWords(query, document_data, words);
         sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
     }
 
-    return { words, document_data_.at(document_id).status };
+    return { words, document_data.status };
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, const string_view& raw_query, int document_id) const
@@ -69,38 +286,49 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const exe
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, const string_view& raw_query, int document_id) const
 {
-    Query query = ParseQuery(raw_query, true);
+    PROFILE_SCOPE("MatchDocumentPar");
+    const QueryArena::Scope arena;
+    Query query = ParseQuery(raw_query, arena.GetResource(), true);
+    const DocumentData& document_data = document_data_.at(document_id);
 
     vector<string_view> words;
-    if (!HasMinusWord(query.minus_words, document_id)) {
+    if (!HasMinusWord(query.minus_words, document_data)) {
         words.reserve(query.plus_words.size() + 1);
 
         for_each(execution::par, query.plus_words.begin(), query.plus_words.end(),
-            [this, &words, &document_id](const string_view& word) {
-                if (word_to_document_freqs_.count(word) != 0 &&
-                    word_to_document_freqs_.at(word).count(document_id) != 0) {
-                    words.push_back(word);
+            [this, &words, &document_data, partition = GetPartition(document_data)](const string_view& word) {
+                const auto it = word_to_document_freqs_.find(word);
+                if (it != word_to_document_freqs_.end() && it->second.Contains(partition, document_data.ordinal)) {
+                    words.push_back(it->first);
                 }
             });
+        MatchExpandedWords(query, document_data, words);
 
         sort(execution::par, words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
     }
 
-    return { words, document_data_.at(document_id).status };
+    return { words, document_data.status };
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query, const DocumentStatus status) const {
-    return FindTopDocuments(raw_query,
-        [status](int document_id, DocumentStatus st, int rating) { (void)document_id; (void)rating; return status == st; });
+    return FindTopDocuments(raw_query, DocumentFilter().SetStatus(status));
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query, const MatchMode& mode, const DocumentStatus status) const {
+    return FindTopDocuments(raw_query, mode, DocumentFilter().SetStatus(status));
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query, const MatchMode& mode) const {
+    return FindTopDocuments(raw_query, mode, DocumentStatus::ACTUAL);
+}
+
 vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_policy&, const string_view& raw_query, const DocumentStatus status) const {
-    return FindTopDocuments(raw_query,
-        [status](int document_id, DocumentStatus st, int rating) { (void)document_id; (void)rating; return status == st; });
+    return FindTopDocuments(raw_query, DocumentFilter().SetStatus(status));
 }
 
 vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_policy&, const string_view& raw_query) const {
@@ -108,8 +336,7 @@ vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_polic
 }
 
 vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy&, const string_view& raw_query, const DocumentStatus status) const {
-    return FindTopDocuments(execution::par, raw_query,
-        [status](int document_id, DocumentStatus st, int rating) { (void)document_id; (void)rating; return status == st; });
+    return FindTopDocuments(execution::par, raw_query, DocumentFilter().SetStatus(status));
 }
 
 vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy&, const string_view& raw_query) const {
@@ -118,17 +345,27 @@ vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy
 
 void SearchServer::RemoveDocument(int document_id)
 {
+    PROFILE_SCOPE("RemoveDocument");
     if (document_ids_.count(document_id)) {
-        const std::map<string_view, double>& word_frequency = document_data_.at(document_id).word_frequency;
-        for (const auto& [word, frequency] : word_frequency) {
-            word_to_document_freqs_.at(word).erase(document_id);
+        const DocumentData& document_data = document_data_.at(document_id);
+        const DocumentStatus partition = GetPartition(document_data);
+        for (const auto& [word, frequency] : document_data.word_frequency) {
+            word_to_document_freqs_.at(word).Remove(partition, document_data.ordinal);
             if (word_to_document_freqs_.at(word).size() == 0) {
                 word_to_document_freqs_.erase(word);
             }
         }
 
+        if (partition != document_data.status) {
+            --MisplacedCount(partition, document_data.status);
+        }
+        ordinal_to_document_[document_data.ordinal].data = nullptr;
+        RemoveRatingOrdinal(document_data.rating, document_data.ordinal);
+        total_word_count_ -= document_data.word_count;
         document_ids_.erase(document_id);
         document_data_.erase(document_id);
+        document_store_.Remove(document_id);
+        CompactOrdinalsIfSparse();
     }
 }
 
@@ -139,16 +376,150 @@ void SearchServer::RemoveDocument(const execution::sequenced_policy&, int docume
 
 void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id)
 {
+    PROFILE_SCOPE("RemoveDocumentPar");
     if (document_ids_.count(document_id)) {
-        const map<string_view, double>& word_frequency = document_data_.at(document_id).word_frequency;
+        const DocumentData& document_data = document_data_.at(document_id);
+        const map<string_view, double>& word_frequency = document_data.word_frequency;
+        const DocumentStatus partition = GetPartition(document_data);
 
         for_each(execution::par, word_frequency.begin(), word_frequency.end(),
-            [this, document_id](const auto& word_freq) {
-                word_to_document_freqs_.at(word_freq.first).erase(document_id);
+            [this, partition, ordinal = document_data.ordinal](const auto& word_freq) {
+                word_to_document_freqs_.at(word_freq.first).Remove(partition, ordinal);
             });
 
+        if (partition != document_data.status) {
+            --MisplacedCount(partition, document_data.status);
+        }
+        ordinal_to_document_[document_data.ordinal].data = nullptr;
+        RemoveRatingOrdinal(document_data.rating, document_data.ordinal);
+        total_word_count_ -= document_data.word_count;
         document_ids_.erase(document_id);
         document_data_.erase(document_id);
+        document_store_.Remove(document_id);
+        CompactOrdinalsIfSparse();
+    }
+}
+
+void SearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    PROFILE_SCOPE("UpdateDocumentStatus");
+    DocumentData& document_data = document_data_.at(document_id);
+    if (document_data.status == status) {
+        return;
+    }
+    // The filters read the status from the table, the postings stay where they are for now
+    DocumentEntry& entry = ordinal_to_document_[document_data.ordinal];
+    if (entry.partition == document_data.status) {
+        pending_status_moves_.push_back(document_data.ordinal);
+    }
+    else {
+        --MisplacedCount(entry.partition, document_data.status);
+    }
+    if (entry.partition != status) {
+        ++MisplacedCount(entry.partition, status);
+    }
+    document_data.status = status;
+    entry.status = status;
+    if (pending_status_moves_.size() > options_.max_pending_status_moves) {
+        ApplyStatusMoves();
+    }
+}
+
+void SearchServer::ApplyStatusMoves() {
+    PROFILE_SCOPE("ApplyStatusMoves");
+    // A document changed more than once is listed more than once, one changed back is in place
+    sort(pending_status_moves_.begin(), pending_status_moves_.end());
+    pending_status_moves_.erase(unique(pending_status_moves_.begin(), pending_status_moves_.end()), pending_status_moves_.end());
+
+    // Ascending moves of the documents of every word
+    unordered_map<string_view, vector<PartitionedPostingList::StatusMove>> word_moves;
+    for (uint32_t ordinal : pending_status_moves_) {
+        DocumentEntry& entry = ordinal_to_document_[ordinal];
+        if (entry.data == nullptr || entry.partition == entry.status) {
+            continue;
+        }
+        for (const auto& [word, frequency] : entry.data->word_frequency) {
+            word_moves[word].push_back({ ordinal, entry.partition, entry.status });
+        }
+        entry.partition = entry.status;
+    }
+    pending_status_moves_.clear();
+    misplaced_counts_.fill(0);
+
+    for (const auto& [word, moves] : word_moves) {
+        word_to_document_freqs_.at(word).MoveDocuments(moves);
+    }
+}
+
+DocumentStatus SearchServer::GetPartition(const DocumentData& document) const {
+    return ordinal_to_document_[document.ordinal].partition;
+}
+
+size_t& SearchServer::MisplacedCount(DocumentStatus partition, DocumentStatus status) {
+    return misplaced_counts_[static_cast<size_t>(partition) * DOCUMENT_STATUS_COUNT + static_cast<size_t>(status)];
+}
+
+void SearchServer::UpdateDocumentRatings(int document_id, const vector<int>& ratings) {
+    PROFILE_SCOPE("UpdateDocumentRatings");
+    DocumentData& document_data = document_data_.at(document_id);
+    const int rating = ComputeAverageRating(ratings);
+    if (rating == document_data.rating) {
+        return;
+    }
+    RemoveRatingOrdinal(document_data.rating, document_data.ordinal);
+    rating_to_ordinals_[rating].Add(document_data.ordinal);
+    document_data.rating = rating;
+    ordinal_to_document_[document_data.ordinal].rating = rating;
+}
+
+void SearchServer::CompactOrdinalsIfSparse() {
+    ++removed_ordinal_count_;
+    // Renumbering costs about as much as removing the documents which made it necessary,
+    // while the queries only pay for the table up to twice the live documents
+    if (removed_ordinal_count_ > document_data_.size()) {
+        CompactOrdinals();
+    }
+}
+
+void SearchServer::CompactOrdinals() {
+    PROFILE_SCOPE("CompactOrdinals");
+    // The pending moves are listed by the old ordinals
+    ApplyStatusMoves();
+    // Live documents keep their order, so the posting lists stay sorted
+    vector<uint32_t> new_ordinals(ordinal_to_document_.size(), 0);
+    uint32_t live_count = 0;
+    for (uint32_t ordinal = 0; ordinal < ordinal_to_document_.size(); ++ordinal) {
+        const DocumentEntry entry = ordinal_to_document_[ordinal];
+        if (entry.data == nullptr) {
+            continue;
+        }
+        new_ordinals[ordinal] = live_count;
+        document_data_.at(entry.id).ordinal = live_count;
+        ordinal_to_document_[live_count++] = entry;
+    }
+    ordinal_to_document_.erase(ordinal_to_document_.begin() + live_count, ordinal_to_document_.end());
+    ordinal_to_document_.shrink_to_fit();
+    removed_ordinal_count_ = 0;
+
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        postings.RenumberDocuments(new_ordinals);
+    }
+    vector<uint32_t> ordinals;
+    for (auto& [rating, rating_ordinals] : rating_to_ordinals_) {
+        ordinals.clear();
+        rating_ordinals.AppendTo(ordinals);
+        RoaringBitmap renumbered;
+        for (uint32_t ordinal : ordinals) {
+            renumbered.Add(new_ordinals[ordinal]);
+        }
+        rating_ordinals = move(renumbered);
+    }
+}
+
+void SearchServer::RemoveRatingOrdinal(int rating, uint32_t ordinal) {
+    const auto it = rating_to_ordinals_.find(rating);
+    it->second.Remove(ordinal);
+    if (it->second.empty()) {
+        rating_to_ordinals_.erase(it);
     }
 }
 
@@ -156,6 +527,48 @@ int SearchServer::GetDocumentCount() const {
     return static_cast<int>(document_data_.size());
 }
 
+bool SearchServer::HasDocument(int document_id) const {
+    return document_data_.count(document_id) > 0;
+}
+
+void SearchServer::CheckDocumentText(string_view document) const {
+    vector<char> analyzed_text;
+    SplitDocument(document, analyzed_text);
+}
+
+ScoringContext SearchServer::GetScoringContext() const {
+    return { document_data_.size(),
+             document_data_.empty() ? 0.0 : static_cast<double>(total_word_count_) / document_data_.size() };
+}
+
+size_t SearchServer::GetDocumentFreq(string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    return it == word_to_document_freqs_.end() ? 0 : it->second.size();
+}
+
+vector<string_view> SearchServer::GetQueryWords(const string_view& raw_query) const {
+    const QueryArena::Scope arena;
+    const Query query = ParseQuery(raw_query, arena.GetResource());
+    vector<string_view> words;
+    for (const string_view& word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        // The view must not point into the arena
+        if (it != word_to_document_freqs_.end()) {
+            words.push_back(it->first);
+        }
+    }
+    for (const string_view& pattern : query.patterns) {
+        const vector<string_view> expansions = ExpandPattern(pattern, options_.max_pattern_expansions);
+        words.insert(words.end(), expansions.begin(), expansions.end());
+    }
+    for (const auto& [fuzzy_word, max_distance] : query.fuzzy_words) {
+        for (const auto& [word, distance] : FindSimilarWords(fuzzy_word, max_distance, options_.max_pattern_expansions)) {
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
 const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
 {
     static const map<string_view, double> empty;
@@ -165,6 +578,13 @@ const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id
         : document_data_.at(document_id).word_frequency;
 }
 
+string SearchServer::GetDocumentText(int document_id) const {
+    if (!options_.store_documents) {
+        throw invalid_argument("Document texts require IndexOptions::store_documents"s);
+    }
+    return document_store_.Get(document_id);
+}
+
 string SearchServer::GetStopWords() const
 {
     string stop_words;
@@ -177,6 +597,76 @@ string SearchServer::GetStopWords() const
     return stop_words;
 }
 
+MemoryStats SearchServer::GetMemoryStats() const {
+    MemoryStats stats;
+    const auto add_container = [&stats](MemoryUsage& usage, const auto& container) {
+        const AllocationCounter& counter = *container.get_allocator().GetCounter();
+        usage.bytes += counter.GetBytes();
+        stats.allocator_overhead += counter.GetOverhead();
+        stats.allocation_count += counter.GetAllocationCount();
+    };
+    const auto add_block = [&stats](MemoryUsage& usage, size_t bytes) {
+        if (bytes > 0) {
+            usage.bytes += bytes;
+            stats.allocator_overhead += AllocationCounter::EstimateOverhead(bytes);
+            ++stats.allocation_count;
+        }
+    };
+
+    stats.term_strings.count = words_to_documents_.size();
+    for (const string& word : words_to_documents_) {
+        add_block(stats.term_strings, GetHeapSize(word));
+    }
+
+    stats.dictionary.count = words_to_documents_.size();
+    add_container(stats.dictionary, words_to_documents_);
+    add_container(stats.dictionary, word_to_document_freqs_);
+
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        stats.postings.count += postings.size();
+        postings.ForEachBuffer([&](size_t bytes) { add_block(stats.postings, bytes); });
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            const PostingList& partition = postings.GetPartition(static_cast<DocumentStatus>(status));
+            if (partition.GetBitmap() != nullptr) {
+                stats.posting_bitmaps.count += partition.size();
+                partition.ForEachBitmapBuffer([&](size_t bytes) { add_block(stats.posting_bitmaps, bytes); });
+            }
+        }
+    }
+
+    add_container(stats.forward_index, document_data_);
+    for (const auto& [document_id, document_data] : document_data_) {
+        stats.forward_index.count += document_data.word_frequency.size();
+        for (size_t i = 0; i < document_data.word_frequency.size(); ++i) {
+            add_block(stats.forward_index, TREE_NODE_HEADER_SIZE + sizeof(pair<const string_view, double>));
+        }
+    }
+
+    stats.metadata.count = document_data_.size();
+    add_container(stats.metadata, document_ids_);
+    add_container(stats.metadata, ordinal_to_document_);
+    add_container(stats.metadata, rating_to_ordinals_);
+    for (const auto& [rating, ordinals] : rating_to_ordinals_) {
+        ordinals.ForEachBuffer([&](size_t bytes) { add_block(stats.metadata, bytes); });
+    }
+
+    stats.stop_words.count = stop_words_.size();
+    add_container(stats.stop_words, stop_words_);
+    for (const string& word : stop_words_) {
+        add_block(stats.stop_words, GetHeapSize(word));
+    }
+
+    add_container(stats.typo_index, typo_deletes_);
+    for (const auto& [hash, words] : typo_deletes_) {
+        stats.typo_index.count += words.size();
+        add_block(stats.typo_index, words.capacity() * sizeof(string_view));
+    }
+
+    stats.documents.count = document_store_.GetDocumentCount();
+    document_store_.ForEachBuffer([&](size_t bytes) { add_block(stats.documents, bytes); });
+    return stats;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     if (!IsValidWord(text)) {
         throw invalid_argument("The word = "s + string(text) + " contains special symbol"s);
@@ -192,28 +682,156 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         }
     }
 
-    return { text, is_minus, IsStopWord(text) };
+    // word~ or word~N, without the typo index '~' is an ordinary character
+    bool is_fuzzy = false;
+    uint32_t typo_distance = 0;
+    const size_t tilde = text.rfind('~');
+    if (options_.max_typo_distance > 0 && tilde != string_view::npos && tilde > 0 &&
+        all_of(text.begin() + tilde + 1, text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        is_fuzzy = true;
+        if (tilde + 1 == text.size()) {
+            // Short words are within two edits of too many others to be useful
+            typo_distance = min<uint32_t>(options_.max_typo_distance, tilde < MIN_TWO_TYPOS_LENGTH ? 1 : 2);
+        }
+        else {
+            typo_distance = ParseQueryNumber(text.substr(tilde + 1), text);
+        }
+        if (typo_distance > options_.max_typo_distance) {
+            throw invalid_argument("The word = "s + string(text) + " exceeds the maximum typo distance"s);
+        }
+        text = text.substr(0, tilde);
+    }
+
+    // Without expansions '*' and '?' are ordinary characters
+    const bool is_pattern = options_.max_pattern_expansions > 0 && text.find_first_of("*?"sv) != string_view::npos;
+    return { text, is_minus, is_pattern, is_fuzzy, typo_distance };
+}
+
+pmr::vector<string_view> SearchServer::AnalyzeQueryWord(const QueryWord& word, pmr::memory_resource* arena) const {
+    pmr::vector<string_view> words(arena);
+    if (!analyzer_.IsEnabled()) {
+        words.push_back(word.data);
+        return words;
+    }
+    char* buffer = static_cast<char*>(arena->allocate(word.data.size(), 1));
+    if (word.is_pattern || word.is_fuzzy) {
+        const string_view analyzed = analyzer_.AnalyzeWord(word.data, buffer);
+        if (!analyzed.empty()) {
+            words.push_back(analyzed);
+        }
+    }
+    else {
+        analyzer_.Split(word.data, buffer, words);
+    }
+    return words;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const string_view& text, const bool all_words) const
+SearchServer::Query SearchServer::ParseQuery(const string_view& text, pmr::memory_resource* arena, const bool all_words) const
 {
-    Query query;
-    for (const string_view& word : SplitIntoWords(text)) {
-        QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop || all_words) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
+    PROFILE_SCOPE("ParseQuery");
+    Query query(arena);
+    const pmr::vector<string_view> words = SplitIntoWords(text, arena);
+    for (size_t i = 0; i < words.size(); ++i) {
+        // Without positions a quote is an ordinary character of the word, as before phrase queries
+        if (options_.store_positions && words[i][0] == '"') {
+            i = ParsePhrase(words, i, all_words, query) - 1;
+            continue;
+        }
+        const QueryWord query_word = ParseQueryWord(words[i]);
+        for (const string_view& analyzed_word : AnalyzeQueryWord(query_word, arena)) {
+            if (query_word.is_pattern) {
+                if (query_word.is_minus) {
+                    // Exclusion has to be complete, so minus patterns are never truncated
+                    for (const string_view& word : ExpandPattern(analyzed_word, word_to_document_freqs_.size(), true)) {
+                        query.minus_words.insert(word);
+                    }
+                }
+                else {
+                    query.patterns.insert(analyzed_word);
+                }
+            }
+            else if (query_word.is_fuzzy) {
+                if (query_word.is_minus) {
+                    // Like minus patterns, minus fuzzy words exclude every similar word
+                    for (const auto& [word, distance] : FindSimilarWords(analyzed_word, query_word.typo_distance, word_to_document_freqs_.size())) {
+                        query.minus_words.insert(word);
+                    }
+                }
+                else {
+                    query.fuzzy_words.push_back({ analyzed_word, query_word.typo_distance });
+                }
             }
-            else {
-                query.plus_words.insert(query_word.data);
+            else if (!IsStopWord(analyzed_word) || all_words) {
+                if (query_word.is_minus) {
+                    query.minus_words.insert(analyzed_word);
+                }
+                else {
+                    query.plus_words.insert(analyzed_word);
+                }
             }
         }
     }
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view& word) const {
-    return log(document_data_.size() * 1.0 / word_to_document_freqs_.at(word).size());
+size_t SearchServer::ParsePhrase(const pmr::vector<string_view>& words, size_t first, const bool all_words, Query& query) const {
+    Phrase phrase{ decltype(Phrase::words)(query.arena) };
+    uint32_t offset = 0;
+    bool is_closed = false;
+    size_t i = first;
+    for (; i < words.size() && !is_closed; ++i) {
+        string_view word = words[i];
+        if (i == first) {
+            word.remove_prefix(1);
+        }
+
+        const size_t quote = word.find('"');
+        if (quote != string_view::npos) {
+            const string_view suffix = word.substr(quote + 1);
+            if (!suffix.empty()) {
+                if (suffix.size() < 2 || suffix[0] != '~' ||
+                    !all_of(suffix.begin() + 1, suffix.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                    throw invalid_argument("Invalid phrase suffix "s + string(suffix));
+                }
+                phrase.slop = ParseQueryNumber(suffix.substr(1), words[i]);
+            }
+            word = word.substr(0, quote);
+            is_closed = true;
+        }
+        if (word.empty()) {
+            continue;
+        }
+
+        const QueryWord query_word = ParseQueryWord(word);
+        if (query_word.is_minus) {
+            throw invalid_argument("Phrase can't contain minus word "s + string(word));
+        }
+        if (query_word.is_pattern || query_word.is_fuzzy) {
+            throw invalid_argument("Phrase can't contain wildcard or fuzzy word "s + string(word));
+        }
+        for (const string_view& analyzed_word : AnalyzeQueryWord(query_word, query.arena)) {
+            const bool is_stop = IsStopWord(analyzed_word);
+            if (!is_stop) {
+                phrase.words.push_back({ analyzed_word, offset });
+            }
+            if (!is_stop || all_words) {
+                query.plus_words.insert(analyzed_word);
+            }
+            ++offset;
+        }
+    }
+
+    if (!is_closed) {
+        throw invalid_argument("Phrase is not terminated with a quote"s);
+    }
+    if (offset == 0) {
+        throw invalid_argument("Phrase is empty"s);
+    }
+    // A phrase of stop words only matches everything, like a query of stop words
+    if (!phrase.words.empty()) {
+        query.phrases.push_back(move(phrase));
+    }
+    return i;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -222,9 +840,9 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
         : 0;
 }
 
-vector<string_view> SearchServer::SplitIntoWords(string_view text) const
+pmr::vector<string_view> SearchServer::SplitIntoWords(string_view text, pmr::memory_resource* memory) const
 {
-    vector<string_view> words;
+    pmr::vector<string_view> words(memory);
     while (true) {
         size_t pos_begin = text.find_first_not_of(' ');
         size_t pos_end = min(text.find_first_of(' ', pos_begin + 1), text.size());
@@ -237,28 +855,439 @@ vector<string_view> SearchServer::SplitIntoWords(string_view text) const
     return words;
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const
+pmr::vector<string_view> SearchServer::SplitDocument(string_view text, vector<char>& analyzed_text) const
 {
-    std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWords(text)) {
+    if (analyzer_.IsEnabled()) {
+        pmr::vector<string_view> words;
+        analyzed_text.resize(text.size());
+        analyzer_.Split(text, analyzed_text.data(), words);
+        return words;
+    }
+    pmr::vector<string_view> words = SplitIntoWords(text);
+    for (const string_view& word : words) {
         if (!IsValidWord(word)) {
-            throw std::invalid_argument("The word = "s + string(word) + " contains special symbol"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+            throw invalid_argument("The word = "s + string(word) + " contains special symbol"s);
         }
     }
     return words;
 }
 
-bool SearchServer::HasMinusWord(const unordered_set<string_view>& minus_words, const int document_id) const {
+bool SearchServer::HasMinusWord(const pmr::unordered_set<string_view>& minus_words, const DocumentData& document) const {
     return find_if(minus_words.begin(), minus_words.end(),
-        [this, document_id](const string_view& word) {
+        [this, &document](const string_view& word) {
             return word_to_document_freqs_.count(word) &&
-                word_to_document_freqs_.at(word).count(document_id); })
+                word_to_document_freqs_.at(word).Contains(GetPartition(document), document.ordinal); })
         != minus_words.end();
 }
 
+SearchServer::CompiledFilter SearchServer::CompileDocumentFilter(const DocumentFilter& filter, pmr::memory_resource* memory) const {
+    CompiledFilter compiled(memory);
+    // Documents whose postings haven't been moved yet are in the partitions of other statuses
+    compiled.is_complete = !filter.HasStatusFilter()
+        || all_of(misplaced_counts_.begin(), misplaced_counts_.end(), [](size_t count) { return count == 0; });
+    if (!filter.HasRatingRange() && !filter.HasIds() && !filter.HasIdRange()) {
+        return compiled;
+    }
+
+    const size_t word_count = (ordinal_to_document_.size() + 63) / 64;
+    pmr::vector<uint64_t> bits(word_count, 0, memory);
+    // Every constraint sets the bits of its documents and is intersected with the previous ones
+    const auto intersect = [&compiled, &bits]() {
+        if (compiled.bits.empty()) {
+            compiled.bits.swap(bits);
+            bits.resize(compiled.bits.size(), 0);
+            // An empty result would mean no constraint
+            if (compiled.bits.empty()) {
+                compiled.bits.push_back(0);
+            }
+            return;
+        }
+        for (size_t i = 0; i < bits.size(); ++i) {
+            compiled.bits[i] &= bits[i];
+            bits[i] = 0;
+        }
+    };
+    const auto add = [&bits](uint32_t ordinal) {
+        bits[ordinal / 64] |= uint64_t(1) << (ordinal % 64);
+    };
+
+    if (filter.HasRatingRange()) {
+        for (auto it = rating_to_ordinals_.lower_bound(filter.GetMinRating());
+            it != rating_to_ordinals_.end() && it->first <= filter.GetMaxRating(); ++it) {
+            it->second.ForEachBlock([&bits](uint32_t first, uint64_t block) {
+                bits[first / 64] |= block;
+            });
+        }
+        intersect();
+    }
+    if (filter.HasIds()) {
+        for (int document_id : filter.GetIds()) {
+            const auto it = document_data_.find(document_id);
+            if (it != document_data_.end()) {
+                add(it->second.ordinal);
+            }
+        }
+        intersect();
+    }
+    if (filter.HasIdRange()) {
+        // A wide range rejects few documents, comparing the ids of the candidates is cheaper then
+        const size_t max_scanned = max<size_t>(document_data_.size() / MAX_COMPILED_ID_RANGE_SHARE, 64);
+        size_t scanned = 0;
+        auto it = document_data_.lower_bound(filter.GetFirstId());
+        for (; it != document_data_.end() && it->first <= filter.GetLastId() && scanned <= max_scanned; ++it, ++scanned) {
+            add(it->second.ordinal);
+        }
+        if (it == document_data_.end() || it->first > filter.GetLastId()) {
+            intersect();
+        }
+        else {
+            compiled.is_complete = false;
+        }
+    }
+    return compiled;
+}
+
+uint32_t SearchServer::GetPartitionMask(uint32_t status_mask) const {
+    uint32_t partition_mask = status_mask;
+    for (size_t partition = 0; partition < DOCUMENT_STATUS_COUNT; ++partition) {
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            if (((status_mask >> status) & 1) && misplaced_counts_[partition * DOCUMENT_STATUS_COUNT + status] > 0) {
+                partition_mask |= 1u << partition;
+            }
+        }
+    }
+    return partition_mask;
+}
+
+pmr::vector<DocumentStatus> SearchServer::GetStatuses(uint32_t status_mask, pmr::memory_resource* memory) {
+    pmr::vector<DocumentStatus> statuses(memory);
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        if ((status_mask >> status) & 1) {
+            statuses.push_back(static_cast<DocumentStatus>(status));
+        }
+    }
+    return statuses;
+}
+
+vector<uint32_t> SearchServer::MatchPostings(const vector<const PostingList*>& postings, size_t required_count) {
+    PROFILE_SCOPE("Intersect");
+    vector<uint32_t> candidates;
+    if (required_count == 0 || postings.size() < required_count) {
+        return candidates;
+    }
+
+    if (required_count == postings.size()) {
+        size_t next = 1;
+        const RoaringBitmap* first_bitmap = postings.front()->GetBitmap();
+        const RoaringBitmap* second_bitmap = postings.size() > 1 ? postings[1]->GetBitmap() : nullptr;
+        if (first_bitmap != nullptr && second_bitmap != nullptr) {
+            // Both rarest words are frequent, their bitmaps are intersected a word of 64 documents at a time
+            RoaringBitmap::And(*first_bitmap, *second_bitmap).AppendTo(candidates);
+            next = 2;
+        }
+        else {
+            candidates = postings.front()->GetDocuments();
+        }
+        vector<uint32_t> intersection;
+        for (size_t i = next; i < postings.size() && !candidates.empty(); ++i) {
+            if (postings[i]->GetBitmap() != nullptr) {
+                FilterPostings(candidates, *postings[i], true);
+                continue;
+            }
+            intersection.clear();
+            IntersectSorted(candidates, postings[i]->GetDocuments(), intersection);
+            swap(candidates, intersection);
+        }
+        return candidates;
+    }
+
+    // A document missing from all of the (size - required + 1) rarest lists can't contain
+    // enough words, so only their union has to be checked against the remaining lists
+    const size_t union_count = postings.size() - required_count + 1;
+    vector<uint32_t> all_documents;
+    for (size_t i = 0; i < union_count; ++i) {
+        const vector<uint32_t>& documents = postings[i]->GetDocuments();
+        all_documents.insert(all_documents.end(), documents.begin(), documents.end());
+    }
+    sort(all_documents.begin(), all_documents.end());
+
+    vector<pair<uint32_t, size_t>> counted;
+    for (uint32_t ordinal : all_documents) {
+        if (counted.empty() || counted.back().first != ordinal) {
+            counted.push_back({ ordinal, 0 });
+        }
+        ++counted.back().second;
+    }
+
+    for (size_t i = union_count; i < postings.size(); ++i) {
+        if (const RoaringBitmap* bitmap = postings[i]->GetBitmap()) {
+            for (auto& [ordinal, count] : counted) {
+                count += bitmap->Contains(ordinal);
+            }
+            continue;
+        }
+        const vector<uint32_t>& documents = postings[i]->GetDocuments();
+        size_t cursor = 0;
+        for (auto& [ordinal, count] : counted) {
+            cursor = GallopingLowerBound(documents.data(), cursor, documents.size(), ordinal);
+            if (cursor == documents.size()) {
+                break;
+            }
+            if (documents[cursor] == ordinal) {
+                ++count;
+            }
+        }
+    }
+
+    for (const auto& [ordinal, count] : counted) {
+        if (count >= required_count) {
+            candidates.push_back(ordinal);
+        }
+    }
+    return candidates;
+}
+
+void SearchServer::RemovePostings(vector<uint32_t>& documents, const PostingList& postings) {
+    if (postings.GetBitmap() != nullptr) {
+        FilterPostings(documents, postings, false);
+        return;
+    }
+    const vector<uint32_t>& excluded = postings.GetDocuments();
+    size_t cursor = 0;
+    size_t kept = 0;
+    for (uint32_t ordinal : documents) {
+        cursor = GallopingLowerBound(excluded.data(), cursor, excluded.size(), ordinal);
+        if (cursor == excluded.size() || excluded[cursor] != ordinal) {
+            documents[kept++] = ordinal;
+        }
+    }
+    documents.resize(kept);
+}
+
+void SearchServer::FilterPostings(vector<uint32_t>& documents, const PostingList& postings, bool keep_present) {
+    const RoaringBitmap& bitmap = *postings.GetBitmap();
+    documents.erase(remove_if(documents.begin(), documents.end(),
+        [&bitmap, keep_present](uint32_t ordinal) {
+            return bitmap.Contains(ordinal) != keep_present;
+        }), documents.end());
+}
+
+vector<string_view> SearchServer::ExpandPattern(string_view pattern, size_t limit, bool is_complete) const {
+    const string_view prefix = pattern.substr(0, pattern.find_first_of("*?"sv));
+    vector<string_view> words;
+    size_t scanned = 0;
+    for (auto it = word_to_document_freqs_.lower_bound(prefix);
+        it != word_to_document_freqs_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        if (scanned++ == options_.max_pattern_scan) {
+            if (is_complete) {
+                throw invalid_argument("The pattern = "s + string(pattern) + " matches too many words"s);
+            }
+            break;
+        }
+        if (!it->second.empty() && MatchesPattern(it->first, pattern)) {
+            words.push_back(it->first);
+        }
+    }
+
+    if (words.size() > limit) {
+        // The most frequent words are the most likely completions
+        nth_element(words.begin(), words.begin() + limit, words.end(),
+            [this](const string_view& lhs, const string_view& rhs) {
+                return word_to_document_freqs_.at(lhs).size() > word_to_document_freqs_.at(rhs).size();
+            });
+        words.resize(limit);
+        sort(words.begin(), words.end());
+    }
+    return words;
+}
+
+vector<pair<string_view, uint32_t>> SearchServer::FindSimilarWords(string_view word, uint32_t max_distance, size_t limit) const {
+    // A word within the distance shares at least one delete variant with the query word
+    unordered_set<string_view> candidates;
+    for (const string& variant : GenerateDeletes(word, max_distance)) {
+        const auto it = typo_deletes_.find(hash<string_view>()(variant));
+        if (it != typo_deletes_.end()) {
+            candidates.insert(it->second.begin(), it->second.end());
+        }
+    }
+
+    vector<pair<string_view, uint32_t>> words;
+    for (const string_view& candidate : candidates) {
+        const auto it = word_to_document_freqs_.find(candidate);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            continue;
+        }
+        const uint32_t distance = ComputeEditDistance(word, candidate, max_distance);
+        if (distance <= max_distance) {
+            words.push_back({ it->first, distance });
+        }
+    }
+
+    sort(words.begin(), words.end(),
+        [this](const auto& lhs, const auto& rhs) {
+            if (lhs.second != rhs.second) {
+                return lhs.second < rhs.second;
+            }
+            return word_to_document_freqs_.at(lhs.first).size() > word_to_document_freqs_.at(rhs.first).size();
+        });
+    if (words.size() > limit) {
+        words.resize(limit);
+    }
+    return words;
+}
+
+void SearchServer::IndexTypoDeletes(string_view word) {
+    for (const string& variant : GenerateDeletes(word, options_.max_typo_distance)) {
+        typo_deletes_[hash<string_view>()(variant)].push_back(word);
+    }
+}
+
+void SearchServer::MatchExpandedWords(const Query& query, const DocumentData& document, vector<string_view>& words) const {
+    for (const string_view& pattern : query.patterns) {
+        for (const string_view& word : ExpandPattern(pattern, options_.max_pattern_expansions)) {
+            if (word_to_document_freqs_.at(word).Contains(GetPartition(document), document.ordinal)) {
+                words.push_back(word);
+            }
+        }
+    }
+    for (const auto& [fuzzy_word, max_distance] : query.fuzzy_words) {
+        for (const auto& [word, distance] : FindSimilarWords(fuzzy_word, max_distance, options_.max_pattern_expansions)) {
+            if (word_to_document_freqs_.at(word).Contains(GetPartition(document), document.ordinal)) {
+                words.push_back(word);
+            }
+        }
+    }
+}
+
+vector<string> SearchServer::GenerateDeletes(string_view word, uint32_t max_distance) {
+    vector<string> variants = { string(word) };
+    size_t level_begin = 0;
+    for (uint32_t distance = 0; distance < max_distance; ++distance) {
+        const size_t level_end = variants.size();
+        for (size_t i = level_begin; i < level_end; ++i) {
+            for (size_t position = 0; position < variants[i].size(); ++position) {
+                string variant = variants[i];
+                variant.erase(position, 1);
+                variants.push_back(move(variant));
+            }
+        }
+        level_begin = level_end;
+    }
+    sort(variants.begin(), variants.end());
+    variants.erase(unique(variants.begin(), variants.end()), variants.end());
+    return variants;
+}
+
+uint32_t SearchServer::ComputeEditDistance(string_view lhs, string_view rhs, uint32_t max_distance) {
+    const size_t length_difference = lhs.size() > rhs.size() ? lhs.size() - rhs.size() : rhs.size() - lhs.size();
+    if (length_difference > max_distance) {
+        return max_distance + 1;
+    }
+
+    vector<uint32_t> previous(rhs.size() + 1);
+    vector<uint32_t> current(rhs.size() + 1);
+    iota(previous.begin(), previous.end(), 0);
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        current[0] = static_cast<uint32_t>(i);
+        uint32_t row_min = current[0];
+        for (size_t j = 1; j <= rhs.size(); ++j) {
+            const uint32_t substitution = previous[j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1);
+            current[j] = min({ previous[j] + 1, current[j - 1] + 1, substitution });
+            row_min = min(row_min, current[j]);
+        }
+        // Distances never decrease along the rows
+        if (row_min > max_distance) {
+            return max_distance + 1;
+        }
+        swap(previous, current);
+    }
+    return min(previous[rhs.size()], max_distance + 1);
+}
+
+vector<uint32_t> SearchServer::MatchPhrases(const pmr::vector<Phrase>& phrases, DocumentStatus status) const {
+    vector<uint32_t> candidates = MatchPhrase(phrases.front(), status);
+    vector<uint32_t> intersection;
+    for (size_t i = 1; i < phrases.size() && !candidates.empty(); ++i) {
+        intersection.clear();
+        IntersectSorted(candidates, MatchPhrase(phrases[i], status), intersection);
+        swap(candidates, intersection);
+    }
+    return candidates;
+}
+
+vector<uint32_t> SearchServer::MatchPhrase(const Phrase& phrase, DocumentStatus status) const {
+    PROFILE_SCOPE("MatchPhrase");
+    vector<const PostingList*> postings;
+    for (const auto& [word, offset] : phrase.words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.GetPartition(status).empty()) {
+            return {};
+        }
+        postings.push_back(&it->second.GetPartition(status));
+    }
+
+    vector<uint32_t> candidates = MatchPostings(postings, postings.size());
+    vector<vector<int64_t>> shifted(postings.size());
+    vector<size_t> cursors(postings.size());
+    size_t kept = 0;
+    for (uint32_t ordinal : candidates) {
+        // Shifting by the offset in the phrase turns an exact match into equal positions
+        for (size_t i = 0; i < postings.size(); ++i) {
+            const vector<uint32_t>& documents = postings[i]->GetDocuments();
+            const size_t index = static_cast<size_t>(lower_bound(documents.begin(), documents.end(), ordinal) - documents.begin());
+            shifted[i].clear();
+            for (uint32_t position : postings[i]->GetPositions(index)) {
+                shifted[i].push_back(static_cast<int64_t>(position) - phrase.words[i].second);
+            }
+            cursors[i] = 0;
+        }
+
+        // Smallest window holding one shifted position of every word
+        bool is_matched = false;
+        bool has_positions = all_of(shifted.begin(), shifted.end(), [](const vector<int64_t>& positions) { return !positions.empty(); });
+        while (has_positions) {
+            size_t min_list = 0;
+            int64_t min_value = shifted[0][cursors[0]];
+            int64_t max_value = min_value;
+            for (size_t i = 1; i < shifted.size(); ++i) {
+                const int64_t value = shifted[i][cursors[i]];
+                if (value < min_value) {
+                    min_value = value;
+                    min_list = i;
+                }
+                max_value = max(max_value, value);
+            }
+            if (max_value - min_value <= phrase.slop) {
+                is_matched = true;
+                break;
+            }
+            has_positions = ++cursors[min_list] < shifted[min_list].size();
+        }
+        if (is_matched) {
+            candidates[kept++] = ordinal;
+        }
+    }
+    candidates.resize(kept);
+    return candidates;
+}
+
+#ifdef SEARCH_SERVER_VERIFY_SCORES
+void SearchServer::VerifyScores(pmr::vector<Document> documents, pmr::vector<Document> reference) {
+    const auto by_id = [](const Document& lhs, const Document& rhs) { return lhs.id < rhs.id; };
+    sort(documents.begin(), documents.end(), by_id);
+    sort(reference.begin(), reference.end(), by_id);
+    if (documents.size() != reference.size()) {
+        throw logic_error("Scoring kernel matched "s + to_string(documents.size()) + " documents instead of "s + to_string(reference.size()));
+    }
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (documents[i].id != reference[i].id ||
+            abs(documents[i].relevance - reference[i].relevance) > 1e-9 * max(1.0, abs(reference[i].relevance))) {
+            throw logic_error("Scoring kernel relevance of document "s + to_string(reference[i].id) + " differs from the reference"s);
+        }
+    }
+}
+#endif
+
 bool SearchServer::IsStopWord(const std::string_view& word) const {
     return stop_words_.count(word) > 0;
 }
@@ -2,30 +2,139 @@
 
 #include "concurrent_map.h"
 #include "document.h"
-#include "log_duration.h"
+#include "document_filter.h"
+#include "document_store.h"
+#include "memory_stats.h"
+#include "partitioned_posting_list.h"
+#include "posting_list.h"
+#include "profiler.h"
+#include "query_arena.h"
+#include "roaring_bitmap.h"
+#include "scorer.h"
+#include "scoring_kernels.h"
+#include "text_analyzer.h"
 
 #include <algorithm>
+#include <array>
 #include <execution>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <memory_resource>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+// How many distinct plus words of a query a document must contain to be found
+class MatchMode {
+public:
+    static MatchMode Any() {
+        return MatchMode(1);
+    }
+
+    static MatchMode All() {
+        return MatchMode(0);
+    }
+
+    static MatchMode AtLeast(size_t plus_word_count) {
+        return MatchMode(std::max<size_t>(plus_word_count, 1));
+    }
+
+    size_t GetRequiredCount(size_t plus_word_count) const {
+        return (minimum_should_match_ == 0) ? plus_word_count : std::min(minimum_should_match_, plus_word_count);
+    }
+
+private:
+    explicit MatchMode(size_t minimum_should_match)
+        : minimum_should_match_(minimum_should_match) {
+    }
+
+    // 0 means all plus words
+    size_t minimum_should_match_;
+};
+
+struct IndexOptions {
+    // Keeps word positions for phrase and proximity queries
+    bool store_positions = false;
+    // Prefix and wildcard words of a query are expanded into at most this many
+    // of the most frequent matching words. 0 disables the patterns, then '*' and '?'
+    // are ordinary characters of a query word.
+    size_t max_pattern_expansions = 1024;
+    // A pattern is checked against at most this many dictionary words from its literal
+    // prefix, so a pattern starting with a wildcard doesn't scan the whole dictionary.
+    // A minus pattern needing more throws invalid_argument, its exclusion has to be complete.
+    size_t max_pattern_scan = 1 << 16;
+    // Largest edit distance of fuzzy query words (word~ or word~2), 0 disables
+    // the symmetric delete index they are looked up in
+    uint32_t max_typo_distance = 0;
+    // Keeps the texts of the documents in a compressed DocumentStore for GetDocumentText
+    bool store_documents = false;
+    // Raw size of the compressed blocks of the store, larger blocks compress better
+    // but make reading a text slower
+    size_t document_block_size = DocumentStore::DEFAULT_BLOCK_SIZE;
+    // Case folding, punctuation splitting and normalization of the words of documents,
+    // queries and stop words, by default they are split on spaces only
+    AnalyzerOptions analyzer = {};
+    // A status change only flips the status of the document, its postings are moved to the
+    // partition of the new status in one batch with the other changed documents once there
+    // are more than this many. Until then searches by status also scan the partitions the
+    // changed documents are still in. 0 moves the postings at once.
+    size_t max_pending_status_moves = 1024;
+};
+
+// Statistics of a larger index the server is a part of, see ShardedSearchServer
+struct IndexStatistics {
+    ScoringContext context;
+    // Number of documents of the whole index containing the word
+    std::function<size_t(std::string_view)> document_freq;
+};
+
+// Document of the bulk SearchServer::AddDocuments, the text has to live only during the call
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 class SearchServer {
 public:
+    using DocumentIdSet = std::set<int, std::less<int>, CountingAllocator<int>>;
+
     inline static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+    // Weight of a fuzzy match is multiplied by this for every edit
+    inline static constexpr double TYPO_WEIGHT = 0.5;
+    // Queries of at most this many plain words try the impact lists before scanning the postings
+    inline static constexpr size_t MAX_IMPACT_QUERY_WORDS = 2;
+    // A DocumentFilter id range is compiled into bits if it holds at most 1 / MAX_COMPILED_ID_RANGE_SHARE
+    // of the documents, a wider one is left to the predicate
+    inline static constexpr size_t MAX_COMPILED_ID_RANGE_SHARE = 16;
 
     SearchServer() = default;
+    explicit SearchServer(const IndexOptions& options);
 
     template<typename StopWordsCollection>
-    explicit SearchServer(const StopWordsCollection& stop_words);
-    explicit SearchServer(const std::string& stop_words);
-    explicit SearchServer(const std::string_view& stop_words);
+    explicit SearchServer(const StopWordsCollection& stop_words, const IndexOptions& options = IndexOptions());
+    explicit SearchServer(const std::string& stop_words, const IndexOptions& options = IndexOptions());
+    explicit SearchServer(const std::string_view& stop_words, const IndexOptions& options = IndexOptions());
 
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    // Takes the text for the document store instead of copying it, lvalue strings go to the overload above
+    template<typename Text, std::enable_if_t<std::is_same_v<Text, std::string>, int> = 0>
+    void AddDocument(int document_id, Text&& document, DocumentStatus status, const std::vector<int>& ratings) {
+        AddOwnedDocument(document_id, std::move(document), status, ratings);
+    }
+    // Replaces the document with the same id or adds a new one. The new text is compared with
+    // the indexed words of the old one, so only the postings of the words whose frequency or
+    // positions changed are modified.
+    void UpsertDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    // Same as AddDocument for every document in order, but the texts are split into words in parallel.
+    // Throws before anything is added if any of the documents is invalid.
+    void AddDocuments(const std::vector<NewDocument>& documents);
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, const std::string_view& raw_query, int document_id) const;
@@ -36,6 +145,31 @@ public:
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
 
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode, const DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode) const;
+
+    // Ranks documents with the scorer policy (TfIdfScorer, Bm25Scorer or a custom one, see scorer.h)
+    // instead of the default TF-IDF
+    template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentStatus status) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode) const;
+    template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const DocumentPredicate& predicate) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const DocumentStatus status) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query) const;
+    // Ranks with the statistics of the whole index instead of the ones of this server,
+    // so a shard scores its documents like a server holding all of them would
+    template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode,
+                                           const DocumentPredicate& predicate, const IndexStatistics& statistics) const;
+
     template<typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, const std::string_view& raw_query, const DocumentPredicate& predicate) const;
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, const std::string_view& raw_query, const DocumentStatus status) const;
@@ -46,88 +180,341 @@ public:
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, const std::string_view& raw_query, const DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, const std::string_view& raw_query) const;
 
+    template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query, const DocumentPredicate& predicate) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query, const DocumentStatus status) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query) const;
+
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
+    // Change the metadata of an indexed document without splitting its text again. A status
+    // change is seen by searches at once, the postings of the document's words follow it to
+    // the partition of the new status in a batch (see IndexOptions::max_pending_status_moves),
+    // ratings only replace the average. Throw out_of_range if there is no such document.
+    // Like the other modifications they must not run concurrently with searches or each
+    // other, callers sharing a server lock it (ShardedSearchServer, DurableSearchServer do).
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+    void UpdateDocumentRatings(int document_id, const std::vector<int>& ratings);
+
     int GetDocumentCount() const;
+    bool HasDocument(int document_id) const;
+    // Throws invalid_argument if AddDocument would reject the text, doesn't change the index
+    void CheckDocumentText(std::string_view document) const;
+    ScoringContext GetScoringContext() const;
+    // Number of documents containing the word
+    size_t GetDocumentFreq(std::string_view word) const;
+    // Words of the query a search weighs: the plus and phrase words and the expansions of the
+    // patterns and fuzzy words in this index. Words missing from the index are skipped, the views
+    // point into the dictionary.
+    std::vector<std::string_view> GetQueryWords(const std::string_view& raw_query) const;
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Text of the document, requires IndexOptions::store_documents. Throws out_of_range
+    // if there is no such document.
+    std::string GetDocumentText(int document_id) const;
     std::string GetStopWords() const;
+    // Heap memory of the index by structure
+    MemoryStats GetMemoryStats() const;
 
-    const std::set<int>::const_iterator begin() const {
+    const DocumentIdSet::const_iterator begin() const {
         return document_ids_.begin();
     }
 
-    const std::set<int>::const_iterator end() const {
+    const DocumentIdSet::const_iterator end() const {
         return document_ids_.end();
     }
 
 private:
+    using StopWordSet = std::set<std::string, std::less<>, CountingAllocator<std::string>>;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
-        bool is_stop;
+        // Contains '*' (any sequence) or '?' (any character)
+        bool is_pattern;
+        bool is_fuzzy;
+        uint32_t typo_distance;
+    };
+
+    // Quoted words that must appear in this order, "red cat"~3 allows
+    // up to slop extra moves of the words between each other
+    struct Phrase {
+        // Word and its offset in the phrase, stop words only shift the offsets
+        std::pmr::vector<std::pair<std::string_view, uint32_t>> words;
+        uint32_t slop = 0;
     };
 
+    // The query and the temporaries of its search are allocated from the arena
     struct Query {
-        std::unordered_set<std::string_view> plus_words;
-        std::unordered_set<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* memory)
+            : plus_words(memory), minus_words(memory), phrases(memory), patterns(memory), fuzzy_words(memory), arena(memory) {
+        }
+
+        std::pmr::unordered_set<std::string_view> plus_words;
+        std::pmr::unordered_set<std::string_view> minus_words;
+        std::pmr::vector<Phrase> phrases;
+        // Plus words with wildcards, minus ones are expanded into minus_words
+        std::pmr::unordered_set<std::string_view> patterns;
+        // Plus words with the allowed edit distance
+        std::pmr::vector<std::pair<std::string_view, uint32_t>> fuzzy_words;
+        // Document frequencies of the whole index if the server is a part of it
+        const std::function<size_t(std::string_view)>* document_freq = nullptr;
+        std::pmr::memory_resource* arena;
+    };
+
+    struct DocumentEntry {
+        int id;
+        // Status whose partitions hold the postings, differs from status until they are moved
+        DocumentStatus partition;
+        // nullptr after the document has been removed
+        const DocumentData* data;
+        // Copies of the data fields the filters read, so they don't chase the pointer
+        DocumentStatus status;
+        int rating;
+    };
+
+    // Words of a document before it is indexed, the views point into its text or into
+    // the analyzed text. The vector keeps its buffer when the document is moved.
+    struct ParsedDocument {
+        std::vector<char> analyzed_text;
+        std::map<std::string_view, double> word_frequency;
+        std::map<std::string_view, std::vector<uint32_t>> word_positions;
+        uint32_t word_count = 0;
+    };
+
+    struct WordPostings {
+        const PostingList* postings;
+        double weight;
+        // Merged lists of patterns and fuzzy words hold ready scores instead of term frequencies
+        bool is_scored;
+        // Partition of the word the list belongs to
+        DocumentStatus status;
+    };
+
+    // Rating and id constraints of a DocumentFilter as a bit per ordinal
+    struct CompiledFilter {
+        explicit CompiledFilter(std::pmr::memory_resource* memory)
+            : bits(memory) {
+        }
+
+        bool Contains(uint32_t ordinal) const {
+            return bits.empty() || (ordinal / 64 < bits.size() && ((bits[ordinal / 64] >> (ordinal % 64)) & 1));
+        }
+
+        // Empty if no constraint is compiled
+        std::pmr::vector<uint64_t> bits;
+        // The bits and the scanned partitions apply the whole predicate, so it isn't called
+        bool is_complete = false;
     };
 
 private:
+    template<typename Ranker, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const;
+    // Scores every posting with the ranker into a map, used for the rankers the scoring kernels can't run
+    template<typename Ranker, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocumentsByMap(const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const;
+    template<typename Ranker, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const;
+    template<typename Ranker, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const;
+    template<typename Ranker, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const Ranker& ranker, const Query& query, const MatchMode& mode, const DocumentPredicate& predicate) const;
+    // Candidates of a query of a few plain words from the impact lists of their postings, which
+    // include the best documents. Returns false if the candidates can't prove that, e.g. when the
+    // predicate rejects most of them, and then the postings have to be scanned.
+    template<typename Ranker, typename DocumentPredicate>
+    bool FindImpactDocuments(const Ranker& ranker, const Query& query, const MatchMode& mode, const DocumentPredicate& predicate,
+                             std::pmr::vector<Document>& matched_documents) const;
+    // Conjunctive search among the documents of one status, postings are the lists of its partition
+    template<typename Ranker, typename DocumentPredicate>
+    void FindPartitionDocuments(const Ranker& ranker, const Query& query, size_t required_count, DocumentStatus status,
+                                std::pmr::vector<WordPostings>& postings, const DocumentPredicate& predicate,
+                                const CompiledFilter& filter, std::pmr::vector<Document>& matched_documents) const;
+
+    // Documents containing at least required_count of the posting lists sorted by ascending size
+    static std::vector<uint32_t> MatchPostings(const std::vector<const PostingList*>& postings, size_t required_count);
+    static void RemovePostings(std::vector<uint32_t>& documents, const PostingList& postings);
+    // Keeps the documents present in (or absent from) a list with a bitmap
+    static void FilterPostings(std::vector<uint32_t>& documents, const PostingList& postings, bool keep_present);
+#ifdef SEARCH_SERVER_VERIFY_SCORES
+    // Throws logic_error if the vectorized scores differ from the reference ones
+    static void VerifyScores(std::pmr::vector<Document> documents, std::pmr::vector<Document> reference);
+#endif
+    // Lists of the plus words and expanded patterns and fuzzy words of the query in the partitions
+    // of the statuses set in partition_mask. The conjunctive search needs the expansions merged into
+    // one list per pattern and partition, the disjunctive one doesn't.
+    template<typename Ranker>
+    std::pmr::vector<WordPostings> CollectPostings(const Ranker& ranker, const Query& query, bool merge_expansions,
+                                                   uint32_t partition_mask, std::pmr::vector<PostingList>& pattern_postings) const;
+    // Statuses the predicate can accept as a mask of 1 << status bits
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, const DocumentPredicate& predicate) const;
+    static uint32_t GetStatusMask(const DocumentPredicate& predicate);
+    // Partitions holding the documents of the statuses, wider than the statuses while moves are pending
+    uint32_t GetPartitionMask(uint32_t status_mask) const;
+    static std::pmr::vector<DocumentStatus> GetStatuses(uint32_t status_mask, std::pmr::memory_resource* memory);
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentPredicate& predicate) const;
+    CompiledFilter CompileFilter(const DocumentPredicate& predicate, std::pmr::memory_resource* memory) const;
+    CompiledFilter CompileDocumentFilter(const DocumentFilter& filter, std::pmr::memory_resource* memory) const;
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, const DocumentPredicate& predicate) const;
+    bool IsAccepted(const CompiledFilter& filter, const DocumentPredicate& predicate, uint32_t ordinal) const;
+    // Indexed words matching the pattern, scanned as a range of the sorted dictionary from its literal prefix.
+    // Throws invalid_argument if the range is longer than max_pattern_scan and the expansion has to be complete.
+    std::vector<std::string_view> ExpandPattern(std::string_view pattern, size_t limit, bool is_complete = false) const;
+    // At most limit indexed words within the edit distance with their distances, closest first
+    std::vector<std::pair<std::string_view, uint32_t>> FindSimilarWords(std::string_view word, uint32_t max_distance, size_t limit) const;
+    void IndexTypoDeletes(std::string_view word);
+    void RemoveRatingOrdinal(int rating, uint32_t ordinal);
+    // Removed documents keep their ordinals until the table is compacted
+    void CompactOrdinalsIfSparse();
+    void CompactOrdinals();
+    DocumentStatus GetPartition(const DocumentData& document) const;
+    size_t& MisplacedCount(DocumentStatus partition, DocumentStatus status);
+    // Moves the postings of the documents whose status has changed to the partitions of their statuses
+    void ApplyStatusMoves();
+    // Appends words of the expanded patterns and fuzzy words contained in the document
+    void MatchExpandedWords(const Query& query, const DocumentData& document, std::vector<std::string_view>& words) const;
+    // Sorted documents of the status containing every phrase of the query
+    std::vector<uint32_t> MatchPhrases(const std::pmr::vector<Phrase>& phrases, DocumentStatus status) const;
+    std::vector<uint32_t> MatchPhrase(const Phrase& phrase, DocumentStatus status) const;
+
+    void CheckNewDocumentId(int document_id) const;
+    void AddOwnedDocument(int document_id, std::string document, DocumentStatus status, const std::vector<int>& ratings);
+    // Doesn't modify the server, so documents can be parsed concurrently
+    ParsedDocument ParseDocument(std::string_view document) const;
+    void AddParsedDocument(int document_id, const ParsedDocument& document, DocumentStatus status, const std::vector<int>& ratings);
 
     QueryWord ParseQueryWord(std::string_view text) const;
-    Query ParseQuery(const std::string_view& text, const bool all_words = false) const;
+    // Words of the query word after the analyzer, allocated from the arena. Patterns and fuzzy
+    // words stay one word, so their syntax survives punctuation splitting.
+    std::pmr::vector<std::string_view> AnalyzeQueryWord(const QueryWord& word, std::pmr::memory_resource* arena) const;
+    Query ParseQuery(const std::string_view& text, std::pmr::memory_resource* arena, const bool all_words = false) const;
+    // Parses the words starting at words[first] which opens a phrase, returns the index after the phrase
+    size_t ParsePhrase(const std::pmr::vector<std::string_view>& words, size_t first, const bool all_words, Query& query) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-    std::vector<std::string_view> SplitIntoWords(std::string_view text) const;
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
+    // The word itself and all its variants with up to max_distance characters deleted
+    static std::vector<std::string> GenerateDeletes(std::string_view word, uint32_t max_distance);
+    // Returns max_distance + 1 if the distance exceeds max_distance
+    static uint32_t ComputeEditDistance(std::string_view lhs, std::string_view rhs, uint32_t max_distance);
+
+    std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text,
+                                                      std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const;
+    // All words of the document including the stop words, analyzed words are written to analyzed_text.
+    // Throws invalid_argument for a word with special characters.
+    std::pmr::vector<std::string_view> SplitDocument(std::string_view text, std::vector<char>& analyzed_text) const;
 
     template<typename StringCollection>
-    std::set<std::string, std::less<>> MakeUniqueNonEmptyStringCollection(const StringCollection& collection) const;
+    StopWordSet MakeUniqueNonEmptyStringCollection(const StringCollection& collection) const;
 
-    bool HasMinusWord(const std::unordered_set<std::string_view>& minus_words, const int document_id) const;
+    bool HasMinusWord(const std::pmr::unordered_set<std::string_view>& minus_words, const DocumentData& document) const;
     bool IsStopWord(const std::string_view& word) const;
     static bool IsValidWord(const std::string_view& word);
     static bool IsValidMinusWord(const std::string_view& word);
 
 private:
-    std::unordered_set<std::string> words_to_documents_;
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> document_data_;
-    std::set<int> document_ids_;
+    IndexOptions options_;
+    TextAnalyzer analyzer_;
+    // The containers count their memory for GetMemoryStats
+    std::unordered_set<std::string, std::hash<std::string>, std::equal_to<std::string>, CountingAllocator<std::string>> words_to_documents_;
+    StopWordSet stop_words_;
+    std::map<std::string_view, PartitionedPostingList, std::less<std::string_view>,
+             CountingAllocator<std::pair<const std::string_view, PartitionedPostingList>>> word_to_document_freqs_;
+    std::map<int, DocumentData, std::less<int>, CountingAllocator<std::pair<const int, DocumentData>>> document_data_;
+    DocumentIdSet document_ids_;
+    std::vector<DocumentEntry, CountingAllocator<DocumentEntry>> ordinal_to_document_;
+    // Entries of ordinal_to_document_ of removed documents
+    size_t removed_ordinal_count_ = 0;
+    // Ordinals of the documents whose postings may be in the partition of another status,
+    // and the number of such documents by partition * DOCUMENT_STATUS_COUNT + status
+    std::vector<uint32_t> pending_status_moves_;
+    std::array<size_t, DOCUMENT_STATUS_COUNT * DOCUMENT_STATUS_COUNT> misplaced_counts_ = {};
+    // Ordinals of the indexed documents by their rating, for the rating ranges of DocumentFilter
+    std::map<int, RoaringBitmap, std::less<int>, CountingAllocator<std::pair<const int, RoaringBitmap>>> rating_to_ordinals_;
+    // Non stop words of all indexed documents, for the average document length
+    uint64_t total_word_count_ = 0;
+    // Hash of a word with up to max_typo_distance deleted characters -> words producing it,
+    // collisions are harmless since candidates are verified by edit distance
+    std::unordered_map<size_t, std::vector<std::string_view>, std::hash<size_t>, std::equal_to<size_t>,
+                       CountingAllocator<std::pair<const size_t, std::vector<std::string_view>>>> typo_deletes_;
+    // Empty unless options_.store_documents
+    DocumentStore document_store_;
 };
 
 template<typename StopWordsCollection>
-SearchServer::SearchServer(const StopWordsCollection& stop_words) :
-    stop_words_(MakeUniqueNonEmptyStringCollection(stop_words)) {
+SearchServer::SearchServer(const StopWordsCollection& stop_words, const IndexOptions& options) :
+    options_(options),
+    analyzer_(options.analyzer),
+    stop_words_(MakeUniqueNonEmptyStringCollection(stop_words)),
+    document_store_(options.document_block_size) {
 }
 
 template<typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, const DocumentPredicate& predicate) const {
-    Query query = ParseQuery(raw_query);
+    return FindTopDocuments(TfIdfScorer(), raw_query, MatchMode::Any(), predicate);
+}
+
+template<typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, mode, predicate);
+}
+
+template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const {
+    return FindTopDocuments(scorer, raw_query, mode, predicate, IndexStatistics{ GetScoringContext(), nullptr });
+}
 
-    std::vector<Document> result = FindAllDocuments(query, predicate);
+template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode,
+                                                     const DocumentPredicate& predicate, const IndexStatistics& statistics) const {
+    PROFILE_SCOPE("FindTopDocuments");
+    const QueryArena::Scope arena;
+    Query query = ParseQuery(raw_query, arena.GetResource());
+    if (statistics.document_freq) {
+        query.document_freq = &statistics.document_freq;
+    }
+
+    const auto ranker = scorer.Prepare(statistics.context);
+    std::pmr::vector<Document> result(query.arena);
+    if (!FindImpactDocuments(ranker, query, mode, predicate, result)) {
+        result = FindAllDocuments(ranker, query, mode, predicate);
+    }
 
+    PROFILE_SCOPE("SortTopK");
     std::sort(result.begin(), result.end(),
         [](const Document& lhs, const Document& rhs) {
             return Document::CompareRelevance(lhs, rhs);
         });
+    // Only the returned documents leave the arena
+    return std::vector<Document>(result.begin(), result.begin() + std::min(result.size(), MAX_RESULT_DOCUMENT_COUNT));
+}
 
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return result;
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentStatus status) const {
+    return FindTopDocuments(scorer, raw_query, mode, DocumentFilter().SetStatus(status));
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode) const {
+    return FindTopDocuments(scorer, raw_query, mode, DocumentStatus::ACTUAL);
+}
+
+template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const DocumentPredicate& predicate) const {
+    return FindTopDocuments(scorer, raw_query, MatchMode::Any(), predicate);
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const DocumentStatus status) const {
+    return FindTopDocuments(scorer, raw_query, MatchMode::Any(), status);
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query) const {
+    return FindTopDocuments(scorer, raw_query, MatchMode::Any(), DocumentStatus::ACTUAL);
 }
 
 template<typename DocumentPredicate>
@@ -137,49 +524,339 @@ inline std::vector<Document> SearchServer::FindTopDocuments(const std::execution
 
 template<typename DocumentPredicate>
 inline std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, const std::string_view& raw_query, const DocumentPredicate& predicate) const {
-    Query query = ParseQuery(raw_query);
+    return FindTopDocuments(std::execution::par, TfIdfScorer(), raw_query, predicate);
+}
+
+template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query, const DocumentPredicate& predicate) const {
+    PROFILE_SCOPE("FindTopDocumentsPar");
+    const QueryArena::Scope arena;
+    Query query = ParseQuery(raw_query, arena.GetResource());
+    const auto ranker = scorer.Prepare(GetScoringContext());
 
-    std::vector<Document> result = FindAllDocuments(std::execution::par, query, predicate);
+    // Phrases are verified by the sequential conjunctive path
+    std::pmr::vector<Document> result = query.phrases.empty()
+        ? FindAllDocuments(std::execution::par, ranker, query, predicate)
+        : FindAllDocuments(ranker, query, MatchMode::Any(), predicate);
 
+    PROFILE_SCOPE("SortTopK");
     std::sort(std::execution::par, result.begin(), result.end(),
         [](const Document& lhs, const Document& rhs) {
             return Document::CompareRelevance(lhs, rhs);
         });
+    return std::vector<Document>(result.begin(), result.begin() + std::min(result.size(), MAX_RESULT_DOCUMENT_COUNT));
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query, const DocumentStatus status) const {
+    return FindTopDocuments(std::execution::par, scorer, raw_query, DocumentFilter().SetStatus(status));
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, const Scorer& scorer, const std::string_view& raw_query) const {
+    return FindTopDocuments(std::execution::par, scorer, raw_query, DocumentStatus::ACTUAL);
+}
 
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+template<typename DocumentPredicate>
+SearchServer::CompiledFilter SearchServer::CompileFilter(const DocumentPredicate& predicate, std::pmr::memory_resource* memory) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>) {
+        return CompileDocumentFilter(predicate, memory);
+    }
+    else {
+        (void)predicate;
+        return CompiledFilter(memory);
     }
+}
 
-    return result;
+template<typename DocumentPredicate>
+bool SearchServer::IsAccepted(const CompiledFilter& filter, const DocumentPredicate& predicate, uint32_t ordinal) const {
+    if (!filter.Contains(ordinal)) {
+        return false;
+    }
+    const DocumentEntry& document = ordinal_to_document_[ordinal];
+    return filter.is_complete || predicate(document.id, document.status, document.rating);
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, const DocumentPredicate& predicate) const {
-    std::map<int, double> document_to_relevance;
+uint32_t SearchServer::GetStatusMask(const DocumentPredicate& predicate) {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>) {
+        return predicate.GetStatusMask();
+    }
+    else {
+        (void)predicate;
+        return DocumentFilter::ALL_STATUSES;
+    }
+}
+
+template<typename Ranker>
+std::pmr::vector<SearchServer::WordPostings> SearchServer::CollectPostings(const Ranker& ranker, const Query& query, bool merge_expansions,
+                                                                           uint32_t partition_mask, std::pmr::vector<PostingList>& pattern_postings) const {
+    const std::pmr::vector<DocumentStatus> statuses = GetStatuses(partition_mask, query.arena);
+    const auto document_freq = [&query](std::string_view word, const PartitionedPostingList& word_postings) {
+        return query.document_freq ? (*query.document_freq)(word) : word_postings.size();
+    };
+
+    std::pmr::vector<WordPostings> postings(query.arena);
     for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0 ||
-            word_to_document_freqs_.at(word).size() == 0) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = document_data_.at(document_id);
-            if (predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        // The weight depends on the documents of all statuses
+        const double weight = ranker.ComputeWordWeight(document_freq(word, it->second));
+        for (DocumentStatus status : statuses) {
+            const PostingList& partition = it->second.GetPartition(status);
+            if (!partition.empty()) {
+                postings.push_back({ &partition, weight, false, status });
+            }
+        }
+    }
+
+    // Expansions of a pattern or a fuzzy word are merged into one list of their summed scores per partition
+    const auto merge = [this, &ranker, &query, &document_freq, &postings, &pattern_postings, &statuses, merge_expansions](const std::pmr::vector<std::pair<std::string_view, double>>& expansions) {
+        std::pmr::vector<const PartitionedPostingList*> words(query.arena);
+        std::pmr::vector<double> word_weights(query.arena);
+        for (const auto& [word, weight_factor] : expansions) {
+            words.push_back(&word_to_document_freqs_.at(word));
+            word_weights.push_back(ranker.ComputeWordWeight(document_freq(word, *words.back())) * weight_factor);
+        }
+        for (DocumentStatus status : statuses) {
+            // MergePostingLists takes an ordinary vector
+            std::vector<const PostingList*> lists;
+            std::pmr::vector<double> weights(query.arena);
+            for (size_t i = 0; i < words.size(); ++i) {
+                if (!words[i]->GetPartition(status).empty()) {
+                    lists.push_back(&words[i]->GetPartition(status));
+                    weights.push_back(word_weights[i]);
+                }
+            }
+            if (!merge_expansions || lists.size() == 1) {
+                for (size_t i = 0; i < lists.size(); ++i) {
+                    postings.push_back({ lists[i], weights[i], false, status });
+                }
+                continue;
+            }
+            if (lists.empty()) {
+                continue;
+            }
+            pattern_postings.push_back(MergePostingLists(lists,
+                [this, &ranker, &weights](size_t list, uint32_t ordinal, double term_freq) {
+                    return ranker(weights[list], term_freq, ordinal_to_document_[ordinal].data->word_count);
+                }));
+            postings.push_back({ &pattern_postings.back(), 1.0, true, status });
+        }
+    };
+
+    // Keeps pointers to the merged lists valid
+    pattern_postings.reserve(pattern_postings.size() + (query.patterns.size() + query.fuzzy_words.size()) * statuses.size());
+    for (const std::string_view& pattern : query.patterns) {
+        PROFILE_SCOPE("ExpandPattern");
+        std::pmr::vector<std::pair<std::string_view, double>> expansions(query.arena);
+        for (const std::string_view& word : ExpandPattern(pattern, options_.max_pattern_expansions)) {
+            expansions.push_back({ word, 1.0 });
+        }
+        merge(expansions);
+    }
+    for (const auto& [fuzzy_word, max_distance] : query.fuzzy_words) {
+        PROFILE_SCOPE("ExpandFuzzy");
+        std::pmr::vector<std::pair<std::string_view, double>> expansions(query.arena);
+        for (const auto& [word, distance] : FindSimilarWords(fuzzy_word, max_distance, options_.max_pattern_expansions)) {
+            expansions.push_back({ word, std::pow(TYPO_WEIGHT, distance) });
+        }
+        merge(expansions);
+    }
+    return postings;
+}
+
+template<typename Ranker, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const {
+    if constexpr (IsLinearRanker<Ranker>::value) {
+        PROFILE_SCOPE("FindAllDocuments");
+        const ScoreAccumulator::Scope accumulator_scope;
+        ScoreAccumulator& accumulator = accumulator_scope.Get();
+        accumulator.Reserve(ordinal_to_document_.size());
+
+        // Only the partitions holding documents of the statuses the predicate can accept are scanned
+        const uint32_t partition_mask = GetPartitionMask(GetStatusMask(predicate));
+        std::pmr::vector<PostingList> pattern_postings(query.arena);
+        for (const WordPostings& word : CollectPostings(ranker, query, false, partition_mask, pattern_postings)) {
+            PROFILE_SCOPE("PostingScan");
+            accumulator.Add(word.postings->GetDocuments().data(), word.postings->GetTermFreqs().data(),
+                word.postings->size(), word.is_scored ? 1.0 : word.weight);
+        }
+
+        for (const std::string_view& word : query.minus_words) {
+            PROFILE_SCOPE("MinusFilter");
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end()) {
+                continue;
+            }
+            for (DocumentStatus status : GetStatuses(partition_mask, query.arena)) {
+                const PostingList& partition = it->second.GetPartition(status);
+                if (const RoaringBitmap* bitmap = partition.GetBitmap()) {
+                    accumulator.Remove(*bitmap);
+                    continue;
+                }
+                for (uint32_t ordinal : partition.GetDocuments()) {
+                    accumulator.Remove(ordinal);
+                }
             }
         }
+
+        const CompiledFilter filter = CompileFilter(predicate, query.arena);
+        if (!filter.bits.empty()) {
+            PROFILE_SCOPE("CompiledFilter");
+            accumulator.Keep(filter.bits.data(), filter.bits.size());
+        }
+
+        // The predicate is called once per matched document instead of once per posting, if at all
+        std::pmr::vector<Document> matched_documents(query.arena);
+        accumulator.Drain([this, &predicate, &filter, &matched_documents](uint32_t ordinal, double relevance) {
+            const DocumentEntry& document = ordinal_to_document_[ordinal];
+            if (filter.is_complete || predicate(document.id, document.status, document.rating)) {
+                matched_documents.push_back({ document.id, relevance, document.rating });
+            }
+        });
+
+#ifdef SEARCH_SERVER_VERIFY_SCORES
+        VerifyScores(matched_documents, FindAllDocumentsByMap(ranker, query, predicate));
+#endif
+        return matched_documents;
+    }
+    else {
+        return FindAllDocumentsByMap(ranker, query, predicate);
+    }
+}
+
+template<typename Ranker, typename DocumentPredicate>
+bool SearchServer::FindImpactDocuments(const Ranker& ranker, const Query& query, const MatchMode& mode, const DocumentPredicate& predicate,
+                                       std::pmr::vector<Document>& matched_documents) const {
+    // Impacts order the postings by term frequency, which is the order of the scores only for a linear ranker
+    if constexpr (!IsLinearRanker<Ranker>::value) {
+        return false;
+    }
+    else {
+        if (query.plus_words.empty() || query.plus_words.size() > MAX_IMPACT_QUERY_WORDS || !query.phrases.empty()
+            || !query.patterns.empty() || !query.fuzzy_words.empty() || mode.GetRequiredCount(query.plus_words.size()) > 1) {
+            return false;
+        }
+        PROFILE_SCOPE("FindImpactDocuments");
+
+        // In the order of CollectPostings, so the relevances are summed like the scan does
+        std::pmr::vector<std::pair<const PartitionedPostingList*, double>> words(query.arena);
+        for (const std::string_view& word : query.plus_words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end() || it->second.empty()) {
+                continue;
+            }
+            const double weight = ranker.ComputeWordWeight(query.document_freq ? (*query.document_freq)(word) : it->second.size());
+            // The tail bound needs every score to grow with the term frequency
+            if (!(weight > 0.0)) {
+                return false;
+            }
+            words.push_back({ &it->second, weight });
+        }
+        std::pmr::vector<const PartitionedPostingList*> minus_words(query.arena);
+        for (const std::string_view& word : query.minus_words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end()) {
+                minus_words.push_back(&it->second);
+            }
+        }
+
+        std::pmr::vector<uint32_t> candidates(query.arena);
+        // Highest score of a document missing from the candidates
+        double tail_bound = 0.0;
+        for (DocumentStatus status : GetStatuses(GetPartitionMask(GetStatusMask(predicate)), query.arena)) {
+            double partition_bound = 0.0;
+            for (const auto& [postings, weight] : words) {
+                const ImpactList& impacts = postings->GetImpacts(status);
+                if (impacts.IsEnabled()) {
+                    for (const ImpactList::Entry& entry : impacts.GetEntries()) {
+                        candidates.push_back(entry.document);
+                    }
+                    partition_bound += weight * impacts.GetTailBound();
+                }
+                else {
+                    const std::vector<uint32_t>& documents = postings->GetPartition(status).GetDocuments();
+                    candidates.insert(candidates.end(), documents.begin(), documents.end());
+                }
+            }
+            tail_bound = std::max(tail_bound, partition_bound);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        const CompiledFilter filter = CompileFilter(predicate, query.arena);
+        for (uint32_t ordinal : candidates) {
+            if (!IsAccepted(filter, predicate, ordinal)) {
+                continue;
+            }
+            const DocumentEntry& document = ordinal_to_document_[ordinal];
+            if (std::any_of(minus_words.begin(), minus_words.end(),
+                    [&document, ordinal](const PartitionedPostingList* postings) { return postings->Contains(document.partition, ordinal); })) {
+                continue;
+            }
+            double relevance = 0.0;
+            for (const auto& [postings, weight] : words) {
+                const float* term_freq = postings->GetPartition(document.partition).FindTermFreq(ordinal);
+                if (term_freq != nullptr) {
+                    relevance += ranker(weight, *term_freq, document.data->word_count);
+                }
+            }
+            matched_documents.push_back({ document.id, relevance, document.rating });
+        }
+
+        if (tail_bound == 0.0) {
+            return true;
+        }
+        // The tail can't reach the best documents, not even as a tie ordered by rating
+        if (matched_documents.size() >= MAX_RESULT_DOCUMENT_COUNT) {
+            const auto kth = matched_documents.begin() + (MAX_RESULT_DOCUMENT_COUNT - 1);
+            std::nth_element(matched_documents.begin(), kth, matched_documents.end(),
+                [](const Document& lhs, const Document& rhs) {
+                    return lhs.relevance > rhs.relevance;
+                });
+            if (kth->relevance - tail_bound >= MAX_RELEVANCE_ACCURACY) {
+                return true;
+            }
+        }
+        matched_documents.clear();
+        return false;
+    }
+}
+
+template<typename Ranker, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocumentsByMap(const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const {
+    PROFILE_SCOPE("FindAllDocuments");
+    std::pmr::map<int, double> document_to_relevance(query.arena);
+    const uint32_t partition_mask = GetPartitionMask(GetStatusMask(predicate));
+    std::pmr::vector<PostingList> pattern_postings(query.arena);
+    for (const WordPostings& word : CollectPostings(ranker, query, false, partition_mask, pattern_postings)) {
+        PROFILE_SCOPE("PostingScan");
+        word.postings->ForEach(
+            [this, &document_to_relevance, &predicate, &ranker, &word](uint32_t ordinal, double term_freq) {
+                const DocumentEntry& document = ordinal_to_document_[ordinal];
+                if (predicate(document.id, document.status, document.rating)) {
+                    document_to_relevance[document.id] += word.is_scored ? term_freq : ranker(word.weight, term_freq, document.data->word_count);
+                }
+            });
     }
 
     for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        PROFILE_SCOPE("MinusFilter");
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
             continue;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        for (DocumentStatus status : GetStatuses(partition_mask, query.arena)) {
+            for (uint32_t ordinal : it->second.GetPartition(status).GetDocuments()) {
+                document_to_relevance.erase(ordinal_to_document_[ordinal].id);
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
+    std::pmr::vector<Document> matched_documents(query.arena);
     for (const auto& [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({
                                         document_id,
@@ -190,45 +867,48 @@ std::vector<Document> SearchServer::FindAllDocuments(const Query& query, const D
     return matched_documents;
 }
 
-template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, const DocumentPredicate& predicate) const {
-    return FindAllDocuments(query, predicate);
+template<typename Ranker, typename DocumentPredicate>
+inline std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const {
+    return FindAllDocuments(ranker, query, predicate);
 }
 
-template<typename DocumentPredicate>
-inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, const DocumentPredicate& predicate) const {
+template<typename Ranker, typename DocumentPredicate>
+inline std::pmr::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Ranker& ranker, const Query& query, const DocumentPredicate& predicate) const {
+    PROFILE_SCOPE("FindAllDocumentsPar");
+    // Filled by the worker threads, so it can't use the arena of this one
     ConcurrentMap<int, double> document_to_relevance(4);
 
-    std::unordered_set<std::string_view> words;
-    std::for_each(query.plus_words.begin(), query.plus_words.end(),
-        [this, &words](const std::string_view& word) {
-            if (word_to_document_freqs_.count(word) != 0 &&
-                word_to_document_freqs_.at(word).size() != 0) {
-                words.insert(word);
-            }
-        });
+    const uint32_t partition_mask = GetPartitionMask(GetStatusMask(predicate));
+    std::pmr::vector<PostingList> pattern_postings(query.arena);
+    const std::pmr::vector<WordPostings> postings = CollectPostings(ranker, query, false, partition_mask, pattern_postings);
 
-    std::for_each(std::execution::par, words.begin(), words.end(),
-        [this, &document_to_relevance, &predicate](const std::string_view& word) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = document_data_.at(document_id);
-                if (predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
-        });
+    std::for_each(std::execution::par, postings.begin(), postings.end(),
+        InheritProfileScope([this, &document_to_relevance, &predicate, &ranker](const WordPostings& word) {
+            PROFILE_SCOPE("PostingScan");
+            word.postings->ForEach(
+                [this, &document_to_relevance, &predicate, &ranker, &word](uint32_t ordinal, double term_freq) {
+                    const DocumentEntry& document = ordinal_to_document_[ordinal];
+                    if (predicate(document.id, document.status, document.rating)) {
+                        document_to_relevance[document.id].ref_to_value +=
+                            word.is_scored ? term_freq : ranker(word.weight, term_freq, document.data->word_count);
+                    }
+                });
+        }));
 
     for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        PROFILE_SCOPE("MinusFilter");
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
             continue;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        for (DocumentStatus status : GetStatuses(partition_mask, query.arena)) {
+            for (uint32_t ordinal : it->second.GetPartition(status).GetDocuments()) {
+                document_to_relevance.erase(ordinal_to_document_[ordinal].id);
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
+    std::pmr::vector<Document> matched_documents(query.arena);
     for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
         matched_documents.push_back({
                                         document_id,
@@ -240,14 +920,112 @@ inline std::vector<Document> SearchServer::FindAllDocuments(const std::execution
     return matched_documents;
 }
 
+template<typename Ranker, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Ranker& ranker, const Query& query, const MatchMode& mode, const DocumentPredicate& predicate) const {
+    // Every pattern or fuzzy word is a single clause however many words it expands into
+    const size_t required_count = mode.GetRequiredCount(query.plus_words.size() + query.patterns.size() + query.fuzzy_words.size());
+    if (required_count <= 1 && query.phrases.empty()) {
+        return FindAllDocuments(ranker, query, predicate);
+    }
+
+    PROFILE_SCOPE("FindAllDocumentsConjunctive");
+    const uint32_t partition_mask = GetPartitionMask(GetStatusMask(predicate));
+    std::pmr::vector<PostingList> pattern_postings(query.arena);
+    const std::pmr::vector<WordPostings> postings = CollectPostings(ranker, query, true, partition_mask, pattern_postings);
+
+    // A document is in a single partition, so every partition is matched on its own
+    const CompiledFilter filter = CompileFilter(predicate, query.arena);
+    std::pmr::vector<Document> matched_documents(query.arena);
+    std::pmr::vector<WordPostings> partition_postings(query.arena);
+    for (DocumentStatus status : GetStatuses(partition_mask, query.arena)) {
+        partition_postings.clear();
+        std::copy_if(postings.begin(), postings.end(), std::back_inserter(partition_postings),
+            [status](const WordPostings& word) {
+                return word.status == status;
+            });
+        FindPartitionDocuments(ranker, query, required_count, status, partition_postings, predicate, filter, matched_documents);
+    }
+    return matched_documents;
+}
+
+template<typename Ranker, typename DocumentPredicate>
+void SearchServer::FindPartitionDocuments(const Ranker& ranker, const Query& query, size_t required_count, DocumentStatus status,
+                                          std::pmr::vector<WordPostings>& postings, const DocumentPredicate& predicate,
+                                          const CompiledFilter& filter, std::pmr::vector<Document>& matched_documents) const {
+    // Words missing from the partition can't be matched by any of its documents
+    if (postings.size() < required_count) {
+        return;
+    }
+
+    // Starting from the rarest word keeps the candidate set small
+    std::sort(postings.begin(), postings.end(),
+        [](const WordPostings& lhs, const WordPostings& rhs) {
+            return lhs.postings->size() < rhs.postings->size();
+        });
+    std::vector<const PostingList*> lists;
+    for (const WordPostings& word : postings) {
+        lists.push_back(word.postings);
+    }
+
+    std::vector<uint32_t> candidates;
+    if (query.phrases.empty()) {
+        candidates = MatchPostings(lists, required_count);
+    }
+    else {
+        candidates = MatchPhrases(query.phrases, status);
+        if (required_count > 1 && !candidates.empty()) {
+            std::vector<uint32_t> matched;
+            IntersectSorted(candidates, MatchPostings(lists, required_count), matched);
+            candidates = std::move(matched);
+        }
+    }
+
+    for (const std::string_view& word : query.minus_words) {
+        PROFILE_SCOPE("MinusFilter");
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            RemovePostings(candidates, it->second.GetPartition(status));
+        }
+    }
+
+    PROFILE_SCOPE("Score");
+    std::pmr::vector<size_t> cursors(postings.size(), 0, query.arena);
+    for (uint32_t ordinal : candidates) {
+        if (!IsAccepted(filter, predicate, ordinal)) {
+            continue;
+        }
+        const DocumentEntry& document = ordinal_to_document_[ordinal];
+        double relevance = 0.0;
+        for (size_t i = 0; i < postings.size(); ++i) {
+            const WordPostings& word = postings[i];
+            const std::vector<uint32_t>& documents = word.postings->GetDocuments();
+            cursors[i] = GallopingLowerBound(documents.data(), cursors[i], documents.size(), ordinal);
+            if (cursors[i] < documents.size() && documents[cursors[i]] == ordinal) {
+                const double term_freq = word.postings->GetTermFreqs()[cursors[i]];
+                relevance += word.is_scored ? term_freq : ranker(word.weight, term_freq, document.data->word_count);
+            }
+        }
+        matched_documents.push_back({ document.id, relevance, document.rating });
+    }
+}
+
 template<typename StringCollection>
-std::set<std::string, std::less<>> SearchServer::MakeUniqueNonEmptyStringCollection(const StringCollection& collection) const {
-    std::set<std::string, std::less<>> strings;
+SearchServer::StopWordSet SearchServer::MakeUniqueNonEmptyStringCollection(const StringCollection& collection) const {
+    StopWordSet strings;
     for (const std::string_view& word : collection) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument(std::string("Words can't contain special characters"));
         }
-        if (!word.empty()) {
+        if (analyzer_.IsEnabled()) {
+            // A stop word may split into several ones
+            std::vector<char> buffer(word.size());
+            std::pmr::vector<std::string_view> analyzed;
+            analyzer_.Split(word, buffer.data(), analyzed);
+            for (const std::string_view& analyzed_word : analyzed) {
+                strings.emplace(analyzed_word);
+            }
+        }
+        else if (!word.empty()) {
             strings.insert(std::string(word));
         }
     }
@@ -0,0 +1,165 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string& stop_words, const IndexOptions& options)
+    : pool_(max<size_t>(shard_count, 2) - 1) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(make_unique<Shard>(stop_words, options));
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    lock_guard guard(shard.mutex);
+    shard.server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::UpsertDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    lock_guard guard(shard.mutex);
+    shard.server.UpsertDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    lock_guard guard(shard.mutex);
+    shard.server.RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::UpdateDocumentStatus(int document_id, DocumentStatus status) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    lock_guard guard(shard.mutex);
+    shard.server.UpdateDocumentStatus(document_id, status);
+}
+
+void ShardedSearchServer::UpdateDocumentRatings(int document_id, const vector<int>& ratings) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    lock_guard guard(shard.mutex);
+    shard.server.UpdateDocumentRatings(document_id, ratings);
+}
+
+tuple<vector<string>, DocumentStatus> ShardedSearchServer::MatchDocument(const string_view& raw_query, int document_id) const {
+    const Shard& shard = *shards_[GetShardIndex(document_id)];
+    shared_lock guard(shard.mutex);
+    const auto [words, status] = shard.server.MatchDocument(raw_query, document_id);
+    return { vector<string>(words.begin(), words.end()), status };
+}
+
+string ShardedSearchServer::GetDocumentText(int document_id) const {
+    const Shard& shard = *shards_[GetShardIndex(document_id)];
+    shared_lock guard(shard.mutex);
+    return shard.server.GetDocumentText(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view& raw_query, const MatchMode& mode) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, mode, DocumentFilter().SetStatus(DocumentStatus::ACTUAL));
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view& raw_query, const DocumentStatus status) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, MatchMode::Any(), DocumentFilter().SetStatus(status));
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view& raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int count = 0;
+    for (const auto& shard : shards_) {
+        shared_lock guard(shard->mutex);
+        count += shard->server.GetDocumentCount();
+    }
+    return count;
+}
+
+ScoringContext ShardedSearchServer::GetScoringContext() const {
+    const auto locks = LockAllShards();
+    return ComputeScoringContext();
+}
+
+MemoryStats ShardedSearchServer::GetMemoryStats() const {
+    MemoryStats stats;
+    for (const auto& shard : shards_) {
+        shared_lock guard(shard->mutex);
+        stats += shard->server.GetMemoryStats();
+    }
+    return stats;
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return hash<int>()(document_id) % shards_.size();
+}
+
+ScoringContext ShardedSearchServer::ComputeScoringContext() const {
+    size_t document_count = 0;
+    double word_count = 0.0;
+    for (const auto& shard : shards_) {
+        const ScoringContext context = shard->server.GetScoringContext();
+        document_count += context.document_count;
+        word_count += context.average_document_length * static_cast<double>(context.document_count);
+    }
+    return { document_count, document_count == 0 ? 0.0 : word_count / static_cast<double>(document_count) };
+}
+
+IndexStatistics ShardedSearchServer::ComputeStatistics(const string_view& raw_query) const {
+    IndexStatistics statistics;
+    statistics.context = ComputeScoringContext();
+
+    // Every shard weighs its own expansions of the patterns and fuzzy words
+    vector<vector<string_view>> shard_words(shards_.size());
+    RunOnShards([&](size_t index) {
+        shard_words[index] = shards_[index]->server.GetQueryWords(raw_query);
+    });
+    auto document_freqs = make_shared<unordered_map<string_view, size_t>>();
+    for (const vector<string_view>& words : shard_words) {
+        for (const string_view& word : words) {
+            document_freqs->emplace(word, 0);
+        }
+    }
+    for (auto& [word, document_freq] : *document_freqs) {
+        for (const auto& shard : shards_) {
+            document_freq += shard->server.GetDocumentFreq(word);
+        }
+    }
+    statistics.document_freq = [document_freqs](string_view word) {
+        const auto it = document_freqs->find(word);
+        return it == document_freqs->end() ? size_t(0) : it->second;
+    };
+    return statistics;
+}
+
+vector<shared_lock<shared_mutex>> ShardedSearchServer::LockAllShards() const {
+    // Writers lock a single shard, so taking the locks in order can't deadlock
+    vector<shared_lock<shared_mutex>> locks;
+    locks.reserve(shards_.size());
+    for (const auto& shard : shards_) {
+        locks.emplace_back(shard->mutex);
+    }
+    return locks;
+}
+
+vector<Document> ShardedSearchServer::MergeTopDocuments(vector<vector<Document>> shard_results) {
+    PROFILE_SCOPE("MergeTopK");
+    vector<Document> result;
+    for (vector<Document>& documents : shard_results) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+    // Every shard returns its best documents, so the best of the union are the global ones
+    const size_t count = min(result.size(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    partial_sort(result.begin(), result.begin() + count, result.end(),
+        [](const Document& lhs, const Document& rhs) {
+            return Document::CompareRelevance(lhs, rhs);
+        });
+    result.resize(count);
+    return result;
+}
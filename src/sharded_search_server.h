@@ -0,0 +1,145 @@
+#pragma once
+
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Documents spread by the hash of their id over independent SearchServer shards.
+// Every shard has its own lock, so documents of different shards are added and removed
+// concurrently, and a query searches all shards in parallel. Words are weighted by
+// their frequencies over all shards, so the results are the ones of a single server
+// holding every document.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(size_t shard_count, const std::string& stop_words = std::string(),
+                                 const IndexOptions& options = IndexOptions());
+
+    void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpsertDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void UpdateDocumentStatus(int document_id, DocumentStatus status);
+    void UpdateDocumentRatings(int document_id, const std::vector<int>& ratings);
+
+    // The words are copied, views into the index would outlive the lock
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
+    std::string GetDocumentText(int document_id) const;
+
+    template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const;
+    template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int> = 0>
+    std::vector<Document> FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query) const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode) const;
+
+    template<typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const DocumentPredicate& predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, const DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const {
+        return shards_.size();
+    }
+    // Statistics of all shards together
+    ScoringContext GetScoringContext() const;
+    // Memory of all shards together
+    MemoryStats GetMemoryStats() const;
+
+private:
+    struct Shard {
+        explicit Shard(const std::string& stop_words, const IndexOptions& options)
+            : server(stop_words, options) {
+        }
+
+        mutable std::shared_mutex mutex;
+        SearchServer server;
+    };
+
+    size_t GetShardIndex(int document_id) const;
+    // Callers hold the locks of all shards
+    ScoringContext ComputeScoringContext() const;
+    // The document frequencies of the query words are summed over the shards once,
+    // the statistics refer to the shard dictionaries
+    IndexStatistics ComputeStatistics(const std::string_view& raw_query) const;
+    // Runs task(index) for every shard, the calling thread runs the first one. Rethrows the
+    // first exception after all tasks have finished.
+    template<typename Task>
+    void RunOnShards(const Task& task) const;
+    std::vector<std::shared_lock<std::shared_mutex>> LockAllShards() const;
+    // Best MAX_RESULT_DOCUMENT_COUNT documents of the per shard results
+    static std::vector<Document> MergeTopDocuments(std::vector<std::vector<Document>> shard_results);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // The calling thread searches the first shard itself
+    mutable ThreadPool pool_;
+};
+
+template<typename Scorer, typename DocumentPredicate, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const {
+    PROFILE_SCOPE("ShardedFindTopDocuments");
+    // Documents can't move between the shards while the statistics are computed and used
+    const auto locks = LockAllShards();
+    const IndexStatistics statistics = ComputeStatistics(raw_query);
+
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    RunOnShards([&](size_t index) {
+        shard_results[index] = shards_[index]->server.FindTopDocuments(scorer, raw_query, mode, predicate, statistics);
+    });
+    return MergeTopDocuments(std::move(shard_results));
+}
+
+template<typename Task>
+void ShardedSearchServer::RunOnShards(const Task& task) const {
+    std::vector<std::future<void>> futures;
+    futures.reserve(shards_.size());
+    for (size_t index = 1; index < shards_.size(); ++index) {
+        futures.push_back(pool_.Submit([&task, index]() { task(index); }));
+    }
+
+    // Every task has to finish before the locals it refers to are gone, even if the query is invalid
+    std::exception_ptr error;
+    try {
+        task(0);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    for (std::future<void>& future : futures) {
+        try {
+            future.get();
+        }
+        catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template<typename Scorer, std::enable_if_t<IsScorer<Scorer>::value, int>>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view& raw_query) const {
+    return FindTopDocuments(scorer, raw_query, MatchMode::Any(), DocumentFilter().SetStatus(DocumentStatus::ACTUAL));
+}
+
+template<typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query, const MatchMode& mode, const DocumentPredicate& predicate) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, mode, predicate);
+}
+
+template<typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view& raw_query, const DocumentPredicate& predicate) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, MatchMode::Any(), predicate);
+}
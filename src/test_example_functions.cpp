@@ -1,18 +1,46 @@
 #include "test_example_functions.h"
 
+#include "async_search_server.h"
+#include "corpus_loader.h"
+#include "document_filter.h"
+#include "document_store.h"
+#include "durable_search_server.h"
+#include "generators.h"
+#include "impact_list.h"
 #include "paginator.h"
+#include "partitioned_posting_list.h"
 #include "process_queries.h"
+#include "query_arena.h"
+#include "query_client.h"
+#include "query_server.h"
 #include "request_queue.h"
 #include "remove_duplicates.h"
+#include "roaring_bitmap.h"
+#include "scoring_kernels.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "text_analyzer.h"
+#include "workload.h"
+#include "write_ahead_log.h"
 
+#include <array>
 #include <chrono>
 #include <execution>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <map>
 #include <random>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 // -----------------------------------------------------------------------------
@@ -337,6 +365,27 @@ bool MoreThan(const double d1, const double d2, const double delta) {
     return d1 - d2 > delta;
 }
 
+// Id найденных документов, vector<int> сохраняет порядок результата
+template <typename Ids = set<int>>
+Ids DocumentIds(const vector<Document>& documents) {
+    Ids result;
+    for (const Document& document : documents) {
+        result.insert(result.end(), document.id);
+    }
+    return result;
+}
+
+// Сервер с четырьмя документами о питомцах, общий для проверок поиска
+SearchServer MakePetsServer(const array<DocumentStatus, 4>& statuses = { DocumentStatus::ACTUAL, DocumentStatus::ACTUAL,
+                                                                        DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fancy collar"s, statuses[0], { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, statuses[1], { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, statuses[2], { 5, -12, 2, 1 });
+    server.AddDocument(4, "groomed cat with fluffy tail"s, statuses[3], { 9 });
+    return server;
+}
+
 // Сортировка документов по релевантности
 void TestSortRelevance() {
     const double delta = 1e-6;
@@ -662,6 +711,57 @@ void TestRemoveDocument() {
 
     ASSERT_EQUAL_HINT(docs.at(3).id, 3, "Forth relevance has doc with id 3"s);
     ASSERT_HINT(InTheVicinity(docs.at(3).relevance, 0.34657359027997264, delta), "Wrong relevance"s);
+
+    { // Номера удалённых документов освобождаются, таблица не растёт при постоянной замене
+        IndexOptions options;
+        options.store_positions = true;
+        SearchServer replaced(""s, options);
+        replaced.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        replaced.AddDocument(1, "red cat"s, DocumentStatus::ACTUAL, { 2 });
+        const size_t metadata_bytes = replaced.GetMemoryStats().metadata.bytes;
+        for (int id = 2; id < 5000; ++id) {
+            replaced.RemoveDocument(id - 1);
+            replaced.AddDocument(id, "red cat"s, DocumentStatus::ACTUAL, { id });
+        }
+        ASSERT(replaced.GetMemoryStats().metadata.bytes <= metadata_bytes + 1024);
+        ASSERT(DocumentIds(replaced.FindTopDocuments("\"red cat\""s)) == (set<int>{ 4999 }));
+        ASSERT(DocumentIds(replaced.FindTopDocuments("cat"s, DocumentFilter().SetRatingRange(4999, 4999))) == (set<int>{ 4999 }));
+    }
+
+    { // После перенумерации поиск по длинным спискам, фильтрам и статусам не меняется
+        SearchServer compacted;
+        SearchServer reference;
+        for (int id = 0; id < 12000; ++id) {
+            const string text = (id % 3 == 0 ? "common rare"s : "common"s) + (id % 5 == 0 ? " fives"s : ""s);
+            const DocumentStatus status = id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            compacted.AddDocument(id, text, status, { id % 11 });
+            if (id % 4 == 3) {
+                reference.AddDocument(id, text, status, { id % 11 });
+            }
+        }
+        for (int id = 0; id < 12000; id += 4) {
+            compacted.RemoveDocument(id);
+        }
+        for (int id = 12000; id < 12100; ++id) {
+            compacted.AddDocument(id, "common fives"s, DocumentStatus::ACTUAL, { 3 });
+            reference.AddDocument(id, "common fives"s, DocumentStatus::ACTUAL, { 3 });
+        }
+        // Удалённых становится больше, чем оставшихся, и номера перенумеровываются
+        for (int id = 1; id < 12000; id += 4) {
+            compacted.RemoveDocument(execution::par, id);
+            compacted.RemoveDocument(id + 1);
+        }
+        for (const string& query : { "common"s, "rare fives"s, "common -rare"s, "fives -common"s }) {
+            ASSERT(DocumentIds(compacted.FindTopDocuments(query)) == DocumentIds(reference.FindTopDocuments(query)));
+            ASSERT(DocumentIds(compacted.FindTopDocuments(query, DocumentStatus::BANNED)) ==
+                   DocumentIds(reference.FindTopDocuments(query, DocumentStatus::BANNED)));
+            const DocumentFilter filter = DocumentFilter().SetRatingRange(2, 4).SetIdRange(3000, 3100);
+            ASSERT(DocumentIds(compacted.FindTopDocuments(query, filter)) == DocumentIds(reference.FindTopDocuments(query, filter)));
+            ASSERT(DocumentIds(compacted.FindTopDocuments(query, MatchMode::All())) ==
+                   DocumentIds(reference.FindTopDocuments(query, MatchMode::All())));
+        }
+        ASSERT(get<0>(compacted.MatchDocument("rare fives"s, 12099)).size() == 1);
+    }
 }
 
 // Проверка функции определения дубликатов
@@ -850,6 +950,2136 @@ void TestProcessQueriesJoined()
     }
 }
 
+// Проверка потоковой выдачи результатов пакета запросов и записи в буфер вызывающего
+void TestProcessQueriesStreaming() {
+    mt19937 generator(53);
+    const vector<string> words = GenerateWords(generator, 100, 6);
+    const vector<string> documents = GeneratePhrases(generator, words, 500, 10);
+    vector<string> queries = GeneratePhrases(generator, words, 300, 3, 0.2);
+    SearchServer server;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { static_cast<int>(i % 7) });
+    }
+    const vector<vector<Document>> expected = ProcessQueries(server, queries);
+
+    // Каждый запрос передаётся посетителю ровно один раз, в том числе при очереди из одного результата
+    for (size_t max_pending : { size_t(1), DEFAULT_MAX_PENDING_RESULTS }) {
+        vector<vector<Document>> visited(queries.size());
+        vector<int> visit_counts(queries.size(), 0);
+        ProcessQueries(server, queries, [&visited, &visit_counts](size_t index, vector<Document>& found) {
+            visited[index] = move(found);
+            ++visit_counts[index];
+        }, max_pending);
+        ASSERT(visited == expected);
+        ASSERT(all_of(visit_counts.begin(), visit_counts.end(), [](int count) { return count == 1; }));
+    }
+    ProcessQueries(server, {}, [](size_t, vector<Document>&) { ASSERT_HINT(false, "Empty batch has no results"s); });
+
+    { // Ошибка посетителя останавливает пакет и доходит до вызывающего
+        size_t visit_count = 0;
+        const auto failing_visitor = [&server, &queries, &visit_count]() {
+            ProcessQueries(server, queries, [&visit_count](size_t, vector<Document>&) {
+                if (++visit_count == 3) {
+                    throw out_of_range("Visitor failed"s);
+                }
+            }, 2);
+        };
+        ASSERT_OUT_OF_RANGE(failing_visitor);
+        ASSERT_EQUAL(visit_count, size_t(3));
+    }
+
+    { // Ошибка запроса доходит до вызывающего
+        vector<string> invalid_queries = queries;
+        invalid_queries[queries.size() / 2] = "cat --dog"s;
+        const auto invalid_query = [&server, &invalid_queries]() {
+            ProcessQueries(server, invalid_queries, [](size_t, vector<Document>&) {});
+        };
+        ASSERT_INVALID_ARGUMENT(invalid_query);
+    }
+
+    { // Запись в буфер совпадает с объединением результатов, буфер переиспользуется
+        vector<Document> joined;
+        for (const vector<Document>& found : expected) {
+            joined.insert(joined.end(), found.begin(), found.end());
+        }
+        vector<Document> buffer;
+        ProcessQueriesJoined(server, queries, buffer);
+        ASSERT(buffer == joined);
+        ASSERT(ProcessQueriesJoined(server, queries) == joined);
+        const Document* data = buffer.data();
+        queries.resize(queries.size() / 2);
+        ProcessQueriesJoined(server, queries, buffer);
+        ASSERT_EQUAL(buffer.data(), data);
+        ASSERT(buffer == vector<Document>(joined.begin(), joined.begin() + static_cast<ptrdiff_t>(buffer.size())));
+    }
+}
+
+// Проверка пересечения отсортированных списков документов
+void TestIntersectSorted() {
+    mt19937 generator;
+    for (const auto& [lhs_size, rhs_size] : vector<pair<int, int>>{ { 0, 10 }, { 7, 9 }, { 1'000, 1'000 }, { 10, 5'000 }, { 3, 100'000 } }) {
+        set<uint32_t> lhs_set;
+        set<uint32_t> rhs_set;
+        while (static_cast<int>(lhs_set.size()) < lhs_size) {
+            lhs_set.insert(uniform_int_distribution<uint32_t>(0, 200'000)(generator));
+        }
+        while (static_cast<int>(rhs_set.size()) < rhs_size) {
+            rhs_set.insert(uniform_int_distribution<uint32_t>(0, 200'000)(generator));
+        }
+        // Гарантируем наличие общих элементов
+        const vector<uint32_t> lhs(lhs_set.begin(), lhs_set.end());
+        for (size_t i = 0; i < lhs.size(); i += 2) {
+            rhs_set.insert(lhs[i]);
+        }
+        const vector<uint32_t> rhs(rhs_set.begin(), rhs_set.end());
+
+        vector<uint32_t> expected;
+        set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), back_inserter(expected));
+
+        vector<uint32_t> merged;
+        IntersectMerge(lhs.data(), lhs.size(), rhs.data(), rhs.size(), merged);
+        ASSERT(merged == expected);
+
+        vector<uint32_t> galloping;
+        IntersectGalloping(lhs, rhs, galloping);
+        ASSERT(galloping == expected);
+
+        vector<uint32_t> result;
+        IntersectSorted(rhs, lhs, result);
+        ASSERT(result == expected);
+    }
+}
+
+// Проверка режима поиска, требующего наличия всех или нескольких плюс слов
+void TestConjunctiveQueries() {
+    SearchServer server = MakePetsServer();
+    server.AddDocument(5, "fluffy dog with white tail"s, DocumentStatus::ACTUAL, { 1 });
+
+    { // Все плюс слова должны присутствовать в документе
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail"s, MatchMode::All())) == (set<int>{ 2, 5 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail cat"s, MatchMode::All())) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail cat"s, MatchMode::All(), DocumentStatus::BANNED)) == (set<int>{ 4 }));
+        ASSERT_HINT(server.FindTopDocuments("fluffy parrot"s, MatchMode::All()).empty(), "Unknown word can't be matched"s);
+        ASSERT_HINT(DocumentIds(server.FindTopDocuments("fluffy with tail"s, MatchMode::All())) == (set<int>{ 2, 5 }), "Stop words are not required"s);
+    }
+
+    { // Минимальное количество совпавших слов
+        ASSERT(DocumentIds(server.FindTopDocuments("white fluffy groomed"s, MatchMode::AtLeast(2))) == (set<int>{ 5 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("white cat dog tail"s, MatchMode::AtLeast(2))) == (set<int>{ 1, 2, 5 }));
+        ASSERT(server.FindTopDocuments("white cat dog tail"s, MatchMode::AtLeast(1)) == server.FindTopDocuments("white cat dog tail"s));
+    }
+
+    { // Минус слова и предикат
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail -dog"s, MatchMode::All())) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail"s, MatchMode::All(),
+            [](int, DocumentStatus, int rating) { return rating < 3; })) == (set<int>{ 5 }));
+    }
+
+    { // Релевантность совпадает с обычным поиском
+        const vector<Document> all = server.FindTopDocuments("fluffy tail"s, MatchMode::All());
+        const vector<Document> any = server.FindTopDocuments("fluffy tail"s);
+        for (const Document& document : all) {
+            const auto it = find_if(any.begin(), any.end(), [&document](const Document& other) { return other.id == document.id; });
+            ASSERT(it != any.end());
+            ASSERT(InTheVicinity(it->relevance, document.relevance, 1e-9));
+        }
+    }
+
+    { // Удалённые документы не находятся
+        server.RemoveDocument(2);
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy tail"s, MatchMode::All())) == (set<int>{ 5 }));
+    }
+}
+
+// Проверка поиска по фразам
+void TestPhraseQueries() {
+    SearchServer server("and with the"s, IndexOptions{ true });
+    server.AddDocument(1, "red cat and white dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "white cat with red collar"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "red fluffy cat"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "cat red"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "the red cat"s, DocumentStatus::BANNED, { 5 });
+
+    { // Слова фразы должны идти подряд и в заданном порядке
+        ASSERT(DocumentIds(server.FindTopDocuments("\"red cat\""s)) == (set<int>{ 1 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("\"red cat\""s, DocumentStatus::BANNED)) == (set<int>{ 5 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("\"white dog\" collar"s)) == (set<int>{ 1 }));
+        ASSERT(server.FindTopDocuments("\"dog white\""s).empty());
+    }
+
+    { // Допустимое расстояние между словами
+        ASSERT(DocumentIds(server.FindTopDocuments("\"red cat\"~1"s)) == (set<int>{ 1, 3 }));
+        ASSERT_HINT(DocumentIds(server.FindTopDocuments("\"red cat\"~2"s)) == (set<int>{ 1, 3, 4 }), "Swapped words need two moves"s);
+        ASSERT(DocumentIds(server.FindTopDocuments("\"white red\"~3"s)) == (set<int>{ 2 }));
+    }
+
+    { // Стоп слова занимают позицию внутри фразы
+        ASSERT(DocumentIds(server.FindTopDocuments("\"cat with red\""s)) == (set<int>{ 2 }));
+        ASSERT_HINT(DocumentIds(server.FindTopDocuments("\"cat and red\""s)) == (set<int>{ 2 }), "Any stop word fills the gap"s);
+        ASSERT(server.FindTopDocuments("\"cat and and red\""s).empty());
+        ASSERT(DocumentIds(server.FindTopDocuments("\"cat and white\""s)) == (set<int>{ 1 }));
+    }
+
+    { // Минус слова, параллельная версия и режим совпадения всех слов
+        ASSERT(server.FindTopDocuments("\"red cat\" -dog"s).empty());
+        ASSERT(DocumentIds(server.FindTopDocuments(execution::par, "\"red cat\"~2 -fluffy"s)) == (set<int>{ 1, 4 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("\"red cat\"~1 fluffy"s, MatchMode::All())) == (set<int>{ 3 }));
+    }
+
+    { // Позиции удаляются вместе с документом
+        server.RemoveDocument(1);
+        server.RemoveDocument(execution::par, 3);
+        ASSERT(DocumentIds(server.FindTopDocuments("\"red cat\"~2"s)) == (set<int>{ 4 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("\"white cat\""s)) == (set<int>{ 2 }));
+    }
+
+    { // Некорректные фразы
+        const auto unterminated = [&server]() { server.FindTopDocuments("\"red cat"s); };
+        ASSERT_INVALID_ARGUMENT(unterminated);
+        const auto minus_word = [&server]() { server.FindTopDocuments("\"red -cat\""s); };
+        ASSERT_INVALID_ARGUMENT(minus_word);
+        const auto bad_slop = [&server]() { server.FindTopDocuments("\"red cat\"~x"s); };
+        ASSERT_INVALID_ARGUMENT(bad_slop);
+        const auto huge_slop = [&server]() { server.FindTopDocuments("\"red cat\"~99999999999999999999"s); };
+        ASSERT_INVALID_ARGUMENT(huge_slop);
+    }
+
+    { // Без хранения позиций кавычка - обычный символ слова
+        SearchServer no_positions("and"s);
+        no_positions.AddDocument(1, "red cat"s, DocumentStatus::ACTUAL, { 1 });
+        no_positions.AddDocument(2, "\"red cat\""s, DocumentStatus::ACTUAL, { 2 });
+        no_positions.AddDocument(3, "white dog"s, DocumentStatus::ACTUAL, { 3 });
+        ASSERT(DocumentIds(no_positions.FindTopDocuments("\"red"s)) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(no_positions.FindTopDocuments("cat\""s)) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(no_positions.FindTopDocuments("\"red dog"s)) == (set<int>{ 2, 3 }));
+        ASSERT(no_positions.FindTopDocuments("\"white"s).empty());
+        ASSERT(get<0>(no_positions.MatchDocument("\"red cat"s, 1)).size() == 1);
+    }
+}
+
+// Проверка поиска по префиксу и шаблону
+void TestPatternQueries() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "cat and catalog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "category theory"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "dog with cut tail"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "cot cat"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "fluffy dog"s, DocumentStatus::ACTUAL, { 5 });
+
+    { // Префикс и шаблоны
+        ASSERT(DocumentIds(server.FindTopDocuments("cat*"s)) == (set<int>{ 1, 2, 4 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("c?t"s)) == (set<int>{ 1, 3, 4 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("c*t*"s)) == (set<int>{ 1, 2, 3, 4 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("*og"s)) == (set<int>{ 1, 3, 5 }));
+        ASSERT(DocumentIds(server.FindTopDocuments(execution::par, "cat*"s)) == (set<int>{ 1, 2, 4 }));
+        ASSERT(server.FindTopDocuments("parrot*"s).empty());
+    }
+
+    { // Релевантность равна сумме по всем словам, подходящим под шаблон
+        const vector<Document> expanded = server.FindTopDocuments("cat catalog category"s);
+        const vector<Document> pattern = server.FindTopDocuments("cat*"s);
+        ASSERT_EQUAL(expanded.size(), pattern.size());
+        for (size_t i = 0; i < expanded.size(); ++i) {
+            ASSERT_EQUAL(expanded[i].id, pattern[i].id);
+            ASSERT(InTheVicinity(expanded[i].relevance, pattern[i].relevance, 1e-9));
+        }
+    }
+
+    { // Шаблон считается одним словом в режиме совпадения всех слов
+        ASSERT(DocumentIds(server.FindTopDocuments("cat* theory"s, MatchMode::All())) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("c?t dog"s, MatchMode::All())) == (set<int>{ 3 }));
+    }
+
+    { // Минус шаблон исключает все подходящие слова
+        ASSERT(DocumentIds(server.FindTopDocuments("c?t -cat*"s)) == (set<int>{ 3 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("dog -c*"s)) == (set<int>{ 5 }));
+    }
+
+    { // Совпавшие слова документа
+        const auto [words, status] = server.MatchDocument("cat* dog"s, 1);
+        ASSERT(words == (vector<string_view>{ "cat"sv, "catalog"sv }));
+        const auto [par_words, par_status] = server.MatchDocument(execution::par, "cat* dog"s, 1);
+        ASSERT(par_words == words);
+    }
+
+    { // Ограничение количества слов, в которые раскрывается шаблон
+        IndexOptions options;
+        options.max_pattern_expansions = 1;
+        SearchServer limited(""s, options);
+        limited.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        limited.AddDocument(2, "cats"s, DocumentStatus::ACTUAL, { 1 });
+        limited.AddDocument(3, "cats dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(DocumentIds(limited.FindTopDocuments("cat*"s)) == (set<int>{ 2, 3 }), "The most frequent word is kept"s);
+        ASSERT(DocumentIds(limited.FindTopDocuments("dog -cat*"s)) == (set<int>{}));
+    }
+
+    { // Шаблон с ведущим символом подстановки просматривает не больше max_pattern_scan слов словаря
+        IndexOptions options;
+        options.max_pattern_scan = 2;
+        SearchServer limited(""s, options);
+        limited.AddDocument(1, "bat"s, DocumentStatus::ACTUAL, { 1 });
+        limited.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        limited.AddDocument(3, "rat dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(DocumentIds(limited.FindTopDocuments("*at"s)) == (set<int>{ 1, 2 }), "Only the first words are scanned"s);
+        ASSERT(DocumentIds(limited.FindTopDocuments("c*"s)) == (set<int>{ 2 }));
+        // Минус шаблон не может исключить только часть слов
+        const auto broad_minus = [&limited]() { limited.FindTopDocuments("dog -*at"s); };
+        ASSERT_INVALID_ARGUMENT(broad_minus);
+    }
+
+    { // Без раскрытия шаблонов символы * и ? - обычные символы слова
+        IndexOptions options;
+        options.max_pattern_expansions = 0;
+        SearchServer literal(""s, options);
+        literal.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        literal.AddDocument(2, "cat*"s, DocumentStatus::ACTUAL, { 1 });
+        literal.AddDocument(3, "what?"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(DocumentIds(literal.FindTopDocuments("cat*"s)) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(literal.FindTopDocuments("what? -cat*"s)) == (set<int>{ 3 }));
+    }
+}
+
+// Проверка нечёткого поиска слов с опечатками
+void TestFuzzyQueries() {
+    IndexOptions options;
+    options.max_typo_distance = 2;
+    SearchServer server("and with"s, options);
+    server.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "groomed cats"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "scary tiger"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "coat with collar"s, DocumentStatus::ACTUAL, { 5 });
+
+    { // Расстояние редактирования
+        ASSERT(server.FindTopDocuments("flufy"s).empty());
+        ASSERT(DocumentIds(server.FindTopDocuments("flufy~1"s)) == (set<int>{ 1, 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("cat~1"s)) == (set<int>{ 1, 3, 5 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("tigre~1"s)).empty());
+        ASSERT_HINT(DocumentIds(server.FindTopDocuments("tigre~2"s)) == (set<int>{ 4 }), "Transposition is two edits"s);
+        ASSERT(DocumentIds(server.FindTopDocuments(execution::par, "flufy~1"s)) == (set<int>{ 1, 2 }));
+        ASSERT_HINT(DocumentIds(server.FindTopDocuments("tigre~"s)).empty(), "Short words allow one typo by default"s);
+        ASSERT(DocumentIds(server.FindTopDocuments("colalr~"s)) == (set<int>{ 5 }));
+    }
+
+    { // Точное совпадение весит больше исправленного
+        const vector<Document> documents = server.FindTopDocuments("cat~1"s);
+        ASSERT_EQUAL(documents.front().id, 1);
+    }
+
+    { // Режим совпадения всех слов, минус слова и совпавшие слова документа
+        ASSERT(DocumentIds(server.FindTopDocuments("flufy~ dgg~"s, MatchMode::All())) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("fluffy -dgg~"s)) == (set<int>{ 1 }));
+        const string query = "cas~1 groomed"s;
+        const auto [words, status] = server.MatchDocument(query, 3);
+        ASSERT(words == (vector<string_view>{ "cats"sv, "groomed"sv }));
+    }
+
+    { // Удалённые слова не находятся
+        server.RemoveDocument(4);
+        ASSERT(server.FindTopDocuments("tigre~2"s).empty());
+        server.AddDocument(6, "tiger"s, DocumentStatus::ACTUAL, { 6 });
+        ASSERT(DocumentIds(server.FindTopDocuments("tigre~2"s)) == (set<int>{ 6 }));
+    }
+
+    { // Ошибки в запросе
+        const auto too_far = [&server]() { server.FindTopDocuments("cat~3"s); };
+        ASSERT_INVALID_ARGUMENT(too_far);
+        const auto overflow = [&server]() { server.FindTopDocuments("cat~99999999999999999999"s); };
+        ASSERT_INVALID_ARGUMENT(overflow);
+        const auto wrapped = [&server]() { server.FindTopDocuments("cat~4294967296"s); };
+        ASSERT_INVALID_ARGUMENT(wrapped);
+    }
+
+    { // Без индекса опечаток тильда - обычный символ слова
+        SearchServer exact("and"s);
+        exact.AddDocument(1, "cat~2 cat"s, DocumentStatus::ACTUAL, { 1 });
+        exact.AddDocument(2, "cat dog"s, DocumentStatus::ACTUAL, { 2 });
+        ASSERT(DocumentIds(exact.FindTopDocuments("cat~2"s)) == (set<int>{ 1 }));
+        ASSERT(exact.FindTopDocuments("cat~"s).empty());
+        ASSERT(DocumentIds(exact.FindTopDocuments("cat -cat~2"s)) == (set<int>{ 2 }));
+    }
+
+    { // Минус-слово с опечаткой исключает все похожие слова, а не только первые max_pattern_expansions
+        IndexOptions narrow;
+        narrow.max_typo_distance = 1;
+        narrow.max_pattern_expansions = 1;
+        SearchServer narrow_server(""s, narrow);
+        narrow_server.AddDocument(1, "bat"s, DocumentStatus::ACTUAL, { 1 });
+        narrow_server.AddDocument(2, "hat"s, DocumentStatus::ACTUAL, { 1 });
+        narrow_server.AddDocument(3, "rat sat"s, DocumentStatus::ACTUAL, { 1 });
+        narrow_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_EQUAL(narrow_server.FindTopDocuments("cat~"s).size(), size_t(1));
+        ASSERT(DocumentIds(narrow_server.FindTopDocuments("bat hat rat dog -cat~"s)) == (set<int>{ 4 }));
+    }
+
+    { // Расстояние Левенштейна
+        const vector<tuple<string, string, size_t>> pairs = { { "kitten"s, "sitting"s, 3 }, { "cat"s, "cut"s, 1 },
+            { "cat"s, "cats"s, 1 }, { "flaw"s, "lawn"s, 2 } };
+        for (const auto& [lhs, rhs, distance] : pairs) {
+            IndexOptions wide;
+            wide.max_typo_distance = 3;
+            SearchServer pair_server(""s, wide);
+            pair_server.AddDocument(1, rhs, DocumentStatus::ACTUAL, { 1 });
+            ASSERT_EQUAL(pair_server.FindTopDocuments(lhs + "~"s + to_string(distance)).size(), size_t(1));
+            ASSERT(pair_server.FindTopDocuments(lhs + "~"s + to_string(distance - 1)).empty());
+        }
+    }
+}
+
+// Проверка анализатора текста
+void TestTextAnalyzer() {
+    const auto split = [](const TextAnalyzer& analyzer, const string& text) {
+        vector<char> buffer(text.size());
+        pmr::vector<string_view> words;
+        analyzer.Split(text, buffer.data(), words);
+        return vector<string>(words.begin(), words.end());
+    };
+
+    { // По умолчанию слова разделяются только пробелами и не изменяются
+        const TextAnalyzer analyzer;
+        ASSERT(!analyzer.IsEnabled());
+        ASSERT(split(analyzer, "  Кот, Dog!  "s) == (vector<string>{ "Кот,"s, "Dog!"s }));
+    }
+
+    { // Регистр
+        AnalyzerOptions options;
+        options.fold_case = true;
+        const TextAnalyzer analyzer(options);
+        ASSERT(split(analyzer, "Пушистый КОТ Fluffy ΣΟΦΙΑ Ёж"s) == (vector<string>{ "пушистый"s, "кот"s, "fluffy"s, "σοφια"s, "ёж"s }));
+        ASSERT(split(analyzer, "ÉCOLE Straße Łódź"s) == (vector<string>{ "école"s, "straße"s, "łódź"s }));
+        // Без разбиения по знакам препинания они остаются частью слова
+        ASSERT(split(analyzer, "Cat,Dog"s) == (vector<string>{ "cat,dog"s }));
+    }
+
+    { // Знаки препинания
+        AnalyzerOptions options;
+        options.split_punctuation = true;
+        const TextAnalyzer analyzer(options);
+        ASSERT(split(analyzer, "cat,dog. (White) «кот»—пёс… e-mail"s)
+               == (vector<string>{ "cat"s, "dog"s, "White"s, "кот"s, "пёс"s, "e"s, "mail"s }));
+        ASSERT(split(analyzer, "!!! ... --"s).empty());
+    }
+
+    { // Нормализация
+        AnalyzerOptions options;
+        options.normalize = true;
+        const TextAnalyzer analyzer(options);
+        ASSERT(split(analyzer, "ёлка Café naïve ﬁle ＣＡＴ"s) == (vector<string>{ "елка"s, "Cafe"s, "naive"s, "file"s, "CAT"s }));
+        // Неразрывный пробел разделяет слова, мягкий перенос и комбинируемые знаки удаляются
+        ASSERT(split(analyzer, "red\u00A0cat ко\u00ADшка e\u0301te"s) == (vector<string>{ "red"s, "cat"s, "кошка"s, "ete"s }));
+    }
+
+    { // Все шаги вместе, слово целиком для шаблонов
+        const TextAnalyzer analyzer(AnalyzerOptions{ true, true, true });
+        ASSERT(split(analyzer, "Ёлка, КОТ-Café!"s) == (vector<string>{ "елка"s, "кот"s, "cafe"s }));
+        const string pattern = "Кот*?"s;
+        vector<char> buffer(pattern.size());
+        ASSERT_EQUAL(analyzer.AnalyzeWord(pattern, buffer.data()), "кот*?"sv);
+        const string ignorable = "\u0301\u00AD"s;
+        buffer.resize(ignorable.size());
+        ASSERT(analyzer.AnalyzeWord(ignorable, buffer.data()).empty());
+    }
+
+    { // Некорректный UTF-8 и управляющие символы
+        const TextAnalyzer analyzer(AnalyzerOptions{ true, true, true });
+        for (const string& text : { "cat \xD0"s, "\xFF dog"s, "\xC0\xAF"s, "\xED\xA0\x80"s, "cat\x01"s, "кот\nпёс"s }) {
+            const auto split_invalid = [&split, &analyzer, &text]() { split(analyzer, text); };
+            ASSERT_INVALID_ARGUMENT(split_invalid);
+        }
+    }
+
+    { // Длинный ASCII-текст обрабатывается блоками, результат совпадает с посимвольным разбором
+        mt19937 generator(47);
+        const string alphabet = "abcXYZ019 .,-!_"s;
+        string text;
+        for (int i = 0; i < 5000; ++i) {
+            text.push_back(alphabet[uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)]);
+        }
+        const auto split_scalar = [](string_view text) {
+            vector<string> words;
+            string word;
+            for (const char c : text) {
+                if (isalnum(static_cast<unsigned char>(c))) {
+                    word.push_back(static_cast<char>(tolower(static_cast<unsigned char>(c))));
+                }
+                else if (!word.empty()) {
+                    words.push_back(move(word));
+                    word.clear();
+                }
+            }
+            if (!word.empty()) {
+                words.push_back(move(word));
+            }
+            return words;
+        };
+        const TextAnalyzer analyzer(AnalyzerOptions{ true, true, true });
+        // Смещение текста относительно начала блока не влияет на результат
+        for (size_t offset = 0; offset < 16; ++offset) {
+            ASSERT(split(analyzer, text.substr(offset)) == split_scalar(string_view(text).substr(offset)));
+        }
+    }
+
+    { // Документы, запросы и стоп-слова проходят через один анализатор
+        IndexOptions options;
+        options.store_positions = true;
+        options.analyzer = AnalyzerOptions{ true, true, true };
+        SearchServer server("И, С"s, options);
+        server.AddDocument(1, "Пушистый кот, и белый пёс."s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, "Ёж с ошейником"s, DocumentStatus::ACTUAL, { 2 });
+        server.AddDocument(3, "Café au lait"s, DocumentStatus::ACTUAL, { 3 });
+
+        ASSERT(DocumentIds(server.FindTopDocuments("КОТ!"s)) == (set<int>{ 1 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("ежик ёж"s)) == (set<int>{ 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("cafe"s)) == (set<int>{ 3 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("кот,ёж"s)) == (set<int>{ 1, 2 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("кот ёж -ОШЕЙНИКОМ"s)) == (set<int>{ 1 }));
+        ASSERT(DocumentIds(server.FindTopDocuments("ПУШ*"s)) == (set<int>{ 1 }));
+        // Стоп-слово «и» не занимает позицию в фразе, но считается в расстоянии между словами
+        ASSERT(DocumentIds(server.FindTopDocuments("\"Кот И белый\""s)) == (set<int>{ 1 }));
+        ASSERT(server.FindTopDocuments("\"белый кот\""s).empty());
+        ASSERT(server.FindTopDocuments("и"s).empty());
+
+        const auto [words, status] = server.MatchDocument("Пушистый, БЕЛЫЙ -ёж"s, 1);
+        ASSERT(words == (vector<string_view>{ "белый"sv, "пушистый"sv }));
+        const auto control_char = [&server]() { server.AddDocument(4, "кот\x01"s, DocumentStatus::ACTUAL, { 1 }); };
+        ASSERT_INVALID_ARGUMENT(control_char);
+        const auto invalid_utf8 = [&server]() { server.FindTopDocuments("кот \xD0"s); };
+        ASSERT_INVALID_ARGUMENT(invalid_utf8);
+    }
+}
+
+// Считает релевантностью количество совпавших слов
+class MatchedWordsScorer {
+public:
+    struct Ranker {
+        double ComputeWordWeight(size_t) const {
+            return 1.0;
+        }
+        double operator()(double word_weight, double, uint32_t) const {
+            return word_weight;
+        }
+    };
+
+    Ranker Prepare(const ScoringContext&) const {
+        return {};
+    }
+};
+
+// Проверка функций ранжирования
+void TestScorers() {
+    static_assert(IsScorer<TfIdfScorer>::value && IsScorer<Bm25Scorer>::value && IsScorer<MatchedWordsScorer>::value);
+    static_assert(!IsScorer<string>::value && !IsScorer<DocumentStatus>::value);
+
+    SearchServer server("with"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "black dog with collar"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "cat cat dog"s, DocumentStatus::ACTUAL, { 3 });
+
+    { // Статистика индекса
+        const ScoringContext context = server.GetScoringContext();
+        ASSERT_EQUAL(context.document_count, size_t(3));
+        ASSERT(InTheVicinity(context.average_document_length, 8.0 / 3.0, 1e-9));
+    }
+
+    { // TF-IDF используется по умолчанию
+        ASSERT(server.FindTopDocuments(TfIdfScorer(), "cat dog"s) == server.FindTopDocuments("cat dog"s));
+        ASSERT(server.FindTopDocuments(execution::par, TfIdfScorer(), "cat dog"s) == server.FindTopDocuments("cat dog"s));
+    }
+
+    { // BM25 с параметрами k1 = 1.2, b = 0.75
+        const double idf = log(1.0 + (3.0 - 2.0 + 0.5) / (2.0 + 0.5));
+        const double average = 8.0 / 3.0;
+        const auto bm25 = [idf, average](double count, double length) {
+            return idf * count * 2.2 / (count + 1.2 * (0.25 + 0.75 * length / average));
+        };
+        const vector<Document> documents = server.FindTopDocuments(Bm25Scorer(), "cat"s);
+        ASSERT_EQUAL(documents.size(), size_t(2));
+        ASSERT_EQUAL(documents[0].id, 3);
+        ASSERT(InTheVicinity(documents[0].relevance, bm25(2.0, 3.0), 1e-6));
+        ASSERT_EQUAL(documents[1].id, 1);
+        ASSERT(InTheVicinity(documents[1].relevance, bm25(1.0, 2.0), 1e-6));
+
+        ASSERT(server.FindTopDocuments(execution::par, Bm25Scorer(), "cat dog"s) == server.FindTopDocuments(Bm25Scorer(), "cat dog"s));
+        const vector<Document> all = server.FindTopDocuments(Bm25Scorer(), "cat dog"s, MatchMode::All());
+        ASSERT_EQUAL(all.size(), size_t(1));
+        ASSERT(InTheVicinity(all[0].relevance, server.FindTopDocuments(Bm25Scorer(), "cat dog"s)[0].relevance, 1e-9));
+    }
+
+    { // Пользовательская функция, параметры и фильтры
+        const vector<Document> documents = server.FindTopDocuments(MatchedWordsScorer(), "cat dog collar"s);
+        ASSERT_EQUAL(documents.size(), size_t(3));
+        ASSERT(InTheVicinity(documents[0].relevance, 2.0, 1e-9));
+        ASSERT(InTheVicinity(documents[1].relevance, 2.0, 1e-9));
+        ASSERT_EQUAL(documents[2].id, 1);
+        ASSERT_EQUAL(server.FindTopDocuments(MatchedWordsScorer(), "cat"s, DocumentStatus::BANNED).size(), size_t(0));
+        ASSERT_EQUAL(server.FindTopDocuments(MatchedWordsScorer(), "cat dog"s,
+            [](int, DocumentStatus, int rating) { return rating > 1; }).size(), size_t(2));
+        ASSERT(server.FindTopDocuments(Bm25Scorer(2.0, 0.0), "cat"s)[0].relevance > server.FindTopDocuments(Bm25Scorer(), "cat"s)[0].relevance);
+    }
+}
+
+// Проверка векторизованного подсчёта релевантности
+void TestScoringKernels() {
+    const vector<ScoringKernel> kernels = { ScoringKernel::SCALAR, ScoringKernel::SSE2, ScoringKernel::AVX2, ScoringKernel::AVX512 };
+    ASSERT(IsScoringKernelSupported(ScoringKernel::SCALAR));
+    ASSERT(IsScoringKernelSupported(GetScoringKernel()));
+
+    { // Все наборы инструкций дают одинаковый результат, включая хвост неполного блока
+        mt19937 generator(7);
+        vector<uint32_t> documents;
+        for (uint32_t document = 0; document < 1000; ++document) {
+            if (uniform_int_distribution<int>(0, 2)(generator) == 0) {
+                documents.push_back(document);
+            }
+        }
+        vector<float> term_freqs;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            term_freqs.push_back(uniform_real_distribution<float>(0.0f, 1.0f)(generator));
+        }
+
+        vector<double> expected(1000, 0.5);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            expected[documents[i]] += static_cast<double>(term_freqs[i]) * 1.7;
+        }
+        for (ScoringKernel kernel : kernels) {
+            if (!IsScoringKernelSupported(kernel)) {
+                continue;
+            }
+            for (size_t count : { documents.size(), documents.size() - 3, size_t(5), size_t(0) }) {
+                vector<double> scores(1000, 0.5);
+                AccumulateScores(kernel, documents.data(), term_freqs.data(), count, 1.7, scores.data());
+                for (size_t i = 0; i < count; ++i) {
+                    ASSERT_HINT(scores[documents[i]] == expected[documents[i]], string(GetScoringKernelName(kernel)));
+                }
+                for (size_t i = count; i < documents.size(); ++i) {
+                    ASSERT_EQUAL(scores[documents[i]], 0.5);
+                }
+            }
+        }
+    }
+
+    { // Результаты поиска не зависят от набора инструкций
+        const SearchServer server = MakePetsServer();
+
+        const ScoringKernel active = GetScoringKernel();
+        SetScoringKernel(ScoringKernel::SCALAR);
+        const vector<Document> expected = server.FindTopDocuments("fluffy groomed cat -collar"s);
+        for (ScoringKernel kernel : kernels) {
+            if (IsScoringKernelSupported(kernel)) {
+                SetScoringKernel(kernel);
+                ASSERT(server.FindTopDocuments("fluffy groomed cat -collar"s) == expected);
+            }
+            else {
+                const auto set_unsupported = [kernel]() { SetScoringKernel(kernel); };
+                ASSERT_INVALID_ARGUMENT(set_unsupported);
+            }
+        }
+        SetScoringKernel(active);
+        ASSERT_EQUAL(expected.size(), size_t(2));
+
+        // Исключение из предиката не оставляет оценок следующему запросу
+        const auto throwing_query = [&server]() {
+            server.FindTopDocuments("fluffy groomed cat"s, [](int, DocumentStatus, int) -> bool {
+                throw invalid_argument("predicate"s);
+            });
+        };
+        ASSERT_INVALID_ARGUMENT(throwing_query);
+        SearchServer other("and with"s);
+        other.AddDocument(7, "groomed parrot"s, DocumentStatus::ACTUAL, { 1 });
+        const vector<Document> other_documents = other.FindTopDocuments("fluffy groomed cat"s);
+        ASSERT_EQUAL(other_documents.size(), size_t(1));
+        ASSERT_EQUAL(other_documents[0].id, 7);
+        ASSERT(server.FindTopDocuments("fluffy groomed cat -collar"s) == expected);
+
+        // Запрос из предиката другого запроса получает свой накопитель
+        const vector<Document> outer = server.FindTopDocuments("fluffy groomed cat -collar"s,
+            [&other](int, DocumentStatus, int) {
+                return other.FindTopDocuments("groomed"s).size() == 1;
+            });
+        ASSERT(outer == server.FindTopDocuments("fluffy groomed cat -collar"s, [](int, DocumentStatus, int) { return true; }));
+    }
+}
+
+// Проверка разбиения списков документов по статусам
+void TestPartitionedPostings() {
+    { // Документ лежит в разделе своего статуса и переносится вместе с частотой и позициями
+        PartitionedPostingList postings;
+        postings.Add(DocumentStatus::ACTUAL, 1, 0.5);
+        postings.SetPositions(DocumentStatus::ACTUAL, 1, { 0, 4 });
+        postings.Add(DocumentStatus::BANNED, 2, 0.25);
+        postings.SetPositions(DocumentStatus::BANNED, 2, { 3 });
+        postings.Add(DocumentStatus::ACTUAL, 3, 0.75);
+        postings.SetPositions(DocumentStatus::ACTUAL, 3, { 1 });
+        ASSERT_EQUAL(postings.size(), size_t(3));
+        ASSERT(postings.Contains(DocumentStatus::ACTUAL, 3));
+        ASSERT(!postings.Contains(DocumentStatus::BANNED, 3));
+        ASSERT(postings.GetPartition(DocumentStatus::REMOVED).empty());
+
+        postings.MoveDocuments({ { 1, DocumentStatus::ACTUAL, DocumentStatus::BANNED } });
+        ASSERT_EQUAL(postings.size(), size_t(3));
+        ASSERT_EQUAL(postings.GetPartition(DocumentStatus::ACTUAL).GetDocuments(), vector<uint32_t>({ 3 }));
+        const PostingList& banned = postings.GetPartition(DocumentStatus::BANNED);
+        ASSERT_EQUAL(banned.GetDocuments(), vector<uint32_t>({ 1, 2 }));
+        ASSERT_EQUAL(banned.GetTermFreqs()[0], 0.5f);
+        ASSERT_EQUAL(banned.GetPositions(0), vector<uint32_t>({ 0, 4 }));
+        ASSERT_EQUAL(banned.GetPositions(1), vector<uint32_t>({ 3 }));
+
+        ASSERT(!postings.Remove(DocumentStatus::ACTUAL, 1));
+        ASSERT(postings.Remove(DocumentStatus::BANNED, 1));
+        ASSERT_EQUAL(postings.size(), size_t(2));
+    }
+
+    { // Пачка документов переносится между несколькими разделами, битовые карты и списки по вкладу следуют за ними
+        PartitionedPostingList postings;
+        vector<PartitionedPostingList::StatusMove> moves;
+        for (uint32_t document = 0; document < 5000; ++document) {
+            const DocumentStatus status = document % 20 == 19 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+            postings.Add(status, document, 1.0 + document % 7);
+            postings.SetPositions(status, document, { document % 5, document % 5 + 300 });
+            if (document % 2 == 0) {
+                moves.push_back({ document, status, DocumentStatus::BANNED });
+            }
+            else if (status == DocumentStatus::IRRELEVANT) {
+                moves.push_back({ document, status, DocumentStatus::ACTUAL });
+            }
+        }
+        ASSERT(postings.GetPartition(DocumentStatus::ACTUAL).GetBitmap() != nullptr);
+
+        postings.MoveDocuments(moves);
+        ASSERT_EQUAL(postings.size(), size_t(5000));
+        const PostingList& actual = postings.GetPartition(DocumentStatus::ACTUAL);
+        const PostingList& banned = postings.GetPartition(DocumentStatus::BANNED);
+        ASSERT(postings.GetPartition(DocumentStatus::IRRELEVANT).empty());
+        ASSERT_EQUAL(actual.size(), size_t(2500));
+        ASSERT_EQUAL(banned.size(), size_t(2500));
+        for (const PostingList* partition : { &actual, &banned }) {
+            const vector<uint32_t>& documents = partition->GetDocuments();
+            ASSERT(is_sorted(documents.begin(), documents.end()));
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL(documents[i] % 2, partition == &actual ? 1u : 0u);
+                ASSERT_EQUAL(partition->GetTermFreqs()[i], 1.0f + documents[i] % 7);
+                ASSERT_EQUAL(partition->GetPositions(i), vector<uint32_t>({ documents[i] % 5, documents[i] % 5 + 300 }));
+            }
+        }
+        // Оставшаяся половина сохраняет битовую карту, пока не станет разреженной, а новая ещё не плотная
+        ASSERT(actual.GetBitmap() != nullptr && actual.GetBitmap()->Contains(4999) && !actual.GetBitmap()->Contains(4998));
+        ASSERT(banned.GetBitmap() == nullptr);
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const ImpactList& impacts = postings.GetImpacts(status);
+            ASSERT(impacts.IsEnabled());
+            ASSERT(all_of(impacts.GetEntries().begin(), impacts.GetEntries().end(),
+                [&postings, status](const ImpactList::Entry& entry) { return postings.Contains(status, entry.document); }));
+        }
+        ASSERT(!postings.GetImpacts(DocumentStatus::IRRELEVANT).IsEnabled());
+    }
+
+    { // Поиск по статусу проходит только по его разделу, а IDF считается по всем документам
+        SearchServer server = MakePetsServer({ DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                               DocumentStatus::BANNED, DocumentStatus::ACTUAL });
+        const vector<Document> actual = server.FindTopDocuments("fluffy groomed cat"s);
+        ASSERT_EQUAL(actual.size(), size_t(2));
+        ASSERT(InTheVicinity(actual[0].relevance,
+            log(4.0 / 2.0) / 4.0 + log(4.0 / 2.0) / 4.0 + log(4.0 / 3.0) / 4.0, 1e-6));
+        ASSERT_EQUAL(server.FindTopDocuments("groomed"s, DocumentStatus::BANNED).size(), size_t(1));
+        ASSERT(server.FindTopDocuments("fluffy -tail"s, DocumentStatus::IRRELEVANT).empty());
+        ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"s, MatchMode::All(),
+            DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT })).size(), size_t(2));
+
+        server.RemoveDocument(4);
+        ASSERT(server.FindTopDocuments("fluffy groomed"s).empty());
+        const auto [words, status] = server.MatchDocument("fluffy cat"s, 2);
+        ASSERT_EQUAL(words.size(), size_t(2));
+        ASSERT(status == DocumentStatus::IRRELEVANT);
+    }
+}
+
+// Проверка декларативных фильтров документов
+void TestDocumentFilter() {
+    { // Фильтр по умолчанию пропускает все документы и работает как обычный предикат
+        const DocumentFilter filter;
+        ASSERT(!filter.HasStatusFilter());
+        ASSERT(filter(-1, DocumentStatus::REMOVED, -100));
+        ASSERT(DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::BANNED })(1, DocumentStatus::BANNED, 0));
+        ASSERT(!DocumentFilter().SetStatus(DocumentStatus::ACTUAL)(1, DocumentStatus::BANNED, 0));
+        ASSERT(!DocumentFilter().SetIds({ 5, 3 })(4, DocumentStatus::ACTUAL, 0));
+        const auto wrong_ratings = []() { DocumentFilter().SetRatingRange(3, 2); };
+        ASSERT_INVALID_ARGUMENT(wrong_ratings);
+        const auto wrong_ids = []() { DocumentFilter().SetIdRange(3, 2); };
+        ASSERT_INVALID_ARGUMENT(wrong_ids);
+    }
+
+    // Документов больше, чем помещается в один блок из 64 битов фильтра
+    IndexOptions options;
+    options.store_positions = true;
+    SearchServer server("and with"s, options);
+    const vector<DocumentStatus> statuses = { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                              DocumentStatus::BANNED, DocumentStatus::REMOVED };
+    for (int id = 0; id < 300; ++id) {
+        const string text = (id % 3 == 0 ? "fluffy cat"s : "groomed dog"s) + (id % 5 == 0 ? " and fancy collar"s : " with tail"s);
+        server.AddDocument(id, text, statuses[id % 7 % 4], { id % 11 - 5 });
+    }
+    server.RemoveDocument(7);
+    server.RemoveDocument(execution::par, 14);
+
+    const vector<DocumentFilter> filters = {
+        DocumentFilter(),
+        DocumentFilter().SetStatus(DocumentStatus::BANNED),
+        DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::REMOVED }).SetRatingRange(-1, 3),
+        DocumentFilter().SetIds({ 21, 0, 42, 150, 7, 299 }),
+        DocumentFilter().SetStatus(DocumentStatus::ACTUAL).SetIdRange(100, 200),
+        // Узкий диапазон id собирается в битовый набор, широкий проверяется у каждого кандидата
+        DocumentFilter().SetIdRange(40, 80),
+        DocumentFilter().SetIdRange(40, 80).SetIds({ 0, 45, 60, 61, 299 }).SetRatingRange(-5, 0),
+        DocumentFilter().SetRatingRange(4, 100).SetIdRange(-100, 1000),
+    };
+    const vector<string> queries = { "fluffy cat -collar"s, "cat tail"s, "groomed dog tail"s, "\"fancy collar\""s };
+    for (const DocumentFilter& filter : filters) {
+        // Те же условия в виде лямбды проходят через общий путь
+        const auto lambda = [&filter](int document_id, DocumentStatus status, int rating) {
+            return filter(document_id, status, rating);
+        };
+        for (const string& query : queries) {
+            // Порядок результатов тоже должен совпадать
+            const vector<int> expected = DocumentIds<vector<int>>(server.FindTopDocuments(query, lambda));
+            ASSERT_EQUAL(DocumentIds<vector<int>>(server.FindTopDocuments(query, filter)), expected);
+            ASSERT_EQUAL(DocumentIds<vector<int>>(server.FindTopDocuments(execution::par, query, filter)), expected);
+            ASSERT_EQUAL(DocumentIds<vector<int>>(server.FindTopDocuments(query, MatchMode::All(), filter)),
+                         DocumentIds<vector<int>>(server.FindTopDocuments(query, MatchMode::All(), lambda)));
+            ASSERT_EQUAL(DocumentIds<vector<int>>(server.FindTopDocuments(Bm25Scorer(), query, filter)),
+                         DocumentIds<vector<int>>(server.FindTopDocuments(Bm25Scorer(), query, lambda)));
+        }
+    }
+
+    { // Удалённые документы не попадают в выдачу через разделы статусов
+        for (const Document& document : server.FindTopDocuments("groomed dog"s, DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::BANNED }))) {
+            ASSERT(document.id != 7 && document.id != 14);
+            ASSERT(document.id % 7 % 4 == 0 || document.id % 7 % 4 == 2);
+        }
+    }
+
+    { // Фильтр по рейтингу и множеству id
+        const vector<Document> documents = server.FindTopDocuments("cat"s,
+            DocumentFilter().SetIds({ 0, 3, 6, 9, 12 }).SetRatingRange(-2, 1));
+        for (const Document& document : documents) {
+            ASSERT(document.rating >= -2 && document.rating <= 1);
+        }
+        ASSERT_EQUAL(DocumentIds(documents).size(), size_t(2));
+    }
+
+    { // Индекс рейтингов следует за изменением рейтинга и удалением документа
+        const DocumentFilter high = DocumentFilter().SetRatingRange(100, 100);
+        ASSERT(server.FindTopDocuments("cat"s, high).empty());
+        server.UpdateDocumentRatings(3, { 100 });
+        server.UpsertDocument(6, "fluffy cat"s, DocumentStatus::ACTUAL, { 100, 100 });
+        ASSERT(DocumentIds(server.FindTopDocuments("cat"s, high)) == (set<int>{ 3, 6 }));
+        server.RemoveDocument(3);
+        ASSERT(DocumentIds(server.FindTopDocuments("cat"s, high)) == (set<int>{ 6 }));
+        ASSERT(server.FindTopDocuments("cat"s, DocumentFilter().SetIds({ 3 })).empty());
+    }
+}
+
+// Проверка списков документов, упорядоченных по вкладу слова
+void TestImpactLists() {
+    { // Список хранит документы с наибольшими частотами, частоты остальных не больше границы хвоста
+        mt19937 generator(37);
+        PostingList postings;
+        ImpactList impacts;
+        const auto check = [&postings, &impacts]() {
+            vector<float> freqs = postings.GetTermFreqs();
+            sort(freqs.rbegin(), freqs.rend());
+            const vector<ImpactList::Entry>& entries = impacts.GetEntries();
+            ASSERT(entries.size() >= ImpactList::CAPACITY / 2 && entries.size() <= ImpactList::CAPACITY);
+            for (size_t i = 0; i < entries.size(); ++i) {
+                ASSERT_EQUAL(*postings.FindTermFreq(entries[i].document), entries[i].term_freq);
+                ASSERT(i == 0 || entries[i - 1].term_freq >= entries[i].term_freq);
+            }
+            ASSERT(entries.back().term_freq <= freqs[entries.size() - 1]);
+            ASSERT(impacts.GetTailBound() >= freqs[entries.size()]);
+        };
+        for (uint32_t document = 0; document < 1000; ++document) {
+            const float term_freq = uniform_real_distribution<float>(0.0f, 1.0f)(generator);
+            postings.Add(document, term_freq);
+            impacts.Add(postings, document, term_freq);
+            ASSERT_EQUAL(impacts.IsEnabled(), postings.size() > ImpactList::MIN_POSTING_COUNT);
+        }
+        check();
+        // Удаление лучших документов перестраивает список
+        for (int i = 0; i < 100; ++i) {
+            const uint32_t document = impacts.GetEntries().front().document;
+            postings.Remove(document);
+            impacts.Remove(postings, document);
+            check();
+        }
+        for (uint32_t document = 0; document < 1000; document += 3) {
+            if (postings.SetTermFreq(document, 1.5)) {
+                impacts.Update(postings, document);
+            }
+        }
+        check();
+        ASSERT_EQUAL(impacts.GetEntries().front().term_freq, 1.5f);
+        while (postings.size() > ImpactList::MIN_POSTING_COUNT / 2) {
+            const uint32_t document = postings.GetDocuments().back();
+            postings.Remove(document);
+            impacts.Remove(postings, document);
+        }
+        const uint32_t last = postings.GetDocuments().back();
+        postings.Remove(last);
+        impacts.Remove(postings, last);
+        ASSERT(!impacts.IsEnabled() && impacts.GetEntries().empty());
+    }
+
+    // Частые слова ищутся по спискам лучших документов с тем же результатом, что и полным просмотром
+    mt19937 generator(41);
+    const vector<string> words = GenerateWords(generator, 30, 6);
+    vector<string> texts;
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 40)(generator);
+        for (int i = 0; i < length; ++i) {
+            // Первые слова встречаются гораздо чаще остальных
+            const int word = min(uniform_int_distribution<int>(0, 29)(generator), uniform_int_distribution<int>(0, 29)(generator));
+            text += words[word] + ' ';
+        }
+        texts.push_back(text);
+    }
+    vector<string> queries;
+    for (int i = 0; i < 10; ++i) {
+        queries.push_back(words[i]);
+        queries.push_back(words[i] + ' ' + words[29 - i]);
+        queries.push_back(words[i] + ' ' + words[i + 1]);
+        queries.push_back(words[i] + " -"s + words[i + 2]);
+    }
+
+    SearchServer server;
+    for (int id = 0; id < 3000; ++id) {
+        server.AddDocument(id, texts[id], id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id });
+    }
+    const auto assert_same = [&server, &queries]() {
+        for (const string& query : queries) {
+            for (const DocumentFilter& filter : { DocumentFilter().SetStatus(DocumentStatus::ACTUAL), DocumentFilter().SetStatus(DocumentStatus::BANNED),
+                                                  DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::BANNED }),
+                                                  DocumentFilter().SetRatingRange(0, 500) }) {
+                const vector<Document> lhs = server.FindTopDocuments(query, filter);
+                const vector<Document> rhs = server.FindTopDocuments(execution::par, query, filter);
+                ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+                for (size_t i = 0; i < lhs.size(); ++i) {
+                    ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+                    ASSERT_EQUAL_HINT(lhs[i].relevance, rhs[i].relevance, query);
+                }
+            }
+        }
+    };
+    assert_same();
+
+    // Списки остаются согласованными при изменениях индекса
+    for (int id = 0; id < 3000; id += 7) {
+        server.RemoveDocument(id);
+    }
+    for (int id = 1; id < 3000; id += 11) {
+        if (id % 7 != 0) {
+            server.UpdateDocumentStatus(id, DocumentStatus::BANNED);
+        }
+    }
+    for (int id = 2; id < 3000; id += 13) {
+        server.UpsertDocument(id, words[id % 5], DocumentStatus::ACTUAL, { id });
+    }
+    assert_same();
+}
+
+// Проверка битовых карт документов частых слов
+void TestRoaringBitmap() {
+    { // Карта совпадает с множеством при переходах контейнеров между массивом и битовой картой
+        mt19937 generator(43);
+        RoaringBitmap bitmap;
+        set<uint32_t> expected;
+        const auto check = [&bitmap, &expected]() {
+            ASSERT_EQUAL(bitmap.size(), expected.size());
+            vector<uint32_t> values;
+            bitmap.AppendTo(values);
+            ASSERT(values == vector<uint32_t>(expected.begin(), expected.end()));
+        };
+        for (int i = 0; i < 20000; ++i) {
+            // Первые 65536 чисел плотные, остальные разрежены
+            const uint32_t value = i % 2 == 0 ? uniform_int_distribution<uint32_t>(0, 65535)(generator)
+                                              : uniform_int_distribution<uint32_t>(65536, 1u << 24)(generator);
+            ASSERT_EQUAL(bitmap.Add(value), expected.insert(value).second);
+        }
+        check();
+        for (uint32_t value = 0; value < 70000; ++value) {
+            ASSERT_EQUAL(bitmap.Contains(value), expected.count(value) > 0);
+        }
+        for (int i = 0; i < 30000; ++i) {
+            const uint32_t value = uniform_int_distribution<uint32_t>(0, 65535)(generator);
+            ASSERT_EQUAL(bitmap.Remove(value), expected.erase(value) > 0);
+        }
+        check();
+
+        RoaringBitmap other;
+        set<uint32_t> other_expected;
+        for (int i = 0; i < 10000; ++i) {
+            const uint32_t value = uniform_int_distribution<uint32_t>(0, 200000)(generator);
+            other.Add(value);
+            other_expected.insert(value);
+        }
+        vector<uint32_t> intersection;
+        set_intersection(expected.begin(), expected.end(), other_expected.begin(), other_expected.end(), back_inserter(intersection));
+        vector<uint32_t> values;
+        RoaringBitmap::And(bitmap, other).AppendTo(values);
+        ASSERT(values == intersection);
+    }
+
+    { // Список строит карту при росте и отказывается от неё при сокращении
+        PostingList postings;
+        for (uint32_t document = 0; document < PostingList::DENSE_MIN_SIZE + 100; ++document) {
+            postings.Add(document * 3, 1.0);
+            ASSERT_EQUAL(postings.GetBitmap() != nullptr, postings.size() >= PostingList::DENSE_MIN_SIZE);
+        }
+        ASSERT(postings.Contains(300) && !postings.Contains(301));
+
+        // Копия получает собственную карту
+        PostingList copy = postings;
+        ASSERT(copy.GetBitmap() != nullptr && copy.GetBitmap() != postings.GetBitmap());
+        copy.Remove(300);
+        ASSERT(!copy.Contains(300) && postings.Contains(300));
+        copy = postings;
+        ASSERT(copy.Contains(300) && copy.GetDocuments() == postings.GetDocuments());
+
+        postings.Remove(300);
+        ASSERT(!postings.Contains(300));
+        while (postings.size() >= PostingList::SPARSE_MAX_SIZE) {
+            ASSERT(postings.GetBitmap() != nullptr);
+            postings.Remove(postings.GetDocuments().back());
+        }
+        ASSERT(postings.GetBitmap() == nullptr);
+        ASSERT(postings.Contains(3) && !postings.Contains(300));
+    }
+
+    { // Исключение документов карты из накопителя оценок
+        const ScoreAccumulator::Scope scope;
+        ScoreAccumulator& accumulator = scope.Get();
+        accumulator.Reserve(1000);
+        const vector<uint32_t> documents = { 1, 5, 64, 65, 130, 999 };
+        const vector<float> term_freqs(documents.size(), 1.0f);
+        accumulator.Add(documents.data(), term_freqs.data(), documents.size(), 2.0);
+        RoaringBitmap excluded;
+        for (uint32_t document : { 5u, 65u, 66u, 999u }) {
+            excluded.Add(document);
+        }
+        accumulator.Remove(excluded);
+        vector<pair<uint32_t, double>> scores;
+        accumulator.Drain([&scores](uint32_t document, double score) { scores.push_back({ document, score }); });
+        ASSERT((scores == vector<pair<uint32_t, double>>{ { 1, 2.0 }, { 64, 2.0 }, { 130, 2.0 } }));
+    }
+
+    // Сервер с картами частых слов находит то же, что и сегментированный, в сегментах которого карт нет
+    mt19937 generator(47);
+    const vector<string> words = GenerateWords(generator, 20, 6);
+    SearchServer server;
+    ShardedSearchServer sharded(8);
+    for (int id = 0; id < 12000; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 12)(generator);
+        for (int i = 0; i < length; ++i) {
+            const int word = min(uniform_int_distribution<int>(0, 19)(generator), uniform_int_distribution<int>(0, 19)(generator));
+            text += words[word] + ' ';
+        }
+        const DocumentStatus status = id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, text, status, { id % 100 });
+        sharded.AddDocument(id, text, status, { id % 100 });
+    }
+    for (int id = 0; id < 12000; id += 9) {
+        server.RemoveDocument(id);
+        sharded.RemoveDocument(id);
+    }
+
+    const auto scores = [](const vector<Document>& result) {
+        vector<pair<double, int>> values;
+        for (const Document& document : result) {
+            values.push_back({ document.relevance, document.rating });
+        }
+        return values;
+    };
+    const auto assert_same = [&scores](const vector<Document>& lhs, const vector<Document>& rhs, const string& query) {
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+        const auto lhs_scores = scores(lhs);
+        const auto rhs_scores = scores(rhs);
+        for (size_t i = 0; i < lhs_scores.size(); ++i) {
+            ASSERT_HINT(InTheVicinity(lhs_scores[i].first, rhs_scores[i].first, 1e-9), query);
+            ASSERT_EQUAL_HINT(lhs_scores[i].second, rhs_scores[i].second, query);
+        }
+    };
+    for (int i = 0; i < 5; ++i) {
+        for (const string& query : { words[15 + i] + " -"s + words[i],
+                                     words[10 + i] + ' ' + words[15 + i] + " -"s + words[i] + " -"s + words[i + 1],
+                                     words[i] + ' ' + words[i + 1],
+                                     words[i] + ' ' + words[i + 1] + ' ' + words[10 + i] + " -"s + words[i + 2] }) {
+            assert_same(server.FindTopDocuments(query), sharded.FindTopDocuments(query), query);
+            assert_same(server.FindTopDocuments(query, MatchMode::All()), sharded.FindTopDocuments(query, MatchMode::All()), query);
+            assert_same(server.FindTopDocuments(query, MatchMode::AtLeast(2)), sharded.FindTopDocuments(query, MatchMode::AtLeast(2)), query);
+            assert_same(server.FindTopDocuments(query, DocumentStatus::BANNED), sharded.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        }
+    }
+
+    // Карты добавляются к массивам списков, а не заменяют их, и их память учитывается отдельно
+    const MemoryStats server_memory = server.GetMemoryStats();
+    const MemoryStats sharded_memory = sharded.GetMemoryStats();
+    ASSERT(server_memory.posting_bitmaps.count > 0 && server_memory.posting_bitmaps.bytes > 0);
+    ASSERT(server_memory.posting_bitmaps.count <= server_memory.postings.count);
+    ASSERT_EQUAL(sharded_memory.posting_bitmaps.count, size_t(0));
+    ASSERT_EQUAL(sharded_memory.posting_bitmaps.bytes, size_t(0));
+    ASSERT_EQUAL(server_memory.postings.count, sharded_memory.postings.count);
+}
+
+// Проверка сегментированного поискового сервера
+void TestShardedSearchServer() {
+    const auto wrong_shard_count = []() { ShardedSearchServer server(0); };
+    ASSERT_INVALID_ARGUMENT(wrong_shard_count);
+
+    mt19937 generator(17);
+    const vector<string> words = GenerateWords(generator, 200, 6);
+    const vector<string> documents = GeneratePhrases(generator, words, 600, 12);
+    const vector<string> queries = GeneratePhrases(generator, words, 100, 4, 0.2);
+
+    SearchServer server("and with"s);
+    ShardedSearchServer sharded(4, "and with"s);
+    ASSERT_EQUAL(sharded.GetShardCount(), size_t(4));
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentStatus status = static_cast<DocumentStatus>(i % 3);
+        const vector<int> ratings = GenerateRatings(generator, 3, -10, 10);
+        server.AddDocument(static_cast<int>(i), documents[i], status, ratings);
+        sharded.AddDocument(static_cast<int>(i), documents[i], status, ratings);
+    }
+    for (int id = 0; id < 600; id += 7) {
+        server.RemoveDocument(id);
+        sharded.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(sharded.GetDocumentCount(), server.GetDocumentCount());
+    ASSERT_EQUAL(sharded.GetScoringContext().document_count, server.GetScoringContext().document_count);
+    ASSERT(InTheVicinity(sharded.GetScoringContext().average_document_length, server.GetScoringContext().average_document_length, 1e-9));
+
+    // При равной релевантности и рейтинге порядок документов не определён, поэтому сравниваются они
+    const auto scores = [](const vector<Document>& result) {
+        vector<pair<double, int>> values;
+        for (const Document& document : result) {
+            values.push_back({ document.relevance, document.rating });
+        }
+        return values;
+    };
+    const auto assert_same = [&scores](const vector<Document>& lhs, const vector<Document>& rhs, const string& query) {
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+        const auto lhs_scores = scores(lhs);
+        const auto rhs_scores = scores(rhs);
+        for (size_t i = 0; i < lhs_scores.size(); ++i) {
+            ASSERT_HINT(InTheVicinity(lhs_scores[i].first, rhs_scores[i].first, 1e-9), query);
+            ASSERT_EQUAL_HINT(lhs_scores[i].second, rhs_scores[i].second, query);
+        }
+    };
+    for (const string& query : queries) {
+        assert_same(sharded.FindTopDocuments(query), server.FindTopDocuments(query), query);
+        assert_same(sharded.FindTopDocuments(query, DocumentStatus::BANNED), server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        assert_same(sharded.FindTopDocuments(query, MatchMode::AtLeast(2)), server.FindTopDocuments(query, MatchMode::AtLeast(2)), query);
+        assert_same(sharded.FindTopDocuments(Bm25Scorer(), query), server.FindTopDocuments(Bm25Scorer(), query), query);
+        const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+        assert_same(sharded.FindTopDocuments(query, even), server.FindTopDocuments(query, even), query);
+    }
+
+    { // Раскрытия шаблона в разных сегментах взвешиваются по частотам во всех сегментах
+        const string query = words[0].substr(0, 2) + "* "s + words[1];
+        assert_same(sharded.FindTopDocuments(query), server.FindTopDocuments(query), query);
+        assert_same(sharded.FindTopDocuments(Bm25Scorer(), query), server.FindTopDocuments(Bm25Scorer(), query), query);
+    }
+
+    { // Документ ищется в своём сегменте
+        const string query = words[0] + " "s + words[1];
+        const auto [sharded_words, sharded_status] = sharded.MatchDocument(query, 1);
+        const auto [expected_words, expected_status] = server.MatchDocument(query, 1);
+        ASSERT_EQUAL(sharded_words, vector<string>(expected_words.begin(), expected_words.end()));
+        ASSERT(sharded_status == expected_status);
+    }
+
+    { // Ошибка в запросе доходит до вызывающего после завершения поиска во всех сегментах
+        const auto invalid_query = [&sharded]() { sharded.FindTopDocuments("cat --dog"s); };
+        ASSERT_INVALID_ARGUMENT(invalid_query);
+    }
+
+    { // Документы добавляются в сегменты параллельно с поиском
+        ShardedSearchServer concurrent(3);
+        vector<thread> writers;
+        for (int t = 0; t < 4; ++t) {
+            writers.emplace_back([&concurrent, &documents, t]() {
+                for (int id = t; id < 400; id += 4) {
+                    concurrent.AddDocument(id, documents[id], DocumentStatus::ACTUAL, { id });
+                }
+            });
+        }
+        for (const string& query : queries) {
+            concurrent.FindTopDocuments(query);
+        }
+        for (thread& writer : writers) {
+            writer.join();
+        }
+        ASSERT_EQUAL(concurrent.GetDocumentCount(), 400);
+    }
+}
+
+
+// Проверка учёта памяти индекса
+void TestMemoryStats() {
+    { // Аллокатор считает выделенные байты, копия контейнера получает собственный счётчик
+        vector<int, CountingAllocator<int>> numbers;
+        numbers.reserve(10);
+        const AllocationCounter& counter = *numbers.get_allocator().GetCounter();
+        ASSERT_EQUAL(counter.GetBytes(), 10 * sizeof(int));
+        ASSERT_EQUAL(counter.GetAllocationCount(), size_t(1));
+
+        const vector<int, CountingAllocator<int>> copy = numbers;
+        ASSERT(copy.get_allocator() != numbers.get_allocator());
+        vector<int, CountingAllocator<int>> moved = move(numbers);
+        ASSERT_EQUAL(moved.get_allocator().GetCounter()->GetBytes(), 10 * sizeof(int));
+        moved.clear();
+        moved.shrink_to_fit();
+        ASSERT_EQUAL(moved.get_allocator().GetCounter()->GetBytes(), size_t(0));
+    }
+
+    SearchServer empty;
+    ASSERT_EQUAL(empty.GetMemoryStats().GetTotalBytes(), size_t(0));
+
+    IndexOptions options;
+    options.max_typo_distance = 1;
+    SearchServer server("and in"s, options);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+    server.AddDocument(4, "extraordinarilylongword"s, DocumentStatus::ACTUAL, { 1 });
+
+    const MemoryStats stats = server.GetMemoryStats();
+    // Слова: white cat fashionable collar fluffy tail groomed dog expressive eyes extraordinarilylongword
+    ASSERT_EQUAL(stats.dictionary.count, size_t(11));
+    ASSERT_EQUAL(stats.term_strings.count, size_t(11));
+    // Только длинное слово не помещается в объект строки
+    ASSERT_EQUAL(stats.term_strings.bytes, "extraordinarilylongword"s.size() + 1);
+    ASSERT_EQUAL(stats.postings.count, size_t(12));
+    ASSERT_EQUAL(stats.forward_index.count, size_t(12));
+    ASSERT_EQUAL(stats.metadata.count, size_t(4));
+    ASSERT_EQUAL(stats.stop_words.count, size_t(2));
+    ASSERT(stats.dictionary.bytes > 0 && stats.postings.bytes > 0 && stats.forward_index.bytes > 0 && stats.metadata.bytes > 0);
+    ASSERT(stats.typo_index.count > 0 && stats.typo_index.bytes > 0);
+    ASSERT(stats.allocator_overhead > 0 && stats.allocation_count > 0);
+
+    for (int id = 1; id <= 4; ++id) {
+        server.RemoveDocument(id);
+    }
+    const MemoryStats removed = server.GetMemoryStats();
+    ASSERT_EQUAL(removed.postings.count, size_t(0));
+    ASSERT_EQUAL(removed.postings.bytes, size_t(0));
+    ASSERT_EQUAL(removed.forward_index.bytes, size_t(0));
+    ASSERT_EQUAL(removed.metadata.count, size_t(0));
+    // Словарь слов не сокращается при удалении документов
+    ASSERT_EQUAL(removed.term_strings.count, size_t(11));
+
+    ShardedSearchServer sharded(2);
+    sharded.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    sharded.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(sharded.GetMemoryStats().metadata.count, size_t(2));
+    ASSERT_EQUAL(sharded.GetMemoryStats().postings.count, size_t(4));
+}
+
+// Проверка арены временных структур запроса
+void TestQueryArena() {
+    { // Память вложенной области освобождается только с внешней областью
+        const QueryArena::Scope outer;
+        pmr::vector<int> numbers({ 1, 2, 3 }, outer.GetResource());
+        {
+            const QueryArena::Scope inner;
+            ASSERT_EQUAL(inner.GetResource(), outer.GetResource());
+            pmr::vector<int> other(1000, 7, inner.GetResource());
+        }
+        pmr::vector<int> after(100, 5, outer.GetResource());
+        ASSERT_EQUAL(numbers[2], 3);
+    }
+
+    { // Блок арены растёт до размера самого большого запроса
+        QueryArena& arena = QueryArena::ForCurrentThread();
+        const size_t large_size = arena.GetCapacity() * 2;
+        const size_t heap_allocations = arena.GetHeapAllocationCount();
+        {
+            const QueryArena::Scope scope;
+            pmr::vector<char> large(large_size, 'a', scope.GetResource());
+        }
+        ASSERT(arena.GetHeapAllocationCount() > heap_allocations);
+        ASSERT(arena.GetCapacity() >= large_size);
+        const size_t grown_allocations = arena.GetHeapAllocationCount();
+        {
+            const QueryArena::Scope scope;
+            pmr::vector<char> large(large_size, 'a', scope.GetResource());
+        }
+        ASSERT_EQUAL(arena.GetHeapAllocationCount(), grown_allocations);
+    }
+
+    IndexOptions options;
+    options.store_positions = true;
+    options.max_typo_distance = 1;
+    SearchServer server("and in"s, options);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(4, "white dog with black collar"s, DocumentStatus::BANNED, { 1 });
+
+    const vector<string> queries = { "fluffy cat -collar"s, "white col* dg~"s, "\"white cat\" tail"s, "cat dog"s };
+    vector<vector<Document>> expected;
+    for (const string& query : queries) {
+        expected.push_back(server.FindTopDocuments(query));
+    }
+    ASSERT_EQUAL(expected[0].size(), size_t(1));
+    ASSERT_EQUAL(expected[0][0].id, 2);
+    // Фраза отбирает только документы, в которых она есть
+    ASSERT_EQUAL(expected[2].size(), size_t(1));
+    ASSERT_EQUAL(expected[2][0].id, 1);
+
+    // Повторные запросы не обращаются к куче за временными структурами и дают те же результаты
+    const QueryArena& arena = QueryArena::ForCurrentThread();
+    const size_t heap_allocations = arena.GetHeapAllocationCount();
+    for (int i = 0; i < 100; ++i) {
+        for (size_t j = 0; j < queries.size(); ++j) {
+            const vector<Document> documents = server.FindTopDocuments(queries[j]);
+            ASSERT_EQUAL(documents.size(), expected[j].size());
+            for (size_t k = 0; k < documents.size(); ++k) {
+                ASSERT_EQUAL(documents[k].id, expected[j][k].id);
+            }
+            server.MatchDocument(queries[j], 1);
+        }
+    }
+    ASSERT_EQUAL(arena.GetHeapAllocationCount(), heap_allocations);
+
+    // У каждого потока своя арена
+    const QueryArena* other_arena = nullptr;
+    thread([&other_arena, &server]() {
+        other_arena = &QueryArena::ForCurrentThread();
+        ASSERT_EQUAL(server.FindTopDocuments("fluffy cat -collar"s).size(), size_t(1));
+    }).join();
+    ASSERT(other_arena != &arena);
+}
+
+// Проверка изменения статуса и рейтинга документа без повторной индексации
+void TestUpdateDocumentMetadata() {
+    mt19937 generator(23);
+    const vector<string> words = GenerateWords(generator, 50, 5);
+    const vector<string> texts = GeneratePhrases(generator, words, 100, 8);
+    const vector<string> queries = GeneratePhrases(generator, words, 20, 2);
+
+    SearchServer server;
+    SearchServer expected;
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+    // Результат совпадает с переиндексацией документов с новыми статусом и рейтингом
+    for (int id = 0; id < 100; ++id) {
+        const DocumentStatus status = (id % 3 == 0) ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.UpdateDocumentStatus(id, status);
+        server.UpdateDocumentRatings(id, { id % 10, 2 });
+        expected.AddDocument(id, texts[id], status, { id % 10, 2 });
+    }
+    for (const string& query : queries) {
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const vector<Document> lhs = server.FindTopDocuments(query, status);
+            const vector<Document> rhs = expected.FindTopDocuments(query, status);
+            ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+            for (size_t i = 0; i < lhs.size(); ++i) {
+                ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+                ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, query);
+            }
+        }
+    }
+
+    { // Пока списки документов не перенесены в разделы новых статусов, результат тот же, что после переноса
+        const vector<string> long_texts = GeneratePhrases(generator, words, 2000, 8);
+        vector<string> long_queries = GeneratePhrases(generator, words, 10, 2);
+        for (int i = 0; i < 10; ++i) {
+            long_queries.push_back(words[i] + " -"s + words[i + 10]);
+            long_queries.push_back("\""s + long_texts[i].substr(0, long_texts[i].find(' ', long_texts[i].find(' ') + 1)) + "\""s);
+        }
+        const auto final_status = [](int id) {
+            if (id % 7 == 0) {
+                return DocumentStatus::REMOVED;
+            }
+            return id % 5 == 0 ? DocumentStatus::BANNED : (id % 5 == 1 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL);
+        };
+
+        IndexOptions long_options;
+        long_options.store_positions = true;
+        // Не переносит до конца проверки, переносит часто и переносит сразу
+        vector<SearchServer> servers;
+        for (size_t max_pending : { size_t(1) << 20, size_t(16), size_t(0) }) {
+            long_options.max_pending_status_moves = max_pending;
+            servers.emplace_back(""s, long_options);
+        }
+        long_options.max_pending_status_moves = 0;
+        SearchServer reference(""s, long_options);
+        for (int id = 0; id < 2000; ++id) {
+            for (SearchServer& server : servers) {
+                server.AddDocument(id, long_texts[id], DocumentStatus::ACTUAL, { id });
+            }
+            if (id % 3 != 2) {
+                reference.AddDocument(id, long_texts[id], final_status(id), { id });
+            }
+        }
+        for (int id = 0; id < 2000; ++id) {
+            for (SearchServer& server : servers) {
+                // Часть документов меняет статус несколько раз, в том числе обратно
+                if (id % 11 == 0) {
+                    server.UpdateDocumentStatus(id, DocumentStatus::BANNED);
+                    server.UpdateDocumentStatus(id, DocumentStatus::ACTUAL);
+                }
+                server.UpdateDocumentStatus(id, final_status(id));
+            }
+        }
+        // Удаляются и заменяются документы, чьи списки ещё не перенесены
+        for (int id = 2; id < 2000; id += 3) {
+            for (SearchServer& server : servers) {
+                server.RemoveDocument(id);
+            }
+        }
+        for (int id = 0; id < 20; ++id) {
+            for (SearchServer& server : servers) {
+                server.UpsertDocument(id, long_texts[id + 1000], final_status(id), { id });
+            }
+            reference.UpsertDocument(id, long_texts[id + 1000], final_status(id), { id });
+        }
+
+        const auto check = [&long_queries, &reference](const SearchServer& server) {
+            for (const string& query : long_queries) {
+                for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED }) {
+                    ASSERT_EQUAL_HINT(DocumentIds<vector<int>>(server.FindTopDocuments(query, status)),
+                                      DocumentIds<vector<int>>(reference.FindTopDocuments(query, status)), query);
+                    ASSERT_EQUAL_HINT(DocumentIds<vector<int>>(server.FindTopDocuments(query, MatchMode::All(), status)),
+                                      DocumentIds<vector<int>>(reference.FindTopDocuments(query, MatchMode::All(), status)), query);
+                    ASSERT_EQUAL_HINT(DocumentIds<vector<int>>(server.FindTopDocuments(execution::par, query, status)),
+                                      DocumentIds<vector<int>>(reference.FindTopDocuments(execution::par, query, status)), query);
+                }
+                const DocumentFilter filter = DocumentFilter().SetStatuses({ DocumentStatus::ACTUAL, DocumentStatus::BANNED }).SetRatingRange(300, 1500);
+                ASSERT_EQUAL_HINT(DocumentIds<vector<int>>(server.FindTopDocuments(query, filter)),
+                                  DocumentIds<vector<int>>(reference.FindTopDocuments(query, filter)), query);
+                const auto predicate = [](int id, DocumentStatus status, int) { return status != DocumentStatus::ACTUAL && id % 2 == 0; };
+                ASSERT_EQUAL_HINT(DocumentIds<vector<int>>(server.FindTopDocuments(query, predicate)),
+                                  DocumentIds<vector<int>>(reference.FindTopDocuments(query, predicate)), query);
+            }
+            for (int id : reference) {
+                ASSERT(server.MatchDocument(long_queries[0], id) == reference.MatchDocument(long_queries[0], id));
+                ASSERT(server.MatchDocument(long_queries[10], id) == reference.MatchDocument(long_queries[10], id));
+            }
+        };
+        for (const SearchServer& server : servers) {
+            check(server);
+        }
+
+        // Перенумерация при удалении переносит отложенные списки
+        for (int id = 0; id < 2000; id += 3) {
+            for (SearchServer& server : servers) {
+                server.RemoveDocument(id);
+            }
+            reference.RemoveDocument(id);
+        }
+        for (SearchServer& server : servers) {
+            server.UpdateDocumentStatus(1, DocumentStatus::ACTUAL);
+        }
+        reference.UpdateDocumentStatus(1, DocumentStatus::ACTUAL);
+        for (const SearchServer& server : servers) {
+            check(server);
+        }
+    }
+
+    IndexOptions options;
+    options.store_positions = true;
+    SearchServer pets(""s, options);
+    pets.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    pets.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    pets.UpdateDocumentStatus(2, DocumentStatus::BANNED);
+    ASSERT_EQUAL(pets.FindTopDocuments("cat"s).size(), size_t(1));
+    ASSERT_EQUAL(pets.FindTopDocuments("cat"s, DocumentStatus::BANNED)[0].id, 2);
+    ASSERT(get<1>(pets.MatchDocument("fluffy"s, 2)) == DocumentStatus::BANNED);
+    // Позиции слов переносятся вместе с документом
+    ASSERT_EQUAL(pets.FindTopDocuments("\"fluffy tail\""s, DocumentStatus::BANNED).size(), size_t(1));
+    pets.UpdateDocumentStatus(2, DocumentStatus::ACTUAL);
+    pets.UpdateDocumentRatings(1, { 20 });
+    const vector<Document> found = pets.FindTopDocuments("cat"s, [](int, DocumentStatus, int rating) { return rating > 10; });
+    ASSERT_EQUAL(found.size(), size_t(1));
+    ASSERT_EQUAL(found[0].rating, 20);
+
+    try {
+        pets.UpdateDocumentStatus(3, DocumentStatus::BANNED);
+        ASSERT_HINT(false, "Unknown document must throw"s);
+    }
+    catch (const out_of_range&) {
+    }
+    pets.RemoveDocument(1);
+    try {
+        pets.UpdateDocumentRatings(1, { 1 });
+        ASSERT_HINT(false, "Removed document must throw"s);
+    }
+    catch (const out_of_range&) {
+    }
+
+    ShardedSearchServer sharded(4);
+    sharded.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    sharded.AddDocument(2, "fluffy cat"s, DocumentStatus::ACTUAL, { 1 });
+    sharded.UpdateDocumentStatus(1, DocumentStatus::BANNED);
+    sharded.UpdateDocumentRatings(2, { 5 });
+    ASSERT_EQUAL(sharded.FindTopDocuments("cat"s).size(), size_t(1));
+    ASSERT_EQUAL(sharded.FindTopDocuments("cat"s)[0].rating, 5);
+}
+
+// Проверка замены документа с тем же id
+void TestUpsertDocument() {
+    mt19937 generator(29);
+    const vector<string> words = GenerateWords(generator, 60, 6);
+    const vector<string> texts = GeneratePhrases(generator, words, 100, 12);
+    const vector<string> edits = GeneratePhrases(generator, words, 100, 3);
+    vector<string> queries = GeneratePhrases(generator, words, 30, 3);
+    for (int i = 0; i < 10; ++i) {
+        queries.push_back("\""s + texts[i].substr(0, texts[i].find(' ', texts[i].find(' ') + 1)) + "\""s);
+        queries.push_back(words[i] + "~"s);
+    }
+
+    IndexOptions options;
+    options.store_positions = true;
+    options.store_documents = true;
+    options.max_typo_distance = 1;
+    SearchServer server("and"s, options);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { 1 });
+    }
+
+    // Результат совпадает с индексом, построенным сразу из новых текстов
+    SearchServer expected("and"s, options);
+    for (int id = 0; id < 110; ++id) {
+        string text;
+        if (id >= 100) {
+            text = edits[id - 100];
+        }
+        else if (id % 4 == 0) {
+            text = texts[id];
+        }
+        else if (id % 4 == 1) {
+            text = texts[id] + ' ' + edits[id];
+        }
+        else if (id % 4 == 2) {
+            text = edits[id] + ' ' + texts[id].substr(0, texts[id].size() / 2);
+        }
+        const DocumentStatus status = (id % 5 == 0) ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.UpsertDocument(id, text, status, { id % 7 });
+        expected.AddDocument(id, text, status, { id % 7 });
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+    ASSERT_EQUAL(server.GetScoringContext().average_document_length, expected.GetScoringContext().average_document_length);
+    for (const string& word : words) {
+        ASSERT_EQUAL_HINT(server.GetDocumentFreq(word), expected.GetDocumentFreq(word), word);
+    }
+    for (const string& query : queries) {
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const vector<Document> lhs = server.FindTopDocuments(query, status);
+            const vector<Document> rhs = expected.FindTopDocuments(query, status);
+            ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+            for (size_t i = 0; i < lhs.size(); ++i) {
+                ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+                ASSERT_EQUAL_HINT(lhs[i].relevance, rhs[i].relevance, query);
+                ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, query);
+            }
+        }
+    }
+    for (int id = 0; id < 110; ++id) {
+        ASSERT(server.GetWordFrequencies(id) == expected.GetWordFrequencies(id));
+        ASSERT_EQUAL(server.GetDocumentText(id), expected.GetDocumentText(id));
+    }
+
+    // Ошибочный текст не меняет документ
+    const auto invalid_text = [&server]() { server.UpsertDocument(1, "white c\x12t"s, DocumentStatus::ACTUAL, {}); };
+    ASSERT_INVALID_ARGUMENT(invalid_text);
+    ASSERT(server.GetWordFrequencies(1) == expected.GetWordFrequencies(1));
+    const auto negative_id = [&server]() { server.UpsertDocument(-1, "white cat"s, DocumentStatus::ACTUAL, {}); };
+    ASSERT_INVALID_ARGUMENT(negative_id);
+}
+
+// Проверка хранилища текстов документов
+void TestDocumentStore() {
+    mt19937 generator(17);
+    string random_text(5000, ' ');
+    for (char& c : random_text) {
+        c = static_cast<char>(uniform_int_distribution<int>(0, 255)(generator));
+    }
+    string repeated;
+    for (int i = 0; i < 500; ++i) {
+        repeated += "white cat and fashionable collar "s + to_string(i % 7) + ' ';
+    }
+    for (const string& text : { ""s, "a"s, "abcd"s, string(1000, 'x'), random_text, repeated }) {
+        const string compressed = CompressBlock(text);
+        ASSERT_EQUAL(DecompressBlock(compressed, text.size()), text);
+        ASSERT_EQUAL(DecompressBlock(compressed, text.size() / 2), text.substr(0, text.size() / 2));
+    }
+    // Повторяющийся текст сжимается
+    ASSERT(CompressBlock(repeated).size() * 10 < repeated.size());
+    ASSERT(CompressBlock(string(1000, 'x')).size() < 20);
+
+    {
+        DocumentStore store(64);
+        vector<string> texts;
+        for (int id = 0; id < 100; ++id) {
+            texts.push_back("document "s + to_string(id) + (id % 3 == 0 ? " fluffy cat fluffy tail"s : " groomed dog"s));
+            store.Add(id, texts.back());
+        }
+        for (int id = 0; id < 100; ++id) {
+            ASSERT_EQUAL(store.Get(id), texts[id]);
+        }
+        for (int id = 0; id < 100; id += 2) {
+            store.Remove(id);
+        }
+        ASSERT_EQUAL(store.GetDocumentCount(), size_t(50));
+        ASSERT(!store.Contains(10) && store.Contains(11));
+        store.Add(10, "new text of ten"s);
+        ASSERT_EQUAL(store.Get(10), "new text of ten"s);
+        ASSERT_EQUAL(store.Get(99), texts[99]);
+        try {
+            store.Get(12);
+            ASSERT_HINT(false, "Removed document must throw"s);
+        }
+        catch (const out_of_range&) {
+        }
+    }
+
+    IndexOptions options;
+    options.store_documents = true;
+    options.document_block_size = 32;
+    SearchServer server("and"s, options);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    string owned = "fluffy cat fluffy tail"s;
+    server.AddDocument(2, move(owned), DocumentStatus::ACTUAL, { 7, 2, 7 });
+    const string kept = "groomed dog expressive eyes"s;
+    server.AddDocument(3, kept, DocumentStatus::BANNED, { 5 });
+    server.AddDocuments({ { 4, "well groomed starling"sv, DocumentStatus::ACTUAL, { 1 } } });
+    ASSERT_EQUAL(server.GetDocumentText(1), "white cat and fashionable collar"s);
+    ASSERT_EQUAL(server.GetDocumentText(2), "fluffy cat fluffy tail"s);
+    ASSERT_EQUAL(server.GetDocumentText(3), kept);
+    ASSERT_EQUAL(server.GetDocumentText(4), "well groomed starling"s);
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy"s)[0].id, 2);
+    ASSERT_EQUAL(server.GetMemoryStats().documents.count, size_t(4));
+    ASSERT(server.GetMemoryStats().documents.bytes > 0);
+
+    server.RemoveDocument(2);
+    ASSERT_EQUAL(server.GetMemoryStats().documents.count, size_t(3));
+    try {
+        server.GetDocumentText(2);
+        ASSERT_HINT(false, "Removed document must throw"s);
+    }
+    catch (const out_of_range&) {
+    }
+
+    SearchServer without_store;
+    without_store.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    const auto get_text = [&without_store]() { without_store.GetDocumentText(1); };
+    ASSERT_INVALID_ARGUMENT(get_text);
+    ASSERT_EQUAL(without_store.GetMemoryStats().documents.bytes, size_t(0));
+
+    ShardedSearchServer sharded(2, "and"s, options);
+    sharded.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    sharded.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(sharded.GetDocumentText(2), "black dog"s);
+}
+
+// Проверка пакетного добавления документов
+void TestBulkAddDocuments() {
+    mt19937 generator(29);
+    const vector<string> words = GenerateWords(generator, 100, 6);
+    const vector<string> texts = GeneratePhrases(generator, words, 300, 10);
+    const vector<string> queries = GeneratePhrases(generator, words, 30, 3);
+
+    IndexOptions options;
+    options.store_positions = true;
+    SearchServer expected("and in"s, options);
+    SearchServer bulk("and in"s, options);
+    vector<NewDocument> documents;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        const DocumentStatus status = static_cast<DocumentStatus>(i % 2);
+        expected.AddDocument(static_cast<int>(i), texts[i], status, { static_cast<int>(i % 7) });
+        documents.push_back({ static_cast<int>(i), texts[i], status, { static_cast<int>(i % 7) } });
+    }
+    bulk.AddDocuments(documents);
+
+    // Результат совпадает с добавлением документов по одному
+    ASSERT_EQUAL(bulk.GetDocumentCount(), expected.GetDocumentCount());
+    for (const string& query : queries) {
+        const vector<Document> lhs = bulk.FindTopDocuments(query);
+        const vector<Document> rhs = expected.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+            ASSERT_EQUAL_HINT(lhs[i].relevance, rhs[i].relevance, query);
+        }
+    }
+    const string phrase = "\""s + texts[5].substr(0, texts[5].find(' ', texts[5].find(' ') + 1)) + "\""s;
+    ASSERT_EQUAL(bulk.FindTopDocuments(phrase, DocumentStatus::IRRELEVANT).size(), expected.FindTopDocuments(phrase, DocumentStatus::IRRELEVANT).size());
+
+    // Ошибочный документ в пакете не даёт добавить ни один документ
+    const auto duplicate_id = [&bulk]() { bulk.AddDocuments({ { 1000, "cat"s, DocumentStatus::ACTUAL, {} }, { 1000, "dog"s, DocumentStatus::ACTUAL, {} } }); };
+    ASSERT_INVALID_ARGUMENT(duplicate_id);
+    const auto invalid_word = [&bulk]() { bulk.AddDocuments({ { 1000, "cat"s, DocumentStatus::ACTUAL, {} }, { 1001, "d\x12og"s, DocumentStatus::ACTUAL, {} } }); };
+    ASSERT_INVALID_ARGUMENT(invalid_word);
+    ASSERT_EQUAL(bulk.GetDocumentCount(), expected.GetDocumentCount());
+}
+
+#ifdef __linux__
+// Проверка журнала упреждающей записи
+void TestWriteAheadLog() {
+    const string check = "123456789"s;
+    ASSERT_EQUAL(ComputeCrc32(reinterpret_cast<const uint8_t*>(check.data()), check.size()), 0xCBF43926u);
+
+    const string path = "/tmp/search_server_test_"s + to_string(getpid()) + ".wal"s;
+    unlink(path.c_str());
+
+    mt19937 generator(31);
+    const vector<string> words = GenerateWords(generator, 100, 6);
+    const vector<string> texts = GeneratePhrases(generator, words, 200, 10);
+    const vector<string> queries = GeneratePhrases(generator, words, 30, 3);
+
+    SearchServer expected;
+    {
+        DurableSearchServer server(path);
+        for (int id = 0; id < 100; ++id) {
+            server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+            expected.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        }
+        vector<NewDocument> documents;
+        for (int id = 100; id < 200; ++id) {
+            documents.push_back({ id, texts[id], DocumentStatus::BANNED, { id } });
+        }
+        server.AddDocuments(documents);
+        expected.AddDocuments(documents);
+        for (int id = 0; id < 200; id += 3) {
+            server.RemoveDocument(id);
+            expected.RemoveDocument(id);
+        }
+        for (int id = 1; id < 200; id += 6) {
+            server.UpdateDocumentStatus(id, DocumentStatus::IRRELEVANT);
+            server.UpdateDocumentRatings(id, { -id });
+            expected.UpdateDocumentStatus(id, DocumentStatus::IRRELEVANT);
+            expected.UpdateDocumentRatings(id, { -id });
+        }
+        for (int id = 2; id < 200; id += 6) {
+            server.UpsertDocument(id, texts[id + 1], DocumentStatus::ACTUAL, { id });
+            expected.UpsertDocument(id, texts[id + 1], DocumentStatus::ACTUAL, { id });
+        }
+        // Ошибочное изменение не попадает в журнал
+        const auto duplicate = [&server]() { server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {}); };
+        ASSERT_INVALID_ARGUMENT(duplicate);
+        const auto missing = [&server]() { server.UpdateDocumentStatus(3, DocumentStatus::BANNED); };
+        ASSERT_OUT_OF_RANGE(missing);
+        const auto special_symbol = [&server]() { server.UpsertDocument(2, "cat\x01"s, DocumentStatus::ACTUAL, {}); };
+        ASSERT_INVALID_ARGUMENT(special_symbol);
+    }
+
+    const auto assert_restored = [&](const DurableSearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+        for (const string& query : queries) {
+            for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT }) {
+                const vector<Document> lhs = server.FindTopDocuments(query, status);
+                const vector<Document> rhs = expected.FindTopDocuments(query, status);
+                ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), query);
+                for (size_t i = 0; i < lhs.size(); ++i) {
+                    ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, query);
+                    ASSERT_EQUAL_HINT(lhs[i].relevance, rhs[i].relevance, query);
+                    ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, query);
+                }
+            }
+        }
+    };
+    { // Сервер восстанавливается из журнала
+        DurableSearchServer server(path);
+        assert_restored(server);
+    }
+    { // Журнал читается частями, записи на границе частей не теряются
+        WalOptions log_options;
+        log_options.recovery_chunk_size = 7;
+        DurableSearchServer server(path, string(), IndexOptions(), log_options);
+        assert_restored(server);
+    }
+
+    const auto file_size = [&path]() {
+        ifstream file(path, ios::binary | ios::ate);
+        return static_cast<size_t>(file.tellg());
+    };
+    const size_t valid_size = file_size();
+    { // Запись, оборванная при сбое, отбрасывается
+        ofstream file(path, ios::binary | ios::app);
+        file << "\x20\x00\x00\x00\x10\x00"s;
+    }
+    {
+        DurableSearchServer server(path);
+        assert_restored(server);
+        ASSERT_EQUAL(file_size(), valid_size);
+        server.AddDocument(1000, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        expected.AddDocument(1000, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    { // Повреждённая запись обнаруживается по контрольной сумме, журнал заканчивается перед ней
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekp(-2, ios::end);
+        file.put('x');
+    }
+    {
+        DurableSearchServer server(path);
+        ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount() - 1);
+        ASSERT(server.FindTopDocuments("white cat"s).empty());
+        ASSERT_EQUAL(file_size(), valid_size);
+    }
+
+    { // Записи, добавленные до синхронизации, записываются на диск одной группой
+        WriteAheadLog log(path);
+        size_t record_count = 0;
+        log.Recover([&record_count](vector<Request>& records) { record_count += records.size(); });
+        ASSERT_EQUAL(record_count, size_t(368));
+        Request request;
+        request.type = RequestType::REMOVE_DOCUMENT;
+        uint64_t sequence_number = 0;
+        for (int id = 0; id < 10; ++id) {
+            request.document_id = id;
+            sequence_number = log.Append(request);
+        }
+        log.Sync(sequence_number);
+        ASSERT_EQUAL(log.GetCommitCount(), size_t(1));
+        log.Sync(sequence_number);
+        ASSERT_EQUAL(log.GetCommitCount(), size_t(1));
+    }
+    unlink(path.c_str());
+
+    { // Одновременные изменения из нескольких потоков
+        DurableSearchServer server(path);
+        vector<thread> writers;
+        for (int t = 0; t < 4; ++t) {
+            writers.emplace_back([&server, &texts, t]() {
+                for (int id = t; id < 200; id += 4) {
+                    server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+                }
+            });
+        }
+        for (thread& writer : writers) {
+            writer.join();
+        }
+        ASSERT(server.GetCommitCount() <= size_t(200));
+    }
+    {
+        DurableSearchServer server(path);
+        ASSERT_EQUAL(server.GetDocumentCount(), 200);
+    }
+    unlink(path.c_str());
+}
+#endif
+
+#ifdef __linux__
+// Проверка сетевого сервера запросов
+void TestQueryServer() {
+    { // Сообщения протокола кодируются и разбираются без потерь
+        Request request;
+        request.type = RequestType::ADD_DOCUMENT;
+        request.id = 7;
+        request.document_id = 3;
+        request.status = DocumentStatus::BANNED;
+        request.ratings = { 1, -2 };
+        request.text = "white cat"s;
+        vector<uint8_t> buffer;
+        EncodeRequest(request, buffer);
+        ASSERT_EQUAL(GetFrameSize(buffer.data(), buffer.size()), buffer.size());
+        ASSERT_EQUAL(GetFrameSize(buffer.data(), buffer.size() - 1), size_t(0));
+
+        Request decoded;
+        ASSERT(DecodeRequest(buffer.data() + FRAME_HEADER_SIZE, buffer.size() - FRAME_HEADER_SIZE, decoded));
+        ASSERT(decoded.type == RequestType::ADD_DOCUMENT);
+        ASSERT_EQUAL(decoded.id, uint32_t(7));
+        ASSERT_EQUAL(decoded.document_id, 3);
+        ASSERT(decoded.status == DocumentStatus::BANNED);
+        ASSERT_EQUAL(decoded.ratings, vector<int>({ 1, -2 }));
+        ASSERT_EQUAL(decoded.text, "white cat"s);
+        // Обрезанное сообщение не разбирается
+        ASSERT(!DecodeRequest(buffer.data() + FRAME_HEADER_SIZE, buffer.size() - FRAME_HEADER_SIZE - 1, decoded));
+
+        Response response;
+        response.id = 7;
+        response.documents = { { 1, 0.25, 3 }, { 2, 0.125, -1 } };
+        buffer.clear();
+        EncodeResponse(response, buffer);
+        Response decoded_response;
+        ASSERT(DecodeResponse(buffer.data() + FRAME_HEADER_SIZE, buffer.size() - FRAME_HEADER_SIZE, decoded_response));
+        ASSERT_EQUAL(decoded_response.documents.size(), size_t(2));
+        ASSERT_EQUAL(decoded_response.documents[1].id, 2);
+        ASSERT_EQUAL(decoded_response.documents[1].relevance, 0.125);
+        ASSERT_EQUAL(decoded_response.documents[1].rating, -1);
+    }
+
+    mt19937 generator(23);
+    const vector<string> words = GenerateWords(generator, 100, 6);
+    const vector<string> documents = GeneratePhrases(generator, words, 200, 10);
+    const vector<string> queries = GeneratePhrases(generator, words, 40, 3);
+
+    SearchServer search_server;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { static_cast<int>(i % 5) });
+    }
+    vector<vector<Document>> expected;
+    for (const string& query : queries) {
+        expected.push_back(search_server.FindTopDocuments(query));
+    }
+    const auto assert_same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+            ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        }
+    };
+
+    { // Запросы через Unix сокет
+        QueryServerOptions options;
+        options.unix_socket_path = "/tmp/search_server_test_"s + to_string(getpid()) + ".sock"s;
+        options.batch_delay = chrono::milliseconds(20);
+        QueryServer server(search_server, options);
+        thread loop([&server]() { server.Run(); });
+
+        QueryClient client(options.unix_socket_path);
+        assert_same(client.FindTopDocuments(queries[0]), expected[0]);
+
+        client.AddDocument(1000, "white cat"s, DocumentStatus::ACTUAL, { 5 });
+        ASSERT_EQUAL(client.FindTopDocuments("cat"s).front().id, 1000);
+        const auto [matched_words, status] = client.MatchDocument("white dog"s, 1000);
+        ASSERT_EQUAL(matched_words, vector<string>({ "white"s }));
+        ASSERT(status == DocumentStatus::ACTUAL);
+        client.UpsertDocument(1000, "white dog"s, DocumentStatus::ACTUAL, { 5 });
+        ASSERT(client.FindTopDocuments("cat"s).empty());
+        client.UpsertDocument(1000, "white cat"s, DocumentStatus::ACTUAL, { 5 });
+        client.UpdateDocumentRatings(1000, { 9 });
+        ASSERT_EQUAL(client.FindTopDocuments("cat"s).front().rating, 9);
+        client.UpdateDocumentStatus(1000, DocumentStatus::BANNED);
+        ASSERT(client.FindTopDocuments("cat"s).empty());
+        ASSERT_EQUAL(client.FindTopDocuments("cat"s, DocumentStatus::BANNED).front().id, 1000);
+        client.RemoveDocument(1000);
+        ASSERT(client.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+        const auto missing_update = [&client]() { client.UpdateDocumentStatus(1000, DocumentStatus::ACTUAL); };
+        ASSERT_INVALID_ARGUMENT(missing_update);
+        ASSERT(client.FindTopDocuments("cat"s).empty());
+
+        // Ошибки поискового сервера передаются клиенту
+        const auto invalid_query = [&client]() { client.FindTopDocuments("cat --dog"s); };
+        ASSERT_INVALID_ARGUMENT(invalid_query);
+        const auto missing_document = [&client]() { client.MatchDocument("cat"s, 1000); };
+        ASSERT_INVALID_ARGUMENT(missing_document);
+
+        // Неразборчивый запрос получает ответ с ошибкой, соединение остаётся открытым
+        Request malformed;
+        malformed.status = static_cast<DocumentStatus>(9);
+        const uint32_t malformed_id = client.Send(malformed);
+        const Response malformed_response = client.Receive();
+        ASSERT_EQUAL(malformed_response.id, malformed_id);
+        ASSERT(malformed_response.code == ResponseCode::MALFORMED_REQUEST);
+
+        // Запросы, отправленные не дожидаясь ответов, объединяются в пакет и получают ответы по порядку
+        const size_t batch_count = server.GetBatchCount();
+        vector<uint32_t> ids;
+        for (const string& query : queries) {
+            Request request;
+            request.text = query;
+            ids.push_back(client.Send(move(request)));
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const Response response = client.Receive();
+            ASSERT_EQUAL(response.id, ids[i]);
+            assert_same(response.documents, expected[i]);
+        }
+        ASSERT_HINT(server.GetBatchCount() - batch_count < queries.size() / 2, "Queries must be batched"s);
+
+        server.Stop();
+        loop.join();
+    }
+
+    { // Клиент, который не читает ответы, не останавливает сервер, и все ответы приходят по порядку
+        QueryServerOptions options;
+        options.batch_delay = chrono::microseconds(0);
+        options.max_output_backlog = 256;
+        QueryServer server(search_server, options);
+        thread loop([&server]() { server.Run(); });
+
+        QueryClient client(server.GetPort());
+        const size_t repetitions = 50;
+        vector<uint32_t> ids;
+        thread sender([&]() {
+            for (size_t r = 0; r < repetitions; ++r) {
+                for (const string& query : queries) {
+                    Request request;
+                    request.text = query;
+                    ids.push_back(client.Send(move(request)));
+                }
+            }
+        });
+        this_thread::sleep_for(chrono::milliseconds(50));
+        for (size_t i = 0; i < repetitions * queries.size(); ++i) {
+            const Response response = client.Receive();
+            assert_same(response.documents, expected[i % queries.size()]);
+        }
+        sender.join();
+        ASSERT_EQUAL(ids.size(), repetitions * queries.size());
+
+        server.Stop();
+        loop.join();
+    }
+
+    { // Одновременные клиенты через TCP
+        QueryServerOptions options;
+        options.batch_delay = chrono::microseconds(0);
+        QueryServer server(search_server, options);
+        ASSERT(server.GetPort() != 0);
+        thread loop([&server]() { server.Run(); });
+
+        vector<thread> clients;
+        for (int t = 0; t < 4; ++t) {
+            clients.emplace_back([&, t]() {
+                QueryClient client(server.GetPort());
+                for (size_t i = t; i < queries.size(); i += 4) {
+                    assert_same(client.FindTopDocuments(queries[i]), expected[i]);
+                }
+            });
+        }
+        for (thread& client : clients) {
+            client.join();
+        }
+        ASSERT_EQUAL(server.GetQueryCount(), queries.size());
+
+        server.Stop();
+        loop.join();
+    }
+}
+#endif
+
+#ifdef __linux__
+// Проверка загрузки корпуса из файла
+void TestCorpusLoader() {
+    const string path = "/tmp/search_server_test_"s + to_string(getpid()) + ".corpus"s;
+    const string corpus = "1\t0\t8 -3\twhite cat and fashionable collar\n"s
+        "\n"s
+        "2\t0\t7 2 7\tfluffy cat fluffy tail\r\n"s
+        "3\t2\t\tgroomed dog expressive eyes\n"s
+        "4\t1\t-5\twell groomed starling evgeny"s;
+    ofstream(path) << corpus;
+
+    // Маленькие куски заставляют разбить файл на несколько пакетов по границам строк
+    for (size_t chunk_size : { size_t(1), size_t(40), size_t(1) << 20 }) {
+        SearchServer server("and"s);
+        CorpusLoaderOptions options;
+        options.chunk_size = chunk_size;
+        options.max_pending_chunks = 1;
+        const CorpusLoadStats stats = LoadCorpus(server, path, options);
+        ASSERT_EQUAL(stats.document_count, size_t(4));
+        ASSERT_EQUAL(stats.byte_count, corpus.size());
+        ASSERT(chunk_size > corpus.size() ? stats.chunk_count == 1 : stats.chunk_count > 1);
+        ASSERT_EQUAL(server.GetDocumentCount(), 4);
+
+        const vector<Document> documents = server.FindTopDocuments("fluffy cat"s);
+        ASSERT_EQUAL(documents.size(), size_t(2));
+        ASSERT_EQUAL(documents[0].id, 2);
+        ASSERT_EQUAL(documents[0].rating, 5);
+        ASSERT_EQUAL(documents[1].rating, 2);
+        ASSERT_EQUAL(server.FindTopDocuments("groomed"s, DocumentStatus::BANNED)[0].rating, 0);
+        ASSERT_EQUAL(server.FindTopDocuments("groomed"s, DocumentStatus::IRRELEVANT)[0].id, 4);
+        // Текст документа не должен содержать перевод строки
+        ASSERT_EQUAL(get<0>(server.MatchDocument("tail"s, 2)).size(), size_t(1));
+    }
+
+    { // Файл, который нельзя отобразить в память, читается потоком
+        int fds[2];
+        ASSERT(pipe(fds) == 0);
+        thread writer([&corpus, fd = fds[1]]() {
+            for (size_t offset = 0; offset < corpus.size(); offset += 7) {
+                const size_t size = min<size_t>(7, corpus.size() - offset);
+                ASSERT(write(fd, corpus.data() + offset, size) == static_cast<ssize_t>(size));
+            }
+            close(fd);
+        });
+        SearchServer server;
+        CorpusLoaderOptions options;
+        options.chunk_size = 8;
+        const CorpusLoadStats stats = LoadCorpus(server, "/dev/fd/"s + to_string(fds[0]), options);
+        writer.join();
+        close(fds[0]);
+        ASSERT_EQUAL(stats.document_count, size_t(4));
+        ASSERT_EQUAL(stats.byte_count, corpus.size());
+        ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"s)[0].id, 2);
+    }
+
+    { // Ошибка в строке сообщает её номер, предыдущие куски уже добавлены
+        ofstream(path) << "1\t0\t1\twhite cat\n2\t0\t1\tblack cat\n3\t7\t1\tred cat\n"s;
+        SearchServer server;
+        CorpusLoaderOptions options;
+        options.chunk_size = 1;
+        try {
+            LoadCorpus(server, path, options);
+            ASSERT_HINT(false, "Invalid status must throw"s);
+        }
+        catch (const invalid_argument& error) {
+            ASSERT(string(error.what()).find("Line 3"s) != string::npos);
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), 2);
+    }
+
+    { // Куски разбираются параллельно, но добавляются по порядку и знают номера своих строк
+        string lines;
+        for (int id = 1; id <= 200; ++id) {
+            lines += to_string(id) + "\t0\t"s + to_string(id) + "\tcat number "s + to_string(id) + "\n"s;
+        }
+        CorpusLoaderOptions options;
+        options.chunk_size = 64;
+        options.max_pending_chunks = 8;
+        options.parse_thread_count = 4;
+
+        ofstream(path) << lines;
+        vector<int> added_ids;
+        const CorpusLoadStats stats = LoadCorpus(path, [&added_ids](const vector<NewDocument>& documents) {
+            for (const NewDocument& document : documents) {
+                added_ids.push_back(document.id);
+            }
+        }, options);
+        ASSERT(stats.chunk_count > 8);
+        ASSERT_EQUAL(added_ids.size(), size_t(200));
+        ASSERT(is_sorted(added_ids.begin(), added_ids.end()));
+
+        ofstream(path) << lines << "\n201\t0\tbad\tcat\n"s << lines;
+        SearchServer server;
+        try {
+            LoadCorpus(server, path, options);
+            ASSERT_HINT(false, "Invalid rating must throw"s);
+        }
+        catch (const invalid_argument& error) {
+            ASSERT(string(error.what()).find("Line 202:"s) != string::npos);
+        }
+        ASSERT(server.GetDocumentCount() <= 200);
+    }
+
+    for (const string& line : { "1\t0\twhite cat\n"s, "x\t0\t1\twhite cat\n"s, "1\t0\t1 a\twhite cat\n"s, "-1\t0\t1\twhite cat\n"s }) {
+        ofstream(path) << line << "1\t0\t1\tduplicate\n"s;
+        SearchServer server;
+        const auto load = [&server, &path]() { LoadCorpus(server, path); };
+        ASSERT_INVALID_ARGUMENT(load);
+    }
+
+    { // Пустой файл не содержит документов
+        ofstream(path).close();
+        SearchServer server;
+        ASSERT_EQUAL(LoadCorpus(server, path).document_count, size_t(0));
+    }
+
+    unlink(path.c_str());
+    SearchServer server;
+    try {
+        LoadCorpus(server, path);
+        ASSERT_HINT(false, "Missing file must throw"s);
+    }
+    catch (const system_error&) {
+    }
+}
+#endif
+
 // -----------------------------------------------------------------------------
 
 // Проверка работы Пагинатора
@@ -887,53 +3117,173 @@ void TestRequestQueue() {
     ASSERT_EQUAL_HINT(queue.GetNoResultRequests(), 1430, "1430 empty requests were made"s);
 }
 
-// -----------------------------------------------------------------------------
+// Проверка работы профилировщика
+void TestProfiler() {
+    static ProfileSite outer_site("TestProfilerOuter");
+    static ProfileSite inner_site("TestProfilerInner");
 
-// Функции для генерации случайных слов и случайных наборов слов
+    for (int i = 0; i < 3; ++i) {
+        ProfileScope outer(outer_site);
+        for (int j = 0; j < 2; ++j) {
+            ProfileScope inner(inner_site);
+        }
+    }
 
-string GenerateWord(mt19937& generator, int max_word_lenght) {
-    int lenght = uniform_int_distribution(1, max_word_lenght)(generator);
-    string word;
-    word.reserve(lenght);
-    for (int i = 0; i < lenght; ++i) {
-        word.push_back(uniform_int_distribution(97, 122)(generator));
+    uint64_t outer_count = 0;
+    uint64_t inner_count = 0;
+    for (const ProfileNodeStats& node : Profiler::Snapshot()) {
+        if (node.path == "TestProfilerOuter"s) {
+            outer_count = node.count;
+            ASSERT_EQUAL(node.depth, 0);
+            ASSERT(node.p50_ns <= node.p99_ns);
+        }
+        if (node.path == "TestProfilerOuter/TestProfilerInner"s) {
+            inner_count = node.count;
+            ASSERT_EQUAL(node.depth, 1);
+        }
     }
-    return word;
-}
+    ASSERT_EQUAL(outer_count, uint64_t(3));
+    ASSERT_EQUAL_HINT(inner_count, uint64_t(6), "Nested scopes must be aggregated under the parent path"s);
+
+    ostringstream out;
+    Profiler::Dump(out);
+    ASSERT(out.str().find("\"path\":\"TestProfilerOuter/TestProfilerInner\""s) != string::npos);
+
+    { // Место, вложенное в несколько родителей, и задача другого потока, унаследовавшая родителя
+        static ProfileSite first_site("TestProfilerFirst");
+        static ProfileSite second_site("TestProfilerSecond");
+        static ProfileSite shared_site("TestProfilerShared");
+        for (int i = 0; i < 5; ++i) {
+            for (ProfileSite* site : { &first_site, &second_site }) {
+                ProfileScope parent(*site);
+                ProfileScope shared(shared_site);
+            }
+        }
+        {
+            ProfileScope parent(first_site);
+            thread worker([parent_node = Profiler::GetCurrentNode()]() {
+                const ProfileParentScope inherited(parent_node);
+                ProfileScope shared(shared_site);
+            });
+            worker.join();
+        }
 
-vector<string> GenerateWords(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
+        map<string, uint64_t> counts;
+        for (const ProfileNodeStats& node : Profiler::Snapshot()) {
+            counts[node.path] += node.count;
+        }
+        ASSERT_EQUAL(counts["TestProfilerFirst/TestProfilerShared"s], uint64_t(6));
+        ASSERT_EQUAL(counts["TestProfilerSecond/TestProfilerShared"s], uint64_t(5));
+        ASSERT_EQUAL(counts["TestProfilerShared"s], uint64_t(0));
     }
-    sort(words.begin(), words.end());
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
 }
 
-string GeneratePhrase(mt19937& generator, const vector<string>& words, int max_word_count_in_query, double minus_frequency = 0.0) {
-    const int word_count = uniform_int_distribution(1, max_word_count_in_query)(generator);
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
+// Проверка асинхронного выполнения запросов на собственном пуле потоков
+void TestAsyncSearchServer() {
+    SearchServer server;
+    server.AddDocument(0, "white cat and fancy collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(1, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(3, "groomed starling eugene"s, DocumentStatus::BANNED, { 9 });
+
+    const vector<string> queries = { "fluffy groomed cat"s, "starling"s, "dog -eyes"s, "white collar"s };
+
+    AsyncSearchServer async_server(server, 2);
+    ASSERT_EQUAL(async_server.GetExecutor().GetThreadCount(), size_t(2));
+
+    { // Результаты совпадают с синхронным поиском
+        vector<future<vector<Document>>> futures;
+        for (const string& query : queries) {
+            futures.push_back(async_server.FindTopDocumentsAsync(query));
         }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_frequency) {
-            query.push_back('-');
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT(futures[i].get() == server.FindTopDocuments(queries[i]));
         }
-        query += words[uniform_int_distribution<int>(0, words.size() - 1)(generator)];
+        ASSERT(async_server.FindTopDocumentsAsync("starling"s, DocumentStatus::BANNED).get() ==
+               server.FindTopDocuments("starling"s, DocumentStatus::BANNED));
+        ASSERT(async_server.FindTopDocumentsAsync("cat"s, [](int id, DocumentStatus, int) { return id == 1; }).get().size() == 1);
+    }
+
+    { // Пакетная обработка совпадает с ProcessQueries
+        ASSERT(async_server.ProcessQueriesAsync(queries).get() == ProcessQueries(server, queries));
+        ASSERT(async_server.ProcessQueriesAsync({}).get().empty());
+    }
+
+    { // Исключение передаётся через future
+        auto invalid = async_server.ProcessQueriesAsync({ "cat"s, "--cat"s });
+        auto get_result = [&invalid]() { invalid.get(); };
+        ASSERT_INVALID_ARGUMENT(get_result);
+    }
+
+    { // Обратный вызов получает результат или ошибку
+        promise<pair<bool, size_t>> done;
+        async_server.FindTopDocumentsAsync("fluffy cat"s, [&done](exception_ptr error, vector<Document> documents) {
+            done.set_value({ error != nullptr, documents.size() });
+        });
+        ASSERT(done.get_future().get() == make_pair(false, size_t(2)));
+
+        promise<bool> failed;
+        async_server.FindTopDocumentsAsync("cat --"s, [&failed](exception_ptr error, vector<Document>) {
+            failed.set_value(error != nullptr);
+        });
+        ASSERT(failed.get_future().get());
+    }
+
+    { // Исключение задачи из Post передаётся обработчику, пул продолжает работу
+        promise<string> reported;
+        ThreadPool pool(1, [&reported](exception_ptr error) {
+            try {
+                rethrow_exception(error);
+            }
+            catch (const exception& e) {
+                reported.set_value(e.what());
+            }
+        });
+        pool.Post([]() { throw runtime_error("task failed"s); });
+        ASSERT_EQUAL(reported.get_future().get(), "task failed"s);
+        ASSERT_EQUAL(pool.Submit([]() { return 42; }).get(), 42);
     }
-    return query;
 }
 
-vector<string> GeneratePhrases(mt19937& generator, const vector<string>& words, int query_count, int max_word_count_in_query) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GeneratePhrase(generator, words, max_word_count_in_query));
+// Проверка генератора нагрузки с распределением Ципфа
+void TestWorkloadGenerator() {
+    WorkloadConfig config;
+    config.document_count = 2'000;
+    config.vocabulary_size = 1'000;
+    config.query_count = 1'000;
+    config.distinct_query_count = 100;
+    config.status_weights = { 0.5, 0.5, 0.0, 0.0 };
+
+    const Workload workload = GenerateWorkload(config, 42);
+    ASSERT_EQUAL(workload.vocabulary.size(), size_t(1'000));
+    ASSERT_EQUAL(workload.documents.size(), size_t(2'000));
+    ASSERT_EQUAL(workload.queries.size(), size_t(1'000));
+
+    { // Одинаковый seed даёт одинаковую нагрузку
+        const Workload same = GenerateWorkload(config, 42);
+        ASSERT(same.queries == workload.queries);
+        ASSERT_EQUAL(same.documents.back().text, workload.documents.back().text);
+    }
+
+    map<string_view, int> word_counts;
+    int banned_or_removed = 0;
+    int irrelevant = 0;
+    for (const WorkloadDocument& document : workload.documents) {
+        istringstream text(document.text);
+        string word;
+        while (text >> word) {
+            ++word_counts[*find(workload.vocabulary.begin(), workload.vocabulary.end(), word)];
+        }
+        irrelevant += (document.status == DocumentStatus::IRRELEVANT);
+        banned_or_removed += (document.status == DocumentStatus::BANNED || document.status == DocumentStatus::REMOVED);
     }
-    return queries;
+    ASSERT_HINT(word_counts[workload.vocabulary[0]] > 10 * word_counts[workload.vocabulary[99]],
+                "The most popular word must be far more frequent than the hundredth one"s);
+    ASSERT_EQUAL(banned_or_removed, 0);
+    ASSERT(irrelevant > 800 && irrelevant < 1'200);
+
+    set<string> distinct_queries(workload.queries.begin(), workload.queries.end());
+    ASSERT_HINT(distinct_queries.size() <= size_t(100), "Queries must repeat from the distinct query pool"s);
 }
 
 // -----------------------------------------------------------------------------
@@ -1022,8 +3372,36 @@ void TestSearchServer() {
     RUN_TEST(TestSeachServerExceptions);
     RUN_TEST(TestProcessQueries);
     RUN_TEST(TestProcessQueriesJoined);
+    RUN_TEST(TestProcessQueriesStreaming);
+    RUN_TEST(TestIntersectSorted);
+    RUN_TEST(TestConjunctiveQueries);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestPatternQueries);
+    RUN_TEST(TestFuzzyQueries);
+    RUN_TEST(TestTextAnalyzer);
+    RUN_TEST(TestScorers);
+    RUN_TEST(TestScoringKernels);
+    RUN_TEST(TestDocumentFilter);
+    RUN_TEST(TestPartitionedPostings);
+    RUN_TEST(TestImpactLists);
+    RUN_TEST(TestRoaringBitmap);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestBulkAddDocuments);
+    RUN_TEST(TestMemoryStats);
+    RUN_TEST(TestQueryArena);
+    RUN_TEST(TestUpdateDocumentMetadata);
+    RUN_TEST(TestUpsertDocument);
+    RUN_TEST(TestDocumentStore);
+#ifdef __linux__
+    RUN_TEST(TestWriteAheadLog);
+    RUN_TEST(TestQueryServer);
+    RUN_TEST(TestCorpusLoader);
+#endif
     RUN_TEST(TestPaginator);
     RUN_TEST(TestRequestQueue);
+    RUN_TEST(TestProfiler);
+    RUN_TEST(TestAsyncSearchServer);
+    RUN_TEST(TestWorkloadGenerator);
 
 #ifndef _DEBUG
     RUN_TEST(TestRemoveDocumentSpeed);
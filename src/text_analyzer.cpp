@@ -0,0 +1,351 @@
+#include "text_analyzer.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXT_ANALYZER_HAS_SSE2
+#endif
+
+using namespace std;
+
+namespace {
+
+// Base letters of U+00C0..U+00FF and U+0100..U+017F, '.' keeps the letter
+constexpr string_view LATIN1_BASE_LETTERS = "AAAAAA.CEEEEIIIIDNOOOOO.OUUUUY..aaaaaa.ceeeeiiiidnooooo.ouuuuy.y"sv;
+constexpr string_view LATIN_EXTENDED_A_BASE_LETTERS =
+    "AaAaAaCcCcCcCcDdDdEeEeEeEeEeGgGgGgGgHhHhIiIiIiIiIi..JjKk.LlLlLlL"
+    "lLlNnNnNn...OoOoOo..RrRrRrSsSsSsSsTtTtTtUuUuUuUuUuUuWwYyYZzZzZzs"sv;
+static_assert(LATIN1_BASE_LETTERS.size() == 0x40 && LATIN_EXTENDED_A_BASE_LETTERS.size() == 0x80);
+
+// Returns the length of the sequence
+size_t DecodeUtf8(const char* in, const char* end, char32_t& code_point) {
+    const unsigned char lead = static_cast<unsigned char>(*in);
+    size_t length = 0;
+    char32_t min_code_point = 0;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        code_point = lead & 0x1F;
+        min_code_point = 0x80;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        code_point = lead & 0x0F;
+        min_code_point = 0x800;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        code_point = lead & 0x07;
+        min_code_point = 0x10000;
+    }
+    if (length == 0 || static_cast<size_t>(end - in) < length) {
+        throw invalid_argument("The text contains invalid UTF-8"s);
+    }
+    for (size_t i = 1; i < length; ++i) {
+        const unsigned char byte = static_cast<unsigned char>(in[i]);
+        if ((byte & 0xC0) != 0x80) {
+            throw invalid_argument("The text contains invalid UTF-8"s);
+        }
+        code_point = (code_point << 6) | (byte & 0x3F);
+    }
+    // Overlong forms and surrogates
+    if (code_point < min_code_point || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        throw invalid_argument("The text contains invalid UTF-8"s);
+    }
+    return length;
+}
+
+char* EncodeUtf8(char32_t code_point, char* out) {
+    if (code_point < 0x80) {
+        *out++ = static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else {
+        *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    return out;
+}
+
+// Simple case folding of the scripts the analyzer knows. No folding makes the UTF-8 of a
+// character longer, which keeps the analyzed text within the size of the original one.
+char32_t FoldCase(char32_t c) {
+    if (c < 0x80) {
+        return (c >= 'A' && c <= 'Z') ? c + 0x20 : c;
+    }
+    if (c < 0x100) {
+        return (c >= 0xC0 && c <= 0xDE && c != 0xD7) ? c + 0x20 : c;
+    }
+    if (c < 0x180) {
+        if (c == 0x130) {
+            return 'i';
+        }
+        if (c == 0x178) {
+            return 0xFF;
+        }
+        if (c == 0x17F) {
+            return 's';
+        }
+        // Capital letters are the even code points of the pairs, except in two ranges
+        if ((c <= 0x137) || (c >= 0x14A && c <= 0x177)) {
+            return c | 1;
+        }
+        if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) {
+            return (c & 1) ? c + 1 : c;
+        }
+        return c;
+    }
+    if (c >= 0x370 && c < 0x400) {
+        if (c == 0x386) {
+            return 0x3AC;
+        }
+        if (c >= 0x388 && c <= 0x38A) {
+            return c + 0x25;
+        }
+        if (c == 0x38C) {
+            return 0x3CC;
+        }
+        if (c == 0x38E || c == 0x38F) {
+            return c + 0x3F;
+        }
+        if (c >= 0x391 && c <= 0x3AB && c != 0x3A2) {
+            return c + 0x20;
+        }
+        // Final sigma
+        return c == 0x3C2 ? 0x3C3 : c;
+    }
+    if (c >= 0x400 && c < 0x530) {
+        if (c <= 0x40F) {
+            return c + 0x50;
+        }
+        if (c <= 0x42F) {
+            return c + 0x20;
+        }
+        if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) || (c >= 0x4D0 && c <= 0x52F)) {
+            return c | 1;
+        }
+        if (c == 0x4C0) {
+            return 0x4CF;
+        }
+        if (c >= 0x4C1 && c <= 0x4CE) {
+            return (c & 1) ? c + 1 : c;
+        }
+        return c;
+    }
+    if (c >= 0x531 && c <= 0x556) {
+        return c + 0x30;
+    }
+    if (c >= 0x1E00 && c <= 0x1EFF) {
+        if (c == 0x1E9E) {
+            return 0xDF;
+        }
+        return (c <= 0x1E95 || c >= 0x1EA0) ? c | 1 : c;
+    }
+    switch (c) {
+    case 0x2126: return 0x3C9;
+    case 0x212A: return 'k';
+    case 0x212B: return 0xE5;
+    }
+    if (c >= 0xFF21 && c <= 0xFF3A) {
+        return c + 0x20;
+    }
+    return c;
+}
+
+// Combining marks, soft hyphen, zero width characters and the byte order mark
+bool IsIgnorable(char32_t c) {
+    return (c >= 0x300 && c <= 0x36F) || c == 0xAD || (c >= 0x200B && c <= 0x200D) || c == 0x2060 || c == 0xFEFF;
+}
+
+bool IsUnicodeSpace(char32_t c) {
+    return c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+bool IsUnicodePunctuation(char32_t c) {
+    if (c >= 0xA0 && c <= 0xBF) {
+        // Ordinal indicators, micro sign, superscripts and fractions are parts of words
+        return c != 0xAA && c != 0xB2 && c != 0xB3 && c != 0xB5 && c != 0xB9 && c != 0xBA && (c < 0xBC || c > 0xBE);
+    }
+    return c == 0xD7 || c == 0xF7 || (c >= 0x2000 && c <= 0x206F) || (c >= 0x2E00 && c <= 0x2E7F) || (c >= 0x3000 && c <= 0x303F)
+        || (c >= 0xFF01 && c <= 0xFF0F) || (c >= 0xFF1A && c <= 0xFF20) || (c >= 0xFF3B && c <= 0xFF40) || (c >= 0xFF5B && c <= 0xFF65);
+}
+
+} // namespace
+
+TextAnalyzer::TextAnalyzer(const AnalyzerOptions& options)
+    : fold_case_(options.fold_case)
+    , split_punctuation_(options.split_punctuation)
+    , normalize_(options.normalize) {
+}
+
+void TextAnalyzer::Split(string_view text, char* buffer, pmr::vector<string_view>& words) const {
+    Analyze(text, buffer, true, [&words](const char* begin, const char* end) {
+        words.push_back(string_view(begin, static_cast<size_t>(end - begin)));
+    });
+}
+
+string_view TextAnalyzer::AnalyzeWord(string_view text, char* buffer) const {
+    const char* end = Analyze(text, buffer, false, [](const char*, const char*) {});
+    return string_view(buffer, static_cast<size_t>(end - buffer));
+}
+
+template <typename OnWord>
+char* TextAnalyzer::Analyze(string_view text, char* out, bool split, OnWord on_word) const {
+    const char* in = text.data();
+    const char* const end = in + text.size();
+    // Beginning of the word being written
+    char* word = nullptr;
+    const auto close_word = [&word, &out, &on_word]() {
+        if (word != nullptr && out != word) {
+            on_word(word, out);
+        }
+        word = nullptr;
+    };
+
+    while (in < end) {
+        const unsigned char c = static_cast<unsigned char>(*in);
+        if (c < 0x80) {
+            const size_t count = CopyAsciiWord(in, end, out);
+            if (count > 0) {
+                if (word == nullptr) {
+                    word = out;
+                }
+                in += count;
+                out += count;
+                continue;
+            }
+            if (c < ' ') {
+                throw invalid_argument("The text contains special symbol"s);
+            }
+            ++in;
+            if (split) {
+                close_word();
+            }
+            else {
+                if (word == nullptr) {
+                    word = out;
+                }
+                *out++ = static_cast<char>(c);
+            }
+            continue;
+        }
+
+        char32_t code_point = 0;
+        in += DecodeUtf8(in, end, code_point);
+        if (split && IsSeparator(code_point)) {
+            close_word();
+            continue;
+        }
+        char32_t mapped[3];
+        const size_t count = Map(code_point, mapped);
+        for (size_t i = 0; i < count; ++i) {
+            if (word == nullptr) {
+                word = out;
+            }
+            out = EncodeUtf8(mapped[i], out);
+        }
+    }
+    close_word();
+    return out;
+}
+
+bool TextAnalyzer::IsAsciiWordChar(unsigned char c) const {
+    if (c <= ' ' || c >= 0x80) {
+        return false;
+    }
+    return !split_punctuation_ || (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
+
+size_t TextAnalyzer::CopyAsciiWord(const char* in, const char* end, char* out) const {
+    size_t count = 0;
+#ifdef TEXT_ANALYZER_HAS_SSE2
+    // The output never overtakes the input, so a whole block can be stored even past the word
+    while (static_cast<size_t>(end - in) - count >= 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + count));
+        // Bytes of multi-byte characters are negative, so they are never above the space
+        __m128i is_word = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(' '));
+        if (split_punctuation_) {
+            const __m128i lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+            const __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+            const __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+            is_word = _mm_and_si128(is_word, _mm_or_si128(is_letter, is_digit));
+        }
+        __m128i folded = bytes;
+        if (fold_case_) {
+            const __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('Z' + 1)));
+            folded = _mm_or_si128(bytes, _mm_and_si128(is_upper, _mm_set1_epi8(0x20)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + count), folded);
+        const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(is_word)) & 0xFFFF;
+        if (mask != 0) {
+            return count + static_cast<size_t>(__builtin_ctz(mask));
+        }
+        count += 16;
+    }
+#endif
+    for (; in + count < end; ++count) {
+        const unsigned char c = static_cast<unsigned char>(in[count]);
+        if (!IsAsciiWordChar(c)) {
+            break;
+        }
+        out[count] = static_cast<char>((fold_case_ && c >= 'A' && c <= 'Z') ? c + 0x20 : c);
+    }
+    return count;
+}
+
+bool TextAnalyzer::IsSeparator(char32_t code_point) const {
+    if (normalize_ && IsIgnorable(code_point)) {
+        return false;
+    }
+    return (split_punctuation_ && IsUnicodePunctuation(code_point)) || (normalize_ && IsUnicodeSpace(code_point));
+}
+
+size_t TextAnalyzer::Map(char32_t code_point, char32_t* mapped) const {
+    size_t count = 1;
+    mapped[0] = code_point;
+    if (normalize_) {
+        const char32_t c = code_point;
+        if (IsIgnorable(c)) {
+            return 0;
+        }
+        if (c >= 0xC0 && c < 0x100 && LATIN1_BASE_LETTERS[c - 0xC0] != '.') {
+            mapped[0] = static_cast<char32_t>(LATIN1_BASE_LETTERS[c - 0xC0]);
+        }
+        else if (c >= 0x100 && c < 0x180 && LATIN_EXTENDED_A_BASE_LETTERS[c - 0x100] != '.') {
+            mapped[0] = static_cast<char32_t>(LATIN_EXTENDED_A_BASE_LETTERS[c - 0x100]);
+        }
+        else if (c == 0x401 || c == 0x451) {
+            // Ё and ё to Е and е
+            mapped[0] = (c == 0x401) ? 0x415 : 0x435;
+        }
+        else if (c >= 0xFF01 && c <= 0xFF5E) {
+            mapped[0] = c - 0xFEE0;
+        }
+        else if (c >= 0xFB00 && c <= 0xFB06) {
+            // Ligatures ff, fi, fl, ffi, ffl, long st and st
+            static constexpr string_view LIGATURES[] = { "ff"sv, "fi"sv, "fl"sv, "ffi"sv, "ffl"sv, "st"sv, "st"sv };
+            const string_view letters = LIGATURES[c - 0xFB00];
+            count = letters.size();
+            for (size_t i = 0; i < count; ++i) {
+                mapped[i] = static_cast<char32_t>(letters[i]);
+            }
+        }
+    }
+    if (fold_case_) {
+        for (size_t i = 0; i < count; ++i) {
+            mapped[i] = FoldCase(mapped[i]);
+        }
+    }
+    return count;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Steps of TextAnalyzer. All of them are off by default, then the words are the bytes between spaces.
+struct AnalyzerOptions {
+    // Lowercases Latin, Greek, Cyrillic and Armenian letters, including the fullwidth Latin ones
+    bool fold_case = false;
+    // ASCII characters other than letters and digits, Latin-1 punctuation and symbols and the
+    // General, Supplemental and CJK Punctuation blocks separate words like spaces
+    bool split_punctuation = false;
+    // Folds compatibility characters (fullwidth forms, ligatures, Unicode spaces) and the
+    // diacritics of Latin letters, 'ё' to 'е', and drops combining marks and invisible characters
+    bool normalize = false;
+};
+
+// Splits UTF-8 text into index terms. Documents, queries and stop words go through the same
+// analyzer, so their words compare equal. Runs of ASCII characters are classified and folded
+// 16 bytes at a time with SSE2, so mostly ASCII text costs about as much as splitting on spaces.
+class TextAnalyzer {
+public:
+    explicit TextAnalyzer(const AnalyzerOptions& options = AnalyzerOptions());
+
+    // False for the default options, whose words are views of the text itself
+    bool IsEnabled() const {
+        return fold_case_ || split_punctuation_ || normalize_;
+    }
+
+    // Appends the words of the text to words. An analyzed word is never longer than its
+    // text, so they are written to buffer, which needs room for text.size() characters.
+    // Throws invalid_argument for control characters and invalid UTF-8.
+    void Split(std::string_view text, char* buffer, std::pmr::vector<std::string_view>& words) const;
+    // Analyzes the text as one word, so the syntax characters of query patterns don't split it.
+    // The result may be empty if all of its characters are dropped.
+    std::string_view AnalyzeWord(std::string_view text, char* buffer) const;
+
+private:
+    // Writes the analyzed text to out, calls on_word(begin, end) for every word of it
+    // if split, otherwise separators are kept as they are
+    template <typename OnWord>
+    char* Analyze(std::string_view text, char* out, bool split, OnWord on_word) const;
+    // Copies the leading ASCII word characters of [in, end) to out, returns their count
+    size_t CopyAsciiWord(const char* in, const char* end, char* out) const;
+    bool IsAsciiWordChar(unsigned char c) const;
+    bool IsSeparator(char32_t code_point) const;
+    // Replaces the code point with up to three, returns their count
+    size_t Map(char32_t code_point, char32_t* mapped) const;
+
+    bool fold_case_;
+    bool split_punctuation_;
+    bool normalize_;
+};
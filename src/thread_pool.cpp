@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+
+#include "profiler.h"
+
+#include <iostream>
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t thread_count, ErrorHandler on_error)
+    : on_error_(move(on_error)) {
+    if (!on_error_) {
+        on_error_ = [](exception_ptr error) {
+            try {
+                rethrow_exception(error);
+            }
+            catch (const exception& e) {
+                cerr << "Thread pool task failed: "s << e.what() << endl;
+            }
+            catch (...) {
+                cerr << "Thread pool task failed with an unknown exception"s << endl;
+            }
+        };
+    }
+    thread_count = max<size_t>(thread_count, 1);
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(make_unique<WorkerQueue>());
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(wake_mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Post(function<void()> task) {
+    task = InheritProfileScope(move(task));
+    // Tasks posted from a worker stay on its own deque for locality
+    const size_t index = (current_pool_ == this)
+        ? current_index_
+        : next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+    // A worker which finds the task decrements the counter, so it is incremented first
+    {
+        lock_guard guard(wake_mutex_);
+        queued_.fetch_add(1, memory_order_relaxed);
+    }
+    {
+        lock_guard guard(queues_[index]->mute);
+        queues_[index]->tasks.push_back(move(task));
+    }
+    wake_cv_.notify_one();
+}
+
+bool ThreadPool::TryPopOwn(size_t index, function<void()>& task) {
+    WorkerQueue& queue = *queues_[index];
+    lock_guard guard(queue.mute);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::TrySteal(size_t index, function<void()>& task) {
+    for (size_t shift = 1; shift < queues_.size(); ++shift) {
+        WorkerQueue& queue = *queues_[(index + shift) % queues_.size()];
+        lock_guard guard(queue.mute);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        task = move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool_ = this;
+    current_index_ = index;
+
+    function<void()> task;
+    while (true) {
+        if (TryPopOwn(index, task) || TrySteal(index, task)) {
+            queued_.fetch_sub(1, memory_order_relaxed);
+            // An exception must not leave the thread, that would terminate the process
+            try {
+                task();
+            }
+            catch (...) {
+                on_error_(current_exception());
+            }
+            task = nullptr;
+            continue;
+        }
+
+        unique_lock lock(wake_mutex_);
+        wake_cv_.wait(lock, [this]() { return stop_ || queued_.load(memory_order_relaxed) > 0; });
+        if (stop_ && queued_.load(memory_order_relaxed) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size pool with a task deque per worker. Workers take their own newest tasks first
+// and steal the oldest tasks of other workers when their deque is empty.
+class ThreadPool {
+public:
+    // Receives the exception of a task run by Post, on the worker thread. Submit passes
+    // exceptions to the future instead.
+    using ErrorHandler = std::function<void(std::exception_ptr)>;
+
+    // Without a handler the exceptions are written to std::cerr
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency(), ErrorHandler on_error = nullptr);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // Runs all queued tasks before joining the workers
+    ~ThreadPool();
+
+    void Post(std::function<void()> task);
+
+    template <typename Func>
+    std::future<std::invoke_result_t<Func>> Submit(Func func);
+
+    size_t GetThreadCount() const {
+        return workers_.size();
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mute;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool TryPopOwn(size_t index, std::function<void()>& task);
+    bool TrySteal(size_t index, std::function<void()>& task);
+    void WorkerLoop(size_t index);
+
+    ErrorHandler on_error_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_ = 0;
+    // Counted before a task is pushed, so it never drops below the tasks in the deques
+    std::atomic<size_t> queued_ = 0;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool stop_ = false;
+
+    inline static thread_local ThreadPool* current_pool_ = nullptr;
+    inline static thread_local size_t current_index_ = 0;
+};
+
+template <typename Func>
+std::future<std::invoke_result_t<Func>> ThreadPool::Submit(Func func) {
+    using Result = std::invoke_result_t<Func>;
+    // std::function requires a copyable target
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+    std::future<Result> result = task->get_future();
+    Post([task]() { (*task)(); });
+    return result;
+}
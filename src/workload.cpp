@@ -0,0 +1,98 @@
+#include "workload.h"
+
+#include "generators.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+
+namespace {
+
+vector<string> GenerateVocabulary(mt19937& generator, int word_count, int max_word_length) {
+    unordered_set<string> unique_words;
+    vector<string> words;
+    words.reserve(word_count);
+    // Long enough words are needed to fit a large vocabulary
+    int max_length = max_word_length;
+    while (static_cast<int>(words.size()) < word_count) {
+        for (int attempt = 0; attempt < 100 && static_cast<int>(words.size()) < word_count; ++attempt) {
+            string word = GenerateWord(generator, max_length);
+            if (unique_words.insert(word).second) {
+                words.push_back(move(word));
+            }
+        }
+        ++max_length;
+    }
+    return words;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& vocabulary, const ZipfDistribution& zipf,
+                    int word_count, double minus_word_ratio) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (minus_word_ratio > 0.0 && uniform_real_distribution<>(0.0, 1.0)(generator) < minus_word_ratio) {
+            text.push_back('-');
+        }
+        text += vocabulary[zipf(generator)];
+    }
+    return text;
+}
+
+} // namespace
+
+ZipfDistribution::ZipfDistribution(size_t n, double exponent) {
+    if (n == 0) {
+        throw invalid_argument("Zipf distribution requires at least one rank");
+    }
+    cdf_.reserve(n);
+    double sum = 0.0;
+    for (size_t rank = 1; rank <= n; ++rank) {
+        sum += 1.0 / pow(static_cast<double>(rank), exponent);
+        cdf_.push_back(sum);
+    }
+}
+
+Workload GenerateWorkload(const WorkloadConfig& config, uint32_t seed) {
+    mt19937 generator(seed);
+    Workload workload;
+    workload.vocabulary = GenerateVocabulary(generator, config.vocabulary_size, config.max_word_length);
+
+    const ZipfDistribution word_zipf(workload.vocabulary.size(), config.zipf_exponent);
+    lognormal_distribution<> document_length(config.document_length_log_mean, config.document_length_log_sigma);
+    discrete_distribution<int> status(config.status_weights.begin(), config.status_weights.end());
+
+    workload.documents.reserve(config.document_count);
+    for (int id = 0; id < config.document_count; ++id) {
+        const int length = clamp(static_cast<int>(document_length(generator)), 1, config.max_document_length);
+        WorkloadDocument document;
+        document.id = id;
+        document.text = GenerateText(generator, workload.vocabulary, word_zipf, length, 0.0);
+        document.status = static_cast<DocumentStatus>(status(generator));
+        document.ratings = GenerateRatings(generator, config.max_rating_count, config.min_rating, config.max_rating);
+        workload.documents.push_back(move(document));
+    }
+
+    // Short queries dominate real logs, lengths are 1 + geometric
+    geometric_distribution<int> extra_query_words(1.0 / max(config.mean_query_length, 1.0));
+    vector<string> distinct_queries;
+    distinct_queries.reserve(config.distinct_query_count);
+    for (int i = 0; i < config.distinct_query_count; ++i) {
+        const int length = min(1 + extra_query_words(generator), config.max_query_length);
+        distinct_queries.push_back(GenerateText(generator, workload.vocabulary, word_zipf, length, config.minus_word_ratio));
+    }
+
+    if (!distinct_queries.empty()) {
+        const ZipfDistribution query_zipf(distinct_queries.size(), config.query_popularity_exponent);
+        workload.queries.reserve(config.query_count);
+        for (int i = 0; i < config.query_count; ++i) {
+            workload.queries.push_back(distinct_queries[query_zipf(generator)]);
+        }
+    }
+
+    return workload;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double exponent);
+
+    template <typename Generator>
+    size_t operator()(Generator& generator) const {
+        const double u = std::uniform_real_distribution<>(0.0, cdf_.back())(generator);
+        const auto it = std::upper_bound(cdf_.begin(), cdf_.end(), u);
+        return std::min(static_cast<size_t>(it - cdf_.begin()), cdf_.size() - 1);
+    }
+
+    size_t size() const {
+        return cdf_.size();
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+struct WorkloadConfig {
+    int document_count = 10'000;
+    int vocabulary_size = 50'000;
+    double zipf_exponent = 1.0;
+    int max_word_length = 10;
+
+    // Document lengths in words follow a log-normal distribution
+    double document_length_log_mean = 4.0;
+    double document_length_log_sigma = 0.8;
+    int max_document_length = 2'000;
+
+    // Queries are drawn from a pool of distinct queries with Zipf popularity,
+    // so the most popular queries repeat like the head of a real query log
+    int query_count = 10'000;
+    int distinct_query_count = 2'000;
+    double query_popularity_exponent = 0.9;
+    double mean_query_length = 2.5;
+    int max_query_length = 10;
+    double minus_word_ratio = 0.05;
+
+    // Share of documents per status in DocumentStatus order
+    std::array<double, 4> status_weights = { 1.0, 0.0, 0.0, 0.0 };
+    int max_rating_count = 5;
+    int min_rating = -10;
+    int max_rating = 10;
+};
+
+struct WorkloadDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct Workload {
+    // Sorted by popularity: vocabulary[0] is the most frequent word
+    std::vector<std::string> vocabulary;
+    std::vector<WorkloadDocument> documents;
+    std::vector<std::string> queries;
+};
+
+Workload GenerateWorkload(const WorkloadConfig& config, uint32_t seed);
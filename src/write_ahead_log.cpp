@@ -0,0 +1,272 @@
+#ifdef __linux__
+
+#include "write_ahead_log.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t CRC_SIZE = 4;
+
+const array<uint32_t, 256>& GetCrc32Table() {
+    static const array<uint32_t, 256> table = []() {
+        array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0u);
+            }
+            result[i] = crc;
+        }
+        return result;
+    }();
+    return table;
+}
+
+uint32_t ReadUint32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+        | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+// Reads up to size bytes at the offset, fewer only at the end of the file
+size_t ReadAt(int fd, uint8_t* data, size_t size, size_t offset) {
+    size_t filled = 0;
+    while (filled < size) {
+        const ssize_t result = pread(fd, data + filled, size - filled, static_cast<off_t>(offset + filled));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            ThrowSystemError("pread"s);
+        }
+        if (result == 0) {
+            break;
+        }
+        filled += static_cast<size_t>(result);
+    }
+    return filled;
+}
+
+// Makes a new entry of the directory durable, so the file itself survives a crash
+void SyncParentDirectory(const string& path) {
+    const size_t slash = path.rfind('/');
+    const string directory = slash == string::npos ? "."s : slash == 0 ? "/"s : path.substr(0, slash);
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowSystemError("open "s + directory);
+    }
+    const int result = fsync(fd);
+    const int error = errno;
+    close(fd);
+    if (result < 0) {
+        errno = error;
+        ThrowSystemError("fsync "s + directory);
+    }
+}
+
+} // namespace
+
+uint32_t ComputeCrc32(const uint8_t* data, size_t size, uint32_t crc) {
+    const array<uint32_t, 256>& table = GetCrc32Table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+WriteAheadLog::WriteAheadLog(const string& path, const WalOptions& options)
+    : path_(path)
+    , options_(options) {
+    if (options_.recovery_chunk_size == 0) {
+        throw invalid_argument("Recovery chunk size must be positive"s);
+    }
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    const bool is_created = fd_ >= 0;
+    if (!is_created && errno == EEXIST) {
+        fd_ = open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    }
+    if (fd_ < 0) {
+        ThrowSystemError("open "s + path);
+    }
+    if (is_created && options_.sync) {
+        try {
+            SyncParentDirectory(path);
+        }
+        catch (...) {
+            close(fd_);
+            throw;
+        }
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close(fd_);
+}
+
+void WriteAheadLog::Recover(const function<void(vector<Request>&)>& apply_records) {
+    PROFILE_SCOPE("ReadLog");
+    // Bytes of the file from file_offset not yet split into records
+    vector<uint8_t> buffer;
+    size_t file_offset = 0;
+    bool is_end = false;
+    bool is_damaged = false;
+    while (!is_end && !is_damaged) {
+        const size_t filled = buffer.size();
+        buffer.resize(filled + options_.recovery_chunk_size);
+        const size_t read = ReadAt(fd_, buffer.data() + filled, options_.recovery_chunk_size, file_offset + filled);
+        buffer.resize(filled + read);
+        is_end = read < options_.recovery_chunk_size;
+
+        // Finding the record boundaries only reads the sizes, the records are checked and decoded in parallel
+        vector<size_t> offsets;
+        size_t offset = 0;
+        try {
+            while (buffer.size() - offset >= CRC_SIZE) {
+                const size_t frame_size = GetFrameSize(buffer.data() + offset + CRC_SIZE, buffer.size() - offset - CRC_SIZE);
+                if (frame_size == 0) {
+                    // The rest of the record is in the next chunk
+                    break;
+                }
+                offsets.push_back(offset);
+                offset += CRC_SIZE + frame_size;
+            }
+        }
+        catch (const invalid_argument&) {
+            // A damaged size, the log ends before it
+            is_damaged = true;
+        }
+        offsets.push_back(offset);
+
+        const size_t record_count = offsets.size() - 1;
+        vector<Request> records(record_count);
+        vector<char> is_valid(record_count, 0);
+        vector<size_t> indexes(record_count);
+        iota(indexes.begin(), indexes.end(), size_t(0));
+        for_each(execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+            const uint8_t* record = buffer.data() + offsets[i];
+            const uint8_t* frame = record + CRC_SIZE;
+            const size_t frame_size = offsets[i + 1] - offsets[i] - CRC_SIZE;
+            is_valid[i] = ReadUint32(record) == ComputeCrc32(frame, frame_size)
+                && DecodeRequest(frame + FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE, records[i]);
+        });
+
+        const size_t valid_count = static_cast<size_t>(find(is_valid.begin(), is_valid.end(), 0) - is_valid.begin());
+        if (valid_count < record_count) {
+            is_damaged = true;
+        }
+        records.resize(valid_count);
+        if (!records.empty()) {
+            apply_records(records);
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(offsets[valid_count]));
+        file_offset += offsets[valid_count];
+    }
+
+    // A record cut by a crash or damaged, the log ends before it
+    if (is_damaged || !buffer.empty()) {
+        if (ftruncate(fd_, static_cast<off_t>(file_offset)) < 0) {
+            ThrowSystemError("ftruncate "s + path_);
+        }
+        if (options_.sync && fdatasync(fd_) < 0) {
+            ThrowSystemError("fdatasync "s + path_);
+        }
+    }
+    is_recovered_ = true;
+}
+
+uint64_t WriteAheadLog::Append(const Request& request) {
+    vector<uint8_t> record(CRC_SIZE);
+    EncodeRequest(request, record);
+    const uint32_t crc = ComputeCrc32(record.data() + CRC_SIZE, record.size() - CRC_SIZE);
+    for (size_t i = 0; i < CRC_SIZE; ++i) {
+        record[i] = static_cast<uint8_t>(crc >> (8 * i));
+    }
+
+    lock_guard guard(mutex_);
+    if (!is_recovered_) {
+        throw logic_error("The log has to be recovered before appending"s);
+    }
+    if (error_) {
+        rethrow_exception(error_);
+    }
+    pending_.insert(pending_.end(), record.begin(), record.end());
+    return ++appended_;
+}
+
+void WriteAheadLog::Sync(uint64_t sequence_number) {
+    unique_lock lock(mutex_);
+    while (committed_sequence_number_ < sequence_number) {
+        if (error_) {
+            rethrow_exception(error_);
+        }
+        if (is_committing_) {
+            committed_.wait(lock);
+            continue;
+        }
+
+        // This writer commits the group of everything appended so far
+        is_committing_ = true;
+        vector<uint8_t> group;
+        group.swap(pending_);
+        const uint64_t last_sequence_number = appended_;
+        lock.unlock();
+
+        exception_ptr error;
+        try {
+            size_t offset = 0;
+            while (offset < group.size()) {
+                const ssize_t result = write(fd_, group.data() + offset, group.size() - offset);
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result < 0) {
+                    ThrowSystemError("write "s + path_);
+                }
+                offset += static_cast<size_t>(result);
+            }
+            if (options_.sync && fdatasync(fd_) < 0) {
+                ThrowSystemError("fdatasync "s + path_);
+            }
+        }
+        catch (...) {
+            error = current_exception();
+        }
+
+        lock.lock();
+        is_committing_ = false;
+        ++commit_count_;
+        if (error) {
+            // Whether the group reached the disk is unknown, later records can't follow it
+            error_ = error;
+        }
+        else {
+            committed_sequence_number_ = last_sequence_number;
+        }
+        committed_.notify_all();
+    }
+}
+
+size_t WriteAheadLog::GetCommitCount() const {
+    lock_guard guard(mutex_);
+    return commit_count_;
+}
+
+#endif
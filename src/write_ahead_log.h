@@ -0,0 +1,73 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "query_protocol.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct WalOptions {
+    // fdatasync every group of records before Sync returns, otherwise the records
+    // survive a crash of the process but not of the machine
+    bool sync = true;
+    // Bytes read at once when the log is recovered, a longer record takes several reads
+    size_t recovery_chunk_size = 4 << 20;
+};
+
+// CRC-32 (IEEE 802.3) of the bytes, crc is the value of the preceding bytes
+uint32_t ComputeCrc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// Append only log of AddDocument and RemoveDocument requests. A record is the CRC-32
+// of a frame of query_protocol.h followed by the frame, so a record cut by a crash or
+// damaged on disk is detected and the log ends before it.
+//
+// Appends of concurrent writers are committed in groups: the first writer waiting in Sync
+// writes and syncs the records of everyone appended so far while the others wait for it.
+class WriteAheadLog {
+public:
+    // Opens or creates the log, a new file is synced together with its directory.
+    // Throws system_error if the file can't be opened.
+    explicit WriteAheadLog(const std::string& path, const WalOptions& options = WalOptions());
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Reads the log in chunks and calls apply_records with the records of every chunk in order,
+    // so the log is never in memory as a whole. Everything after the last valid record is cut
+    // off and the file is synced. Has to be called once before the first Append.
+    void Recover(const std::function<void(std::vector<Request>&)>& apply_records);
+
+    // Queues the record and returns its sequence number, doesn't wait for the disk.
+    // After a failed write the log refuses new records, the error is rethrown.
+    uint64_t Append(const Request& request);
+    // Returns when the record with the sequence number and all before it are on disk
+    void Sync(uint64_t sequence_number);
+
+    // Number of writes to the file, each commits a group of records
+    size_t GetCommitCount() const;
+
+private:
+    std::string path_;
+    WalOptions options_;
+    int fd_ = -1;
+    bool is_recovered_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable committed_;
+    std::vector<uint8_t> pending_;
+    uint64_t appended_ = 0;
+    uint64_t committed_sequence_number_ = 0;
+    bool is_committing_ = false;
+    // A failed commit, every later Append and Sync rethrows it
+    std::exception_ptr error_;
+    size_t commit_count_ = 0;
+};
+
+#endif